@@ -0,0 +1,144 @@
+#include <sourcemeta/registry/compress.h>
+
+#ifdef SOURCEMETA_REGISTRY_BROTLI
+extern "C" {
+#include <brotli/decode.h>
+#include <brotli/encode.h>
+}
+#endif
+
+#ifdef SOURCEMETA_REGISTRY_ZSTD
+extern "C" {
+#include <zstd.h>
+}
+#endif
+
+#include <array>   // std::array
+#include <cstddef> // std::size_t
+#include <cstdint> // std::uint8_t
+#include <utility> // std::move
+
+namespace sourcemeta::registry {
+
+// The highest qualities take several times longer for a marginal gain, which
+// adds up quickly across a large registry
+constexpr int BROTLI_QUALITY{9};
+constexpr int ZSTD_LEVEL{19};
+
+auto brotli(const std::string_view input) -> std::optional<std::string> {
+  return brotli(input, BROTLI_QUALITY);
+}
+
+auto brotli(const std::string_view input, const int quality)
+    -> std::optional<std::string> {
+#ifdef SOURCEMETA_REGISTRY_BROTLI
+  std::string output(BrotliEncoderMaxCompressedSize(input.size()), '\0');
+  auto size{output.size()};
+  // JSON is text, which Brotli has a dedicated mode for
+  if (BrotliEncoderCompress(
+          quality, BROTLI_DEFAULT_WINDOW, BROTLI_MODE_TEXT,
+          input.size(), reinterpret_cast<const std::uint8_t *>(input.data()),
+          &size, reinterpret_cast<std::uint8_t *>(output.data())) !=
+      BROTLI_TRUE) {
+    throw CompressError{"Could not compress input"};
+  }
+
+  output.resize(size);
+  return output;
+#else
+  static_cast<void>(input);
+  static_cast<void>(quality);
+  return std::nullopt;
+#endif
+}
+
+auto unbrotli(const std::string_view input) -> std::string {
+#ifdef SOURCEMETA_REGISTRY_BROTLI
+  auto *const state{BrotliDecoderCreateInstance(nullptr, nullptr, nullptr)};
+  if (state == nullptr) {
+    throw CompressError{"Could not decompress input"};
+  }
+
+  std::array<std::uint8_t, 4096> buffer;
+  std::string output;
+  auto available_input{input.size()};
+  const auto *next_input{reinterpret_cast<const std::uint8_t *>(input.data())};
+  auto result{BROTLI_DECODER_RESULT_NEEDS_MORE_OUTPUT};
+  while (result == BROTLI_DECODER_RESULT_NEEDS_MORE_OUTPUT) {
+    auto available_output{buffer.size()};
+    auto *next_output{buffer.data()};
+    result = BrotliDecoderDecompressStream(state, &available_input,
+                                           &next_input, &available_output,
+                                           &next_output, nullptr);
+    output.append(reinterpret_cast<const char *>(buffer.data()),
+                  buffer.size() - available_output);
+  }
+
+  BrotliDecoderDestroyInstance(state);
+  if (result != BROTLI_DECODER_RESULT_SUCCESS) {
+    throw CompressError{"Could not decompress input"};
+  }
+
+  return output;
+#else
+  static_cast<void>(input);
+  throw CompressError{"Brotli is not supported"};
+#endif
+}
+
+auto zstd(const std::string_view input) -> std::optional<std::string> {
+  return zstd(input, ZSTD_LEVEL);
+}
+
+auto zstd(const std::string_view input, const int level)
+    -> std::optional<std::string> {
+#ifdef SOURCEMETA_REGISTRY_ZSTD
+  std::string output(ZSTD_compressBound(input.size()), '\0');
+  const auto size{ZSTD_compress(output.data(), output.size(), input.data(),
+                                input.size(), level)};
+  if (ZSTD_isError(size)) {
+    throw CompressError{"Could not compress input"};
+  }
+
+  output.resize(size);
+  return output;
+#else
+  static_cast<void>(input);
+  static_cast<void>(level);
+  return std::nullopt;
+#endif
+}
+
+auto unzstd(const std::string_view input) -> std::string {
+#ifdef SOURCEMETA_REGISTRY_ZSTD
+  auto *const stream{ZSTD_createDStream()};
+  if (stream == nullptr) {
+    throw CompressError{"Could not decompress input"};
+  }
+
+  std::array<char, 4096> buffer;
+  std::string output;
+  ZSTD_inBuffer input_buffer{input.data(), input.size(), 0};
+  std::size_t code{1};
+  while (input_buffer.pos < input_buffer.size || code != 0) {
+    ZSTD_outBuffer output_buffer{buffer.data(), buffer.size(), 0};
+    code = ZSTD_decompressStream(stream, &output_buffer, &input_buffer);
+    if (ZSTD_isError(code) ||
+        (output_buffer.pos == 0 && input_buffer.pos == input_buffer.size &&
+         code != 0)) {
+      ZSTD_freeDStream(stream);
+      throw CompressError{"Could not decompress input"};
+    }
+
+    output.append(buffer.data(), output_buffer.pos);
+  }
+
+  ZSTD_freeDStream(stream);
+  return output;
+#else
+  static_cast<void>(input);
+  throw CompressError{"Zstandard is not supported"};
+#endif
+}
+
+} // namespace sourcemeta::registry
@@ -0,0 +1,40 @@
+#ifndef SOURCEMETA_REGISTRY_COMPRESS_H_
+#define SOURCEMETA_REGISTRY_COMPRESS_H_
+
+#include <sourcemeta/registry/compress_error.h>
+
+#include <optional>    // std::optional
+#include <string>      // std::string
+#include <string_view> // std::string_view
+
+namespace sourcemeta::registry {
+
+// These encoders are optional, depending on what was available at build time.
+// Compressing with an encoder that is not available results in nothing, while
+// decompressing throws
+
+/// Compress with Brotli at a high quality, which is slow, but meant to happen
+/// only once, ahead of time
+auto brotli(const std::string_view input) -> std::optional<std::string>;
+
+/// Compress with Brotli at the given quality, from 0 (fastest) to 11
+/// (smallest)
+auto brotli(const std::string_view input, const int quality)
+    -> std::optional<std::string>;
+
+auto unbrotli(const std::string_view input) -> std::string;
+
+/// Compress with Zstandard at a high level, which is slow, but meant to happen
+/// only once, ahead of time
+auto zstd(const std::string_view input) -> std::optional<std::string>;
+
+/// Compress with Zstandard at the given level, from 1 (fastest) to 22
+/// (smallest)
+auto zstd(const std::string_view input, const int level)
+    -> std::optional<std::string>;
+
+auto unzstd(const std::string_view input) -> std::string;
+
+} // namespace sourcemeta::registry
+
+#endif
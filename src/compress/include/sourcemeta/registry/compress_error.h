@@ -0,0 +1,23 @@
+#ifndef SOURCEMETA_REGISTRY_COMPRESS_ERROR_H_
+#define SOURCEMETA_REGISTRY_COMPRESS_ERROR_H_
+
+#include <exception> // std::exception
+#include <string>    // std::string
+#include <utility>   // std::move
+
+namespace sourcemeta::registry {
+
+class CompressError : public std::exception {
+public:
+  CompressError(std::string message) : message_{std::move(message)} {}
+  [[nodiscard]] auto what() const noexcept -> const char * override {
+    return this->message_.c_str();
+  }
+
+private:
+  std::string message_;
+};
+
+} // namespace sourcemeta::registry
+
+#endif
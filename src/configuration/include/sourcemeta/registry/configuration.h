@@ -5,9 +5,11 @@
 #include <sourcemeta/core/schemaconfig.h>
 
 #include <sourcemeta/registry/configuration_error.h>
+#include <sourcemeta/registry/shared.h>
 
 #include <filesystem>    // std::filesystem::path
 #include <optional>      // std::optional
+#include <string_view>   // std::string_view
 #include <unordered_map> // std::unordered_map
 #include <variant>       // std::variant
 
@@ -50,6 +52,15 @@ struct Configuration {
 
   std::unordered_map<std::filesystem::path, std::variant<Page, Collection>>
       entries;
+
+  /// How to compress each kind of artifact, like `schema` or `bundle`, as
+  /// named in the configuration file
+  std::unordered_map<sourcemeta::core::JSON::String, Compression> compression;
+
+  /// The compression of the given kind of artifact, even if the configuration
+  /// file does not mention it
+  [[nodiscard]] auto compression_of(const std::string_view kind) const
+      -> Compression;
 };
 
 } // namespace sourcemeta::registry
@@ -9,6 +9,7 @@
 #include <algorithm> // std::transform
 #include <cassert>   // assert
 #include <cctype>    // std::tolower
+#include <cstddef>   // std::size_t
 
 namespace {
 
@@ -69,6 +70,30 @@ auto entries_from_json(T &result, const std::filesystem::path &location,
   }
 }
 
+auto compression_from_json(const sourcemeta::core::JSON &input,
+                           sourcemeta::registry::Compression &result) -> void {
+  if (input.defines("level")) {
+    const auto &level{input.at("level").to_string()};
+    if (level == "none") {
+      result.level = sourcemeta::registry::CompressionLevel::None;
+    } else if (level == "fast") {
+      result.level = sourcemeta::registry::CompressionLevel::Fast;
+    } else if (level == "best") {
+      result.level = sourcemeta::registry::CompressionLevel::Best;
+    } else if (level == "dictionary") {
+      result.level = sourcemeta::registry::CompressionLevel::Dictionary;
+    } else {
+      assert(level == "default");
+      result.level = sourcemeta::registry::CompressionLevel::Default;
+    }
+  }
+
+  if (input.defines("threshold")) {
+    result.threshold =
+        static_cast<std::size_t>(input.at("threshold").to_integer());
+  }
+}
+
 } // namespace
 
 namespace sourcemeta::registry {
@@ -115,7 +140,28 @@ auto Configuration::parse(const sourcemeta::core::JSON &data) -> Configuration {
 
   entries_from_json(result.entries, "", data);
 
+  // Only the small instances of these artifacts end up using the dictionary,
+  // while the rest get the default compression
+  result.compression.emplace(
+      "positions", Compression{.level = CompressionLevel::Dictionary});
+  result.compression.emplace(
+      "locations", Compression{.level = CompressionLevel::Dictionary});
+  result.compression.emplace(
+      "stats", Compression{.level = CompressionLevel::Dictionary});
+  if (data.defines("compression")) {
+    for (const auto &entry : data.at("compression").as_object()) {
+      compression_from_json(entry.second, result.compression[entry.first]);
+    }
+  }
+
   return result;
 }
 
+auto Configuration::compression_of(const std::string_view kind) const
+    -> Compression {
+  const auto match{
+      this->compression.find(sourcemeta::core::JSON::String{kind})};
+  return match == this->compression.cend() ? Compression{} : match->second;
+}
+
 } // namespace sourcemeta::registry
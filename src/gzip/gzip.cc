@@ -4,18 +4,25 @@ extern "C" {
 #include <zlib.h>
 }
 
-#include <array>   // std::array
-#include <sstream> // std::istringstream, std::ostringstream
-#include <utility> // std::move
+#include <array>       // std::array
+#include <memory>      // std::make_unique
+#include <sstream>     // std::istringstream, std::ostringstream
+#include <string>      // std::string
+#include <string_view> // std::string_view
+#include <utility>     // std::move
 
 namespace sourcemeta::registry {
 
-constexpr auto ZLIB_BUFFER_SIZE{4096};
+// Larger buffers mean fewer calls into zlib for large artifacts
+constexpr auto ZLIB_BUFFER_SIZE{16384};
+// The maximum amount of memory for the internal compression state, which
+// improves both speed and ratio over the default of 8 at a small cost
+constexpr auto ZLIB_MEMORY_LEVEL{9};
 
-auto gzip(std::istream &input, std::ostream &output) -> void {
+auto gzip(std::istream &input, std::ostream &output, const int level) -> void {
   z_stream zstream{};
-  if (deflateInit2(&zstream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 16 + MAX_WBITS,
-                   8, Z_DEFAULT_STRATEGY) != Z_OK) {
+  if (deflateInit2(&zstream, level, Z_DEFLATED, 16 + MAX_WBITS,
+                   ZLIB_MEMORY_LEVEL, Z_DEFAULT_STRATEGY) != Z_OK) {
     throw GZIPError{"Could not compress input"};
   }
 
@@ -62,6 +69,10 @@ auto gzip(std::istream &input, std::ostream &output) -> void {
   }
 }
 
+auto gzip(std::istream &input, std::ostream &output) -> void {
+  gzip(input, output, Z_DEFAULT_COMPRESSION);
+}
+
 auto gunzip(std::istream &input, std::ostream &output) -> void {
   z_stream zstream{};
   if (inflateInit2(&zstream, 16 + MAX_WBITS) != Z_OK) {
@@ -108,6 +119,159 @@ auto gunzip(std::istream &input, std::ostream &output) -> void {
   }
 }
 
+auto deflate_with_dictionary(const std::string_view input,
+                             const std::string_view dictionary,
+                             const int level) -> std::string {
+  z_stream zstream{};
+  if (deflateInit2(&zstream, level, Z_DEFLATED, MAX_WBITS, ZLIB_MEMORY_LEVEL,
+                   Z_DEFAULT_STRATEGY) != Z_OK) {
+    throw GZIPError{"Could not compress input"};
+  }
+
+  if (deflateSetDictionary(
+          &zstream, reinterpret_cast<const Bytef *>(dictionary.data()),
+          static_cast<uInt>(dictionary.size())) != Z_OK) {
+    deflateEnd(&zstream);
+    throw GZIPError{"Could not compress input"};
+  }
+
+  std::string output(deflateBound(&zstream, static_cast<uLong>(input.size())),
+                     '\0');
+  zstream.next_in =
+      reinterpret_cast<Bytef *>(const_cast<char *>(input.data()));
+  zstream.avail_in = static_cast<uInt>(input.size());
+  zstream.next_out = reinterpret_cast<Bytef *>(output.data());
+  zstream.avail_out = static_cast<uInt>(output.size());
+  // The output buffer is large enough to compress everything in one go
+  const auto code{deflate(&zstream, Z_FINISH)};
+  output.resize(zstream.total_out);
+  deflateEnd(&zstream);
+  if (code != Z_STREAM_END) {
+    throw GZIPError{"Could not compress input"};
+  }
+
+  return output;
+}
+
+auto inflate_with_dictionary(const std::string_view input,
+                             const std::string_view dictionary)
+    -> std::string {
+  z_stream zstream{};
+  if (inflateInit2(&zstream, MAX_WBITS) != Z_OK) {
+    throw GZIPError("Could not decompress input");
+  }
+
+  zstream.next_in =
+      reinterpret_cast<Bytef *>(const_cast<char *>(input.data()));
+  zstream.avail_in = static_cast<uInt>(input.size());
+  std::array<char, ZLIB_BUFFER_SIZE> buffer_output;
+  std::string output;
+  auto code{Z_OK};
+  while (code != Z_STREAM_END) {
+    zstream.next_out = reinterpret_cast<Bytef *>(buffer_output.data());
+    zstream.avail_out = static_cast<uInt>(buffer_output.size());
+    code = inflate(&zstream, Z_NO_FLUSH);
+    // The stream asks for the dictionary before producing any output
+    if (code == Z_NEED_DICT) {
+      code = inflateSetDictionary(
+          &zstream, reinterpret_cast<const Bytef *>(dictionary.data()),
+          static_cast<uInt>(dictionary.size()));
+      if (code == Z_OK) {
+        continue;
+      }
+    }
+
+    if (code != Z_OK && code != Z_STREAM_END) {
+      inflateEnd(&zstream);
+      throw GZIPError("Could not decompress input");
+    }
+
+    output.append(buffer_output.data(),
+                  buffer_output.size() - zstream.avail_out);
+    // Truncated input
+    if (code == Z_OK && zstream.avail_in == 0 && zstream.avail_out > 0) {
+      inflateEnd(&zstream);
+      throw GZIPError("Could not decompress input");
+    }
+  }
+
+  inflateEnd(&zstream);
+  return output;
+}
+
+struct GUNZIPStream::Internal {
+  z_stream zstream{};
+  std::size_t limit;
+  std::size_t total{0};
+  bool finished{false};
+};
+
+GUNZIPStream::GUNZIPStream(const std::size_t limit)
+    : internal{std::make_unique<Internal>()} {
+  this->internal->limit = limit;
+  if (inflateInit2(&this->internal->zstream, 16 + MAX_WBITS) != Z_OK) {
+    throw GZIPError("Could not decompress input");
+  }
+}
+
+GUNZIPStream::~GUNZIPStream() { inflateEnd(&this->internal->zstream); }
+
+auto GUNZIPStream::write(const std::string_view input, std::string &output)
+    -> bool {
+  auto &zstream{this->internal->zstream};
+  if (this->internal->finished) {
+    if (!input.empty()) {
+      throw GZIPError("Could not decompress input");
+    }
+
+    return true;
+  }
+
+  zstream.next_in =
+      reinterpret_cast<Bytef *>(const_cast<char *>(input.data()));
+  zstream.avail_in = static_cast<uInt>(input.size());
+  std::array<char, ZLIB_BUFFER_SIZE> buffer_output;
+  // Keep going while there is input left or while zlib might be holding on
+  // to output that did not fit in the buffer
+  do {
+    zstream.next_out = reinterpret_cast<Bytef *>(buffer_output.data());
+    zstream.avail_out = static_cast<uInt>(buffer_output.size());
+    const auto code{inflate(&zstream, Z_NO_FLUSH)};
+    // There was nothing left to do
+    if (code == Z_BUF_ERROR) {
+      break;
+    } else if (code != Z_OK && code != Z_STREAM_END) {
+      throw GZIPError("Could not decompress input");
+    }
+
+    // We only ever decompress one buffer at a time, so we can stop as soon
+    // as the output goes over the limit
+    const auto bytes_written{buffer_output.size() - zstream.avail_out};
+    this->internal->total += bytes_written;
+    if (this->internal->total > this->internal->limit) {
+      return false;
+    }
+
+    output.append(buffer_output.data(), bytes_written);
+    if (code == Z_STREAM_END) {
+      this->internal->finished = true;
+      // Concatenated GZIP members are valid, but no HTTP client sends them
+      if (zstream.avail_in > 0) {
+        throw GZIPError("Could not decompress input");
+      }
+    }
+  } while (!this->internal->finished &&
+           (zstream.avail_in > 0 || zstream.avail_out == 0));
+
+  return true;
+}
+
+auto GUNZIPStream::end() const -> void {
+  if (!this->internal->finished) {
+    throw GZIPError("Could not decompress input");
+  }
+}
+
 auto gzip(std::istream &stream) -> std::string {
   std::ostringstream output;
   gzip(stream, output);
@@ -119,6 +283,13 @@ auto gzip(const std::string &input) -> std::string {
   return gzip(stream);
 }
 
+auto gzip(const std::string &input, const int level) -> std::string {
+  std::istringstream stream{input};
+  std::ostringstream output;
+  gzip(stream, output, level);
+  return output.str();
+}
+
 auto gunzip(std::istream &stream) -> std::string {
   std::ostringstream output;
   gunzip(stream, output);
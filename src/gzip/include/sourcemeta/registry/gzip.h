@@ -3,25 +3,75 @@
 
 #include <sourcemeta/registry/gzip_error.h>
 
+#include <cstddef>     // std::size_t
 #include <istream>     // std::istream
+#include <memory>      // std::unique_ptr
 #include <ostream>     // std::ostream
 #include <string>      // std::string
 #include <string_view> // std::string_view
 
 namespace sourcemeta::registry {
 
+/// Compress at the given zlib level, from 1 (fastest) to 9 (smallest)
+auto gzip(std::istream &input, std::ostream &output, const int level) -> void;
+
 auto gzip(std::istream &input, std::ostream &output) -> void;
 
 auto gzip(std::istream &stream) -> std::string;
 
 auto gzip(const std::string &input) -> std::string;
 
+auto gzip(const std::string &input, const int level) -> std::string;
+
 auto gunzip(std::istream &input, std::ostream &output) -> void;
 
 auto gunzip(std::istream &stream) -> std::string;
 
 auto gunzip(const std::string &input) -> std::string;
 
+/// Compress into the zlib format using a preset dictionary, which primes the
+/// compressor with content that is likely to occur in the input. Only readers
+/// that know the same dictionary can decompress the result, so this is not
+/// meant for HTTP. See https://www.rfc-editor.org/rfc/rfc1950
+auto deflate_with_dictionary(const std::string_view input,
+                             const std::string_view dictionary,
+                             const int level) -> std::string;
+
+auto inflate_with_dictionary(const std::string_view input,
+                             const std::string_view dictionary)
+    -> std::string;
+
+/// Decompress GZIP input that arrives in parts, such as an HTTP request body,
+/// without holding on to the compressed input. As a small input might
+/// decompress into an arbitrarily large output, this refuses to produce more
+/// than the given amount of bytes
+class GUNZIPStream {
+public:
+  GUNZIPStream(const std::size_t limit);
+  ~GUNZIPStream();
+
+  // Just to prevent mistakes
+  GUNZIPStream(const GUNZIPStream &) = delete;
+  GUNZIPStream &operator=(const GUNZIPStream &) = delete;
+  GUNZIPStream(GUNZIPStream &&) = delete;
+  GUNZIPStream &operator=(GUNZIPStream &&) = delete;
+
+  /// Decompress the next part of the input at the end of the given string,
+  /// returning false without going any further if the decompressed output
+  /// would exceed the limit
+  [[nodiscard]] auto write(const std::string_view input, std::string &output)
+      -> bool;
+
+  /// Signal that there is no more input, throwing if the input ended before
+  /// the GZIP stream did
+  auto end() const -> void;
+
+private:
+  // Use PIMPL idiom to not expose zlib to consumers
+  struct Internal;
+  std::unique_ptr<Internal> internal;
+};
+
 } // namespace sourcemeta::registry
 
 #endif
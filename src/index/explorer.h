@@ -17,7 +17,7 @@
 #include <numeric>    // std::accumulate
 #include <optional>   // std::optional
 #include <regex>      // std::regex, std::regex_search, std::smatch
-#include <string>     // std::string, std::stoul
+#include <string>     // std::string, std::stoul, std::getline
 #include <tuple>      // std::tuple, std::make_tuple
 #include <utility>    // std::move
 #include <vector>     // std::vector
@@ -91,6 +91,35 @@ inflate_metadata(const sourcemeta::registry::Configuration &configuration,
       match->second);
 }
 
+// Keep the order of the search entries, as it breaks ties on relevance
+static auto read_search_entries(const std::filesystem::path &path)
+    -> std::vector<sourcemeta::registry::SearchEntry> {
+  auto file{sourcemeta::registry::read_stream_raw(path)};
+  assert(file.has_value());
+  assert(file.value().encoding == sourcemeta::registry::Encoding::Identity);
+  std::vector<sourcemeta::registry::SearchEntry> result;
+  std::string line;
+  while (std::getline(file.value().data, line)) {
+    if (line.empty()) {
+      continue;
+    }
+
+    const auto entry{sourcemeta::core::parse_json(line)};
+    assert(entry.is_array() && entry.size() == 7);
+    assert(entry.at(4).is_integer());
+    result.push_back(
+        {.path = entry.at(0).to_string(),
+         .title = entry.at(1).to_string(),
+         .description = entry.at(2).to_string(),
+         .dialect = entry.at(3).to_string(),
+         .health = static_cast<std::uint8_t>(entry.at(4).to_integer()),
+         .alert = entry.at(5).to_boolean(),
+         .provenance = entry.at(6).to_boolean()});
+  }
+
+  return result;
+}
+
 namespace sourcemeta::registry {
 
 struct GENERATE_EXPLORER_SCHEMA_METADATA {
@@ -98,7 +127,7 @@ struct GENERATE_EXPLORER_SCHEMA_METADATA {
       std::tuple<std::reference_wrapper<const sourcemeta::registry::Resolver>,
                  std::reference_wrapper<
                      const sourcemeta::registry::Configuration::Collection>,
-                 std::filesystem::path>;
+                 std::filesystem::path, Compression>;
   static auto
   handler(const std::filesystem::path &destination,
           const sourcemeta::core::BuildDependencies<std::filesystem::path>
@@ -203,7 +232,8 @@ struct GENERATE_EXPLORER_SCHEMA_METADATA {
         destination, result, "application/json",
         sourcemeta::registry::Encoding::GZIP, sourcemeta::core::JSON{nullptr},
         std::chrono::duration_cast<std::chrono::milliseconds>(timestamp_end -
-                                                              timestamp_start));
+                                                              timestamp_start),
+        std::get<3>(context));
   }
 };
 
@@ -232,14 +262,21 @@ struct GENERATE_EXPLORER_SEARCH_INDEX {
       entry.push_back(metadata_json.at_or("title", sourcemeta::core::JSON{""}));
       entry.push_back(
           metadata_json.at_or("description", sourcemeta::core::JSON{""}));
+      // Facets
+      entry.push_back(metadata_json.at("baseDialect"));
+      entry.push_back(metadata_json.at("health"));
+      entry.push_back(
+          sourcemeta::core::JSON{metadata_json.at("alert").is_string()});
+      entry.push_back(
+          sourcemeta::core::JSON{metadata_json.at("provenance").is_string()});
       result.push_back(std::move(entry));
     }
 
     std::sort(result.begin(), result.end(),
               [](const sourcemeta::core::JSON &left,
                  const sourcemeta::core::JSON &right) {
-                assert(left.is_array() && left.size() == 3);
-                assert(right.is_array() && right.size() == 3);
+                assert(left.is_array() && left.size() == 7);
+                assert(right.is_array() && right.size() == 7);
 
                 // Prioritise entries that have more meta-data filled in
                 const auto left_score = (!left.at(1).empty() ? 1 : 0) +
@@ -274,6 +311,56 @@ struct GENERATE_EXPLORER_SEARCH_INDEX {
   }
 };
 
+struct GENERATE_EXPLORER_SEARCH_TRIGRAMS {
+  using Context = std::nullptr_t;
+  static auto
+  handler(const std::filesystem::path &destination,
+          const sourcemeta::core::BuildDependencies<std::filesystem::path>
+              &dependencies,
+          const sourcemeta::core::BuildDynamicCallback<std::filesystem::path> &,
+          const Context &) -> void {
+    const auto timestamp_start{std::chrono::steady_clock::now()};
+    assert(dependencies.size() == 1);
+    const auto result{sourcemeta::registry::make_search_index(
+        read_search_entries(dependencies.front()))};
+    const auto timestamp_end{std::chrono::steady_clock::now()};
+
+    std::filesystem::create_directories(destination.parent_path());
+    sourcemeta::registry::write_binary(
+        destination, result, "application/octet-stream",
+        // We want the server to query this one straight from a memory mapping
+        sourcemeta::registry::Encoding::Identity,
+        sourcemeta::core::JSON{nullptr},
+        std::chrono::duration_cast<std::chrono::milliseconds>(timestamp_end -
+                                                              timestamp_start));
+  }
+};
+
+struct GENERATE_EXPLORER_SEARCH_COMPLETIONS {
+  using Context = std::nullptr_t;
+  static auto
+  handler(const std::filesystem::path &destination,
+          const sourcemeta::core::BuildDependencies<std::filesystem::path>
+              &dependencies,
+          const sourcemeta::core::BuildDynamicCallback<std::filesystem::path> &,
+          const Context &) -> void {
+    const auto timestamp_start{std::chrono::steady_clock::now()};
+    assert(dependencies.size() == 1);
+    const auto result{sourcemeta::registry::make_completion_index(
+        read_search_entries(dependencies.front()))};
+    const auto timestamp_end{std::chrono::steady_clock::now()};
+
+    std::filesystem::create_directories(destination.parent_path());
+    sourcemeta::registry::write_binary(
+        destination, result, "application/octet-stream",
+        // We want the server to query this one straight from a memory mapping
+        sourcemeta::registry::Encoding::Identity,
+        sourcemeta::core::JSON{nullptr},
+        std::chrono::duration_cast<std::chrono::milliseconds>(timestamp_end -
+                                                              timestamp_start));
+  }
+};
+
 struct GENERATE_EXPLORER_DIRECTORY_LIST {
   struct Context {
     const std::filesystem::path &directory;
@@ -414,7 +501,8 @@ struct GENERATE_EXPLORER_DIRECTORY_LIST {
         destination, meta, "application/json",
         sourcemeta::registry::Encoding::GZIP, sourcemeta::core::JSON{nullptr},
         std::chrono::duration_cast<std::chrono::milliseconds>(timestamp_end -
-                                                              timestamp_start));
+                                                              timestamp_start),
+        context.configuration.compression_of("explorer"));
   }
 };
 
@@ -21,10 +21,20 @@
 
 namespace sourcemeta::registry {
 
+// Most generators analyse a schema with the help of the resolver, and write
+// an artifact compressed as configured
+struct ResolverContext {
+  const sourcemeta::registry::Resolver &resolver;
+  const Compression compression;
+};
+
 struct GENERATE_MATERIALISED_SCHEMA {
-  using Context =
-      std::pair<std::string_view,
-                std::reference_wrapper<sourcemeta::registry::Resolver>>;
+  struct Context {
+    std::string_view identifier;
+    std::reference_wrapper<sourcemeta::registry::Resolver> resolver;
+    Compression compression;
+  };
+
   static auto
   handler(const std::filesystem::path &destination,
           const sourcemeta::core::BuildDependencies<std::filesystem::path> &,
@@ -32,19 +42,19 @@ struct GENERATE_MATERIALISED_SCHEMA {
               &callback,
           const Context &data) -> void {
     const auto timestamp_start{std::chrono::steady_clock::now()};
-    auto schema{data.second.get()(data.first)};
+    auto schema{data.resolver.get()(data.identifier)};
     assert(schema.has_value());
     const auto dialect_identifier{sourcemeta::core::dialect(schema.value())};
     assert(dialect_identifier.has_value());
-    const auto metaschema{data.second.get()(dialect_identifier.value())};
+    const auto metaschema{data.resolver.get()(dialect_identifier.value())};
     assert(metaschema.has_value());
 
     // Validate the schemas against their meta-schemas
     sourcemeta::blaze::SimpleOutput output{schema.value()};
     sourcemeta::blaze::Evaluator evaluator;
     const auto result{evaluator.validate(
-        GENERATE_MATERIALISED_SCHEMA::compile(dialect_identifier.value(),
-                                              metaschema.value(), data.second),
+        GENERATE_MATERIALISED_SCHEMA::compile(
+            dialect_identifier.value(), metaschema.value(), data.resolver),
         schema.value(), std::ref(output))};
     if (!result) {
       throw MetaschemaError(output);
@@ -55,7 +65,7 @@ struct GENERATE_MATERIALISED_SCHEMA {
     sourcemeta::core::format(
         schema.value(), sourcemeta::core::schema_official_walker,
         [&callback, &data](const auto identifier) {
-          return data.second.get()(identifier, callback);
+          return data.resolver.get()(identifier, callback);
         },
         dialect_identifier.value());
     sourcemeta::registry::write_pretty_json(
@@ -63,7 +73,8 @@ struct GENERATE_MATERIALISED_SCHEMA {
         sourcemeta::registry::Encoding::GZIP,
         sourcemeta::core::JSON{dialect_identifier.value()},
         std::chrono::duration_cast<std::chrono::milliseconds>(timestamp_end -
-                                                              timestamp_start));
+                                                              timestamp_start),
+        data.compression);
   }
 
   class MetaschemaError : public std::exception {
@@ -118,13 +129,13 @@ private:
 };
 
 struct GENERATE_POINTER_POSITIONS {
-  using Context = sourcemeta::registry::Resolver;
+  using Context = ResolverContext;
   static auto
   handler(const std::filesystem::path &destination,
           const sourcemeta::core::BuildDependencies<std::filesystem::path>
               &dependencies,
           const sourcemeta::core::BuildDynamicCallback<std::filesystem::path> &,
-          const Context &) -> void {
+          const Context &context) -> void {
     const auto timestamp_start{std::chrono::steady_clock::now()};
     sourcemeta::core::PointerPositionTracker tracker;
     sourcemeta::registry::read_json(dependencies.front(), std::ref(tracker));
@@ -135,19 +146,20 @@ struct GENERATE_POINTER_POSITIONS {
         destination, result, "application/json",
         sourcemeta::registry::Encoding::GZIP, sourcemeta::core::JSON{nullptr},
         std::chrono::duration_cast<std::chrono::milliseconds>(timestamp_end -
-                                                              timestamp_start));
+                                                              timestamp_start),
+        context.compression);
   }
 };
 
 struct GENERATE_FRAME_LOCATIONS {
-  using Context = sourcemeta::registry::Resolver;
+  using Context = ResolverContext;
   static auto
   handler(const std::filesystem::path &destination,
           const sourcemeta::core::BuildDependencies<std::filesystem::path>
               &dependencies,
           const sourcemeta::core::BuildDynamicCallback<std::filesystem::path>
               &callback,
-          const Context &resolver) -> void {
+          const Context &context) -> void {
     const auto timestamp_start{std::chrono::steady_clock::now()};
     sourcemeta::core::PointerPositionTracker tracker;
     const auto contents{sourcemeta::registry::read_json(dependencies.front(),
@@ -155,8 +167,8 @@ struct GENERATE_FRAME_LOCATIONS {
     sourcemeta::core::SchemaFrame frame{
         sourcemeta::core::SchemaFrame::Mode::Locations};
     frame.analyse(contents, sourcemeta::core::schema_official_walker,
-                  [&callback, &resolver](const auto identifier) {
-                    return resolver(identifier, callback);
+                  [&callback, &context](const auto identifier) {
+                    return context.resolver(identifier, callback);
                   });
     const auto result{frame.to_json(tracker).at("locations")};
     const auto timestamp_end{std::chrono::steady_clock::now()};
@@ -165,26 +177,27 @@ struct GENERATE_FRAME_LOCATIONS {
         destination, result, "application/json",
         sourcemeta::registry::Encoding::GZIP, sourcemeta::core::JSON{nullptr},
         std::chrono::duration_cast<std::chrono::milliseconds>(timestamp_end -
-                                                              timestamp_start));
+                                                              timestamp_start),
+        context.compression);
   }
 };
 
 struct GENERATE_DEPENDENCIES {
-  using Context = sourcemeta::registry::Resolver;
+  using Context = ResolverContext;
   static auto
   handler(const std::filesystem::path &destination,
           const sourcemeta::core::BuildDependencies<std::filesystem::path>
               &dependencies,
           const sourcemeta::core::BuildDynamicCallback<std::filesystem::path>
               &callback,
-          const Context &resolver) -> void {
+          const Context &context) -> void {
     const auto timestamp_start{std::chrono::steady_clock::now()};
     const auto contents{sourcemeta::registry::read_json(dependencies.front())};
     auto result{sourcemeta::core::JSON::make_array()};
     sourcemeta::core::dependencies(
         contents, sourcemeta::core::schema_official_walker,
-        [&callback, &resolver](const auto identifier) {
-          return resolver(identifier, callback);
+        [&callback, &context](const auto identifier) {
+          return context.resolver(identifier, callback);
         },
         [&result](const auto &origin, const auto &pointer, const auto &target,
                   const auto &) {
@@ -201,19 +214,20 @@ struct GENERATE_DEPENDENCIES {
         destination, result, "application/json",
         sourcemeta::registry::Encoding::GZIP, sourcemeta::core::JSON{nullptr},
         std::chrono::duration_cast<std::chrono::milliseconds>(timestamp_end -
-                                                              timestamp_start));
+                                                              timestamp_start),
+        context.compression);
   }
 };
 
 struct GENERATE_HEALTH {
-  using Context = sourcemeta::registry::Resolver;
+  using Context = ResolverContext;
   static auto
   handler(const std::filesystem::path &destination,
           const sourcemeta::core::BuildDependencies<std::filesystem::path>
               &dependencies,
           const sourcemeta::core::BuildDynamicCallback<std::filesystem::path>
               &callback,
-          const Context &resolver) -> void {
+          const Context &context) -> void {
     const auto timestamp_start{std::chrono::steady_clock::now()};
     const auto contents{sourcemeta::registry::read_json(dependencies.front())};
 
@@ -228,8 +242,8 @@ struct GENERATE_HEALTH {
     auto errors{sourcemeta::core::JSON::make_array()};
     const auto result = bundle.check(
         contents, sourcemeta::core::schema_official_walker,
-        [&callback, &resolver](const auto identifier) {
-          return resolver(identifier, callback);
+        [&callback, &context](const auto identifier) {
+          return context.resolver(identifier, callback);
         },
         [&errors](const auto &pointer, const auto &name, const auto &message,
                   const auto &outcome) {
@@ -263,24 +277,25 @@ struct GENERATE_HEALTH {
         destination, report, "application/json",
         sourcemeta::registry::Encoding::GZIP, sourcemeta::core::JSON{nullptr},
         std::chrono::duration_cast<std::chrono::milliseconds>(timestamp_end -
-                                                              timestamp_start));
+                                                              timestamp_start),
+        context.compression);
   }
 };
 
 struct GENERATE_BUNDLE {
-  using Context = sourcemeta::registry::Resolver;
+  using Context = ResolverContext;
   static auto
   handler(const std::filesystem::path &destination,
           const sourcemeta::core::BuildDependencies<std::filesystem::path>
               &dependencies,
           const sourcemeta::core::BuildDynamicCallback<std::filesystem::path>
               &callback,
-          const Context &resolver) -> void {
+          const Context &context) -> void {
     const auto timestamp_start{std::chrono::steady_clock::now()};
     auto schema{sourcemeta::registry::read_json(dependencies.front())};
     sourcemeta::core::bundle(schema, sourcemeta::core::schema_official_walker,
-                             [&callback, &resolver](const auto identifier) {
-                               return resolver(identifier, callback);
+                             [&callback, &context](const auto identifier) {
+                               return context.resolver(identifier, callback);
                              });
     const auto dialect_identifier{sourcemeta::core::dialect(schema)};
     assert(dialect_identifier.has_value());
@@ -288,8 +303,8 @@ struct GENERATE_BUNDLE {
     std::filesystem::create_directories(destination.parent_path());
     sourcemeta::core::format(
         schema, sourcemeta::core::schema_official_walker,
-        [&callback, &resolver](const auto identifier) {
-          return resolver(identifier, callback);
+        [&callback, &context](const auto identifier) {
+          return context.resolver(identifier, callback);
         },
         dialect_identifier.value());
     sourcemeta::registry::write_pretty_json(
@@ -297,34 +312,35 @@ struct GENERATE_BUNDLE {
         sourcemeta::registry::Encoding::GZIP,
         sourcemeta::core::JSON{dialect_identifier.value()},
         std::chrono::duration_cast<std::chrono::milliseconds>(timestamp_end -
-                                                              timestamp_start));
+                                                              timestamp_start),
+        context.compression);
   }
 };
 
 struct GENERATE_EDITOR {
-  using Context = sourcemeta::registry::Resolver;
+  using Context = ResolverContext;
   static auto
   handler(const std::filesystem::path &destination,
           const sourcemeta::core::BuildDependencies<std::filesystem::path>
               &dependencies,
           const sourcemeta::core::BuildDynamicCallback<std::filesystem::path>
               &callback,
-          const Context &resolver) -> void {
+          const Context &context) -> void {
     const auto timestamp_start{std::chrono::steady_clock::now()};
     auto schema{sourcemeta::registry::read_json(dependencies.front())};
-    sourcemeta::core::for_editor(schema,
-                                 sourcemeta::core::schema_official_walker,
-                                 [&callback, &resolver](const auto identifier) {
-                                   return resolver(identifier, callback);
-                                 });
+    sourcemeta::core::for_editor(
+        schema, sourcemeta::core::schema_official_walker,
+        [&callback, &context](const auto identifier) {
+          return context.resolver(identifier, callback);
+        });
     const auto dialect_identifier{sourcemeta::core::dialect(schema)};
     assert(dialect_identifier.has_value());
     const auto timestamp_end{std::chrono::steady_clock::now()};
     std::filesystem::create_directories(destination.parent_path());
     sourcemeta::core::format(
         schema, sourcemeta::core::schema_official_walker,
-        [&callback, &resolver](const auto identifier) {
-          return resolver(identifier, callback);
+        [&callback, &context](const auto identifier) {
+          return context.resolver(identifier, callback);
         },
         dialect_identifier.value());
     sourcemeta::registry::write_pretty_json(
@@ -332,7 +348,8 @@ struct GENERATE_EDITOR {
         sourcemeta::registry::Encoding::GZIP,
         sourcemeta::core::JSON{dialect_identifier.value()},
         std::chrono::duration_cast<std::chrono::milliseconds>(timestamp_end -
-                                                              timestamp_start));
+                                                              timestamp_start),
+        context.compression);
   }
 };
 
@@ -364,14 +381,14 @@ struct GENERATE_BLAZE_TEMPLATE {
 };
 
 struct GENERATE_STATS {
-  using Context = sourcemeta::registry::Resolver;
+  using Context = ResolverContext;
   static auto
   handler(const std::filesystem::path &destination,
           const sourcemeta::core::BuildDependencies<std::filesystem::path>
               &dependencies,
           const sourcemeta::core::BuildDynamicCallback<std::filesystem::path>
               &callback,
-          const Context &resolver) -> void {
+          const Context &context) -> void {
     const auto timestamp_start{std::chrono::steady_clock::now()};
     const auto schema{sourcemeta::registry::read_json(dependencies.front())};
     std::map<sourcemeta::core::JSON::String,
@@ -379,8 +396,8 @@ struct GENERATE_STATS {
         result;
     for (const auto &entry : sourcemeta::core::SchemaIterator{
              schema, sourcemeta::core::schema_official_walker,
-             [&callback, &resolver](const auto identifier) {
-               return resolver(identifier, callback);
+             [&callback, &context](const auto identifier) {
+               return context.resolver(identifier, callback);
              }}) {
       if (!entry.subschema.get().is_object()) {
         continue;
@@ -400,7 +417,8 @@ struct GENERATE_STATS {
         destination, sourcemeta::core::to_json(result), "application/json",
         sourcemeta::registry::Encoding::GZIP, sourcemeta::core::JSON{nullptr},
         std::chrono::duration_cast<std::chrono::milliseconds>(timestamp_end -
-                                                              timestamp_start));
+                                                              timestamp_start),
+        context.compression);
   }
 };
 
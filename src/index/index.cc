@@ -13,6 +13,7 @@
 #include "explorer.h"
 #include "generators.h"
 #include "output.h"
+#include "staging.h"
 
 #include <algorithm>   // std::sort
 #include <cassert>     // assert
@@ -22,6 +23,7 @@
 #include <filesystem>  // std::filesystem
 #include <iomanip>     // std::setw, std::setfill
 #include <iostream>    // std::cerr, std::cout
+#include <memory>      // std::unique_ptr, std::make_unique
 #include <string>      // std::string
 #include <string_view> // std::string_view
 #include <vector>      // std::vector
@@ -88,7 +90,26 @@ static auto index_main(const std::string_view &program,
   // (1) Prepare the output directory
   /////////////////////////////////////////////////////////////////////////////
 
-  sourcemeta::registry::Output output{app.positional().at(1)};
+  // When publishing atomically, we build a new generation next to the
+  // previous one, and only then point the output symbolic link to it
+  std::unique_ptr<sourcemeta::registry::Staging> staging;
+  if (app.contains("atomic")) {
+    if (!sourcemeta::registry::Staging::supports(app.positional().at(1))) {
+      std::cerr << "error: the output must be a symbolic link to publish it "
+                   "atomically\n  at "
+                << std::filesystem::weakly_canonical(app.positional().at(1))
+                       .string()
+                << "\n";
+      return EXIT_FAILURE;
+    }
+
+    staging =
+        std::make_unique<sourcemeta::registry::Staging>(app.positional().at(1));
+  }
+
+  sourcemeta::registry::Output output{
+      staging ? staging->path()
+              : std::filesystem::path{app.positional().at(1)}};
   std::cerr << "Writing output to: " << output.path().string() << "\n";
 
   /////////////////////////////////////////////////////////////////////////////
@@ -209,7 +230,7 @@ static auto index_main(const std::string_view &program,
                              : std::thread::hardware_concurrency()};
   sourcemeta::core::parallel_for_each(
       resolver.begin(), resolver.end(),
-      [&output, &schemas_path, &resolver, &mutex, &adapter,
+      [&output, &schemas_path, &resolver, &mutex, &adapter, &configuration,
        &mark_configuration_path, &mark_version_path](
           const auto &schema, const auto threads, const auto cursor) {
         print_progress(mutex, threads, "Ingesting", schema.first, cursor,
@@ -222,8 +243,10 @@ static auto index_main(const std::string_view &program,
              // This target depends on the configuration file given things like
              // resolve maps and base URIs
              mark_configuration_path, mark_version_path},
-            {schema.first, resolver}, mutex, "Ingesting", schema.first,
-            "materialise", adapter, output);
+            {.identifier = schema.first,
+             .resolver = resolver,
+             .compression = configuration.compression_of("schema")},
+            mutex, "Ingesting", schema.first, "materialise", adapter, output);
 
         // Mark the materialised schema in the resolver
         resolver.cache_path(schema.first, destination);
@@ -242,7 +265,7 @@ static auto index_main(const std::string_view &program,
   sourcemeta::core::parallel_for_each(
       resolver.begin(), resolver.end(),
       [&output, &schemas_path, &explorer_path, &resolver, &mutex, &adapter,
-       &mark_configuration_path, &mark_version_path](
+       &configuration, &mark_configuration_path, &mark_version_path](
           const auto &schema, const auto threads, const auto cursor) {
         print_progress(mutex, threads, "Analysing", schema.first, cursor,
                        resolver.size());
@@ -251,51 +274,72 @@ static auto index_main(const std::string_view &program,
 
         DISPATCH<sourcemeta::registry::GENERATE_POINTER_POSITIONS>(
             base_path / "positions.metapack",
-            {base_path / "schema.metapack", mark_version_path}, resolver, mutex,
-            "Analysing", schema.first, "positions", adapter, output);
+            {base_path / "schema.metapack", mark_version_path},
+            {.resolver = resolver,
+             .compression = configuration.compression_of("positions")},
+            mutex, "Analysing", schema.first, "positions", adapter, output);
 
         DISPATCH<sourcemeta::registry::GENERATE_FRAME_LOCATIONS>(
             base_path / "locations.metapack",
-            {base_path / "schema.metapack", mark_version_path}, resolver, mutex,
-            "Analysing", schema.first, "locations", adapter, output);
+            {base_path / "schema.metapack", mark_version_path},
+            {.resolver = resolver,
+             .compression = configuration.compression_of("locations")},
+            mutex, "Analysing", schema.first, "locations", adapter, output);
 
         DISPATCH<sourcemeta::registry::GENERATE_DEPENDENCIES>(
             base_path / "dependencies.metapack",
-            {base_path / "schema.metapack", mark_version_path}, resolver, mutex,
-            "Analysing", schema.first, "dependencies", adapter, output);
+            {base_path / "schema.metapack", mark_version_path},
+            {.resolver = resolver,
+             .compression = configuration.compression_of("dependencies")},
+            mutex, "Analysing", schema.first, "dependencies", adapter, output);
 
         DISPATCH<sourcemeta::registry::GENERATE_STATS>(
             base_path / "stats.metapack",
-            {base_path / "schema.metapack", mark_version_path}, resolver, mutex,
-            "Analysing", schema.first, "stats", adapter, output);
+            {base_path / "schema.metapack", mark_version_path},
+            {.resolver = resolver,
+             .compression = configuration.compression_of("stats")},
+            mutex, "Analysing", schema.first, "stats", adapter, output);
 
         DISPATCH<sourcemeta::registry::GENERATE_HEALTH>(
             base_path / "health.metapack",
             {base_path / "schema.metapack", base_path / "dependencies.metapack",
              mark_version_path},
-            resolver, mutex, "Analysing", schema.first, "health", adapter,
-            output);
+            {.resolver = resolver,
+             .compression = configuration.compression_of("health")},
+            mutex, "Analysing", schema.first, "health", adapter, output);
 
         DISPATCH<sourcemeta::registry::GENERATE_BUNDLE>(
             base_path / "bundle.metapack",
             {base_path / "schema.metapack", base_path / "dependencies.metapack",
              mark_version_path},
-            resolver, mutex, "Analysing", schema.first, "bundle", adapter,
-            output);
+            {.resolver = resolver,
+             .compression = configuration.compression_of("bundle")},
+            mutex, "Analysing", schema.first, "bundle", adapter, output);
 
         DISPATCH<sourcemeta::registry::GENERATE_EDITOR>(
             base_path / "editor.metapack",
-            {base_path / "bundle.metapack", mark_version_path}, resolver, mutex,
-            "Analysing", schema.first, "editor", adapter, output);
+            {base_path / "bundle.metapack", mark_version_path},
+            {.resolver = resolver,
+             .compression = configuration.compression_of("editor")},
+            mutex, "Analysing", schema.first, "editor", adapter, output);
 
         if (attribute_not_disabled(schema.second.collection.get(),
                                    "x-sourcemeta-registry:evaluate")) {
-          // TODO: Compile fast templates too
           DISPATCH<sourcemeta::registry::GENERATE_BLAZE_TEMPLATE>(
               base_path / "blaze-exhaustive.metapack",
               {base_path / "bundle.metapack", mark_version_path},
               sourcemeta::blaze::Mode::Exhaustive, mutex, "Analysing",
               schema.first, "blaze-exhaustive", adapter, output);
+
+          // For evaluations that only care about whether the instance is valid
+          if (attribute_not_disabled(schema.second.collection.get(),
+                                     "x-sourcemeta-registry:evaluate-fast")) {
+            DISPATCH<sourcemeta::registry::GENERATE_BLAZE_TEMPLATE>(
+                base_path / "blaze-fast.metapack",
+                {base_path / "bundle.metapack", mark_version_path},
+                sourcemeta::blaze::Mode::FastValidation, mutex, "Analysing",
+                schema.first, "blaze-fast", adapter, output);
+          }
         }
 
         DISPATCH<sourcemeta::registry::GENERATE_EXPLORER_SCHEMA_METADATA>(
@@ -306,7 +350,8 @@ static auto index_main(const std::string_view &program,
              // As this target reads the alert from the configuration file
              mark_configuration_path, mark_version_path},
             {resolver, schema.second.collection.get(),
-             schema.second.relative_path},
+             schema.second.relative_path,
+             configuration.compression_of("explorer")},
             mutex, "Analysing", schema.first, "metadata", adapter, output);
       },
       concurrency, THREAD_STACK_SIZE);
@@ -373,6 +418,14 @@ static auto index_main(const std::string_view &program,
   DISPATCH<sourcemeta::registry::GENERATE_EXPLORER_SEARCH_INDEX>(
       explorer_path / SENTINEL / "search.metapack", summaries, nullptr, mutex,
       "Producing", explorer_path.string(), "search", adapter, output);
+  DISPATCH<sourcemeta::registry::GENERATE_EXPLORER_SEARCH_TRIGRAMS>(
+      explorer_path / SENTINEL / "search-index.metapack",
+      {explorer_path / SENTINEL / "search.metapack"}, nullptr, mutex,
+      "Producing", explorer_path.string(), "search-index", adapter, output);
+  DISPATCH<sourcemeta::registry::GENERATE_EXPLORER_SEARCH_COMPLETIONS>(
+      explorer_path / SENTINEL / "search-complete.metapack",
+      {explorer_path / SENTINEL / "search.metapack"}, nullptr, mutex,
+      "Producing", explorer_path.string(), "search-complete", adapter, output);
 
   // Directory generation depends on the configuration for metadata
   summaries.emplace_back(mark_configuration_path);
@@ -478,6 +531,16 @@ static auto index_main(const std::string_view &program,
 
   output.remove_unknown_files();
 
+  if (staging) {
+    staging->publish();
+    std::cerr << "Published generation: " << staging->path().string() << "\n";
+    if (staging->previous().has_value()) {
+      // The server might still be answering requests out of it
+      std::cerr << "Previous generation: "
+                << staging->previous().value().string() << "\n";
+    }
+  }
+
   // TODO: Add a test for this
   if (app.contains("profile")) {
     std::cerr << "Profiling...\n";
@@ -526,6 +589,7 @@ auto main(int argc, char *argv[]) noexcept -> int {
     app.option("concurrency", {"c"});
     app.flag("verbose", {"v"});
     app.flag("profile", {"p"});
+    app.flag("atomic", {"a"});
     app.parse(argc, argv);
     const std::string_view program{argv[0]};
 
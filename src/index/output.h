@@ -87,9 +87,16 @@ private:
       -> const std::filesystem::path & {
     assert(path.is_absolute());
     std::filesystem::create_directories(path.parent_path());
-    std::ofstream stream{path};
-    assert(!stream.fail());
-    sourcemeta::core::stringify(document, stream);
+    // Replace the file rather than truncating it, as it might be a hardlink
+    // shared with a previous generation
+    const std::filesystem::path temporary{path.string() + ".tmp"};
+    {
+      std::ofstream stream{temporary};
+      assert(!stream.fail());
+      sourcemeta::core::stringify(document, stream);
+    }
+
+    std::filesystem::rename(temporary, path);
     return this->track(path);
   }
 
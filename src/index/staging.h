@@ -0,0 +1,117 @@
+#ifndef SOURCEMETA_REGISTRY_INDEX_STAGING_H_
+#define SOURCEMETA_REGISTRY_INDEX_STAGING_H_
+
+#include <cassert>      // assert
+#include <chrono>       // std::chrono
+#include <filesystem>   // std::filesystem
+#include <optional>     // std::optional
+#include <string>       // std::to_string
+#include <system_error> // std::error_code
+
+namespace sourcemeta::registry {
+
+/// Builds a new generation of an output directory that is a symbolic link,
+/// next to the directory it currently points to, and then publishes it by
+/// atomically re-pointing the link. The previous generation is never modified,
+/// so a server can keep reading it while we build
+class Staging {
+public:
+  Staging(const std::filesystem::path &link)
+      : link_{normalise(link)}, previous_{resolve(this->link_)},
+        path_{this->link_.parent_path() /
+              (this->link_.filename().string() + "." +
+               std::to_string(std::chrono::system_clock::now()
+                                  .time_since_epoch()
+                                  .count()))} {
+    std::filesystem::create_directories(this->path_);
+    if (this->previous_.has_value()) {
+      this->populate();
+    }
+  }
+
+  // Just to prevent mistakes
+  Staging(const Staging &) = delete;
+  Staging &operator=(const Staging &) = delete;
+  Staging(Staging &&) = delete;
+  Staging &operator=(Staging &&) = delete;
+
+  /// Whether we can atomically replace the given path with a symbolic link
+  static auto supports(const std::filesystem::path &link) -> bool {
+    const auto path{normalise(link)};
+    return std::filesystem::is_symlink(path) || !std::filesystem::exists(path);
+  }
+
+  /// The directory to build the new generation into
+  auto path() const -> const std::filesystem::path & { return this->path_; }
+
+  /// The directory that the link pointed to before we started, if any
+  auto previous() const -> const std::optional<std::filesystem::path> & {
+    return this->previous_;
+  }
+
+  /// Atomically point the link to the new generation. The link is relative,
+  /// so that both can be moved together
+  auto publish() const -> void {
+    const std::filesystem::path temporary{this->link_.string() + ".tmp"};
+    std::filesystem::remove(temporary);
+    std::filesystem::create_directory_symlink(this->path_.filename(),
+                                              temporary);
+    std::filesystem::rename(temporary, this->link_);
+  }
+
+private:
+  static auto normalise(const std::filesystem::path &link)
+      -> std::filesystem::path {
+    const auto path{std::filesystem::absolute(link).lexically_normal()};
+    // In case of a trailing slash
+    return path.has_filename() ? path : path.parent_path();
+  }
+
+  static auto resolve(const std::filesystem::path &link)
+      -> std::optional<std::filesystem::path> {
+    if (std::filesystem::is_symlink(link)) {
+      return std::filesystem::canonical(link);
+    }
+
+    return std::nullopt;
+  }
+
+  // Hardlinks keep the modification times of the previous generation, so the
+  // incremental build only regenerates what actually changed. This is only
+  // safe as we always replace files by renaming instead of writing in place
+  auto populate() const -> void {
+    assert(this->previous_.has_value());
+    const auto &previous{this->previous_.value()};
+    for (const auto &entry :
+         std::filesystem::recursive_directory_iterator(previous)) {
+      const auto destination{this->path_ /
+                             std::filesystem::relative(entry.path(), previous)};
+      if (entry.is_directory()) {
+        std::filesystem::create_directories(destination);
+      } else if (entry.is_regular_file()) {
+        // The build system writes dependency files in place
+        if (entry.path().extension() == ".deps") {
+          std::filesystem::copy_file(entry.path(), destination);
+          continue;
+        }
+
+        std::error_code error;
+        std::filesystem::create_hard_link(entry.path(), destination, error);
+        // For example, across file systems
+        if (error) {
+          std::filesystem::copy_file(entry.path(), destination);
+          std::filesystem::last_write_time(
+              destination, std::filesystem::last_write_time(entry.path()));
+        }
+      }
+    }
+  }
+
+  const std::filesystem::path link_;
+  const std::optional<std::filesystem::path> previous_;
+  const std::filesystem::path path_;
+};
+
+} // namespace sourcemeta::registry
+
+#endif
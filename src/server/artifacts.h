@@ -0,0 +1,140 @@
+#ifndef SOURCEMETA_REGISTRY_SERVER_ARTIFACTS_H
+#define SOURCEMETA_REGISTRY_SERVER_ARTIFACTS_H
+
+#include <atomic>        // std::atomic
+#include <cassert>       // assert
+#include <cctype>        // std::tolower
+#include <cstddef>       // std::size_t
+#include <filesystem>    // std::filesystem
+#include <functional>    // std::hash, std::equal_to
+#include <memory>        // std::shared_ptr, std::make_shared
+#include <string>        // std::string
+#include <string_view>   // std::string_view
+#include <system_error>  // std::error_code
+#include <unordered_set> // std::unordered_set
+#include <utility>       // std::move
+
+namespace sourcemeta::registry {
+
+/// The set of artifacts that the indexer produced, scanned once in the
+/// background, so that resolving a request never needs to hit the file-system
+/// to find out whether something exists. Until the scan is done, we check the
+/// file-system instead
+class ArtifactIndex {
+public:
+  // To look up string views without copying them into strings
+  struct Hash {
+    using is_transparent = void;
+    auto operator()(const std::string_view value) const noexcept
+        -> std::size_t {
+      return std::hash<std::string_view>{}(value);
+    }
+  };
+
+  using Entries = std::unordered_set<std::string, Hash, std::equal_to<>>;
+
+  ArtifactIndex(std::filesystem::path base) : base_{std::move(base)} {
+    assert(this->base_.is_absolute());
+  }
+
+  // Just to prevent mistakes
+  ArtifactIndex(const ArtifactIndex &) = delete;
+  ArtifactIndex &operator=(const ArtifactIndex &) = delete;
+  ArtifactIndex(ArtifactIndex &&) = delete;
+  ArtifactIndex &operator=(ArtifactIndex &&) = delete;
+
+  /// Compute the key of the given artifact of an entry, like
+  /// `schemas/foo/bar/%/schema.metapack`, into the given buffer
+  static auto key(std::string &buffer, const std::string_view tree,
+                  std::string_view entry, const std::string_view artifact,
+                  const bool lowercase = false) -> std::string_view {
+    while (entry.ends_with('/')) {
+      entry.remove_suffix(1);
+    }
+
+    buffer.clear();
+    buffer.reserve(tree.size() + entry.size() + artifact.size() + 4);
+    buffer.append(tree);
+    buffer.push_back('/');
+    if (!entry.empty()) {
+      if (lowercase) {
+        // Otherwise we may get unexpected results in case-sensitive
+        // file-systems
+        for (const auto character : entry) {
+          buffer.push_back(static_cast<char>(
+              std::tolower(static_cast<unsigned char>(character))));
+        }
+      } else {
+        buffer.append(entry);
+      }
+
+      buffer.push_back('/');
+    }
+
+    buffer.append("%/");
+    buffer.append(artifact);
+    return buffer;
+  }
+
+  /// Scan the output directory, returning how many artifacts we found. This
+  /// is meant to be called only once
+  auto load() -> std::size_t {
+    auto entries{std::make_shared<Entries>()};
+    for (const auto *const tree : {"schemas", "explorer"}) {
+      const auto root{this->base_ / tree};
+      if (!std::filesystem::is_directory(root)) {
+        continue;
+      }
+
+      for (const auto &entry :
+           std::filesystem::recursive_directory_iterator{root}) {
+        if (entry.is_regular_file() &&
+            entry.path().extension() == ".metapack") {
+          entries->emplace(
+              entry.path().native().substr(this->base_.native().size() + 1));
+        }
+      }
+    }
+
+    const auto size{entries->size()};
+    this->entries_.store(std::move(entries), std::memory_order_release);
+    return size;
+  }
+
+  [[nodiscard]] auto contains(const std::string_view key) const -> bool {
+    const auto entries{this->entries_.load(std::memory_order_acquire)};
+    if (entries) {
+      return entries->find(key) != entries->cend();
+    }
+
+    // Only what the scan would have found, which also guards against keys
+    // that point outside the output directory
+    if (!(key.starts_with("schemas/") || key.starts_with("explorer/")) ||
+        !key.ends_with(".metapack") || key.find("/../") != key.npos ||
+        key.find("/./") != key.npos || key.find("//") != key.npos) {
+      return false;
+    }
+
+    std::error_code error;
+    return std::filesystem::is_regular_file(this->base_ / key, error);
+  }
+
+  [[nodiscard]] auto path(const std::string_view key) const
+      -> std::filesystem::path {
+    assert(this->contains(key));
+    return this->base_ / key;
+  }
+
+  /// Every artifact we found, or nothing if we did not scan yet
+  [[nodiscard]] auto entries() const -> std::shared_ptr<const Entries> {
+    return this->entries_.load(std::memory_order_acquire);
+  }
+
+private:
+  const std::filesystem::path base_;
+  std::atomic<std::shared_ptr<const Entries>> entries_;
+};
+
+} // namespace sourcemeta::registry
+
+#endif
@@ -0,0 +1,557 @@
+#ifndef SOURCEMETA_REGISTRY_SERVER_CACHE_H
+#define SOURCEMETA_REGISTRY_SERVER_CACHE_H
+
+#include <sourcemeta/core/json.h>
+#include <sourcemeta/core/time.h>
+
+#include <sourcemeta/blaze/evaluator.h>
+
+#include <sourcemeta/registry/gzip.h>
+#include <sourcemeta/registry/shared.h>
+
+#include <atomic>        // std::atomic
+#include <cassert>       // assert
+#include <chrono>        // std::chrono
+#include <cstddef>       // std::size_t
+#include <exception>     // std::current_exception
+#include <filesystem>    // std::filesystem
+#include <functional>    // std::hash
+#include <fstream>       // std::ifstream
+#include <future>        // std::promise, std::shared_future
+#include <list>          // std::list
+#include <memory>        // std::shared_ptr, std::make_shared, std::unique_ptr
+#include <mutex>         // std::mutex, std::unique_lock, std::lock_guard
+#include <optional>      // std::optional
+#include <sstream>       // std::ostringstream
+#include <stdexcept>     // std::runtime_error
+#include <string>        // std::string
+#include <system_error>  // std::error_code
+#include <unordered_map> // std::unordered_map
+#include <utility>       // std::move, std::pair
+#include <vector>        // std::vector
+
+namespace sourcemeta::registry {
+
+/// A static response that is ready to be sent as-is, including the headers
+/// that we would otherwise compute on every request
+struct CachedResponse {
+  std::string path;
+  std::filesystem::file_time_type modified;
+  // Not set if we only read the metadata of the file
+  std::optional<std::string> body;
+  Encoding encoding;
+  // The size of the payload before and after encoding
+  std::size_t bytes;
+  std::size_t stored_bytes;
+  std::string mime;
+  std::string checksum;
+  std::string etag;
+  std::chrono::system_clock::time_point last_modified;
+  std::string last_modified_header;
+  std::optional<std::string> link;
+  // Precompressed copies of the payload stored in the same file
+  std::vector<FileVariant> variants;
+
+  // Set on every hit, and cleared by the eviction sweep
+  mutable std::atomic<bool> referenced{true};
+  // The last time we confirmed the entry matches what is on disk
+  mutable std::atomic<std::chrono::steady_clock::rep> validated{0};
+
+  [[nodiscard]] auto footprint() const noexcept -> std::size_t {
+    return sizeof(CachedResponse) + this->path.size() +
+           (this->body.has_value() ? this->body.value().size() : 0) +
+           this->mime.size() + this->checksum.size() + this->etag.size() +
+           this->last_modified_header.size() +
+           (this->link.has_value() ? this->link.value().size() : 0) +
+           this->variants.size() * sizeof(FileVariant);
+  }
+
+  static auto from(const std::filesystem::path &path, const bool with_body)
+      -> std::shared_ptr<CachedResponse> {
+    // Read the modification time before the contents, so that a concurrent
+    // write is caught on the next re-validation rather than missed forever
+    std::error_code error;
+    const auto modified{std::filesystem::last_write_time(path, error)};
+    if (error) {
+      return nullptr;
+    }
+
+    auto result{std::make_shared<CachedResponse>()};
+    result->path = path.native();
+    result->modified = modified;
+    if (with_body) {
+      auto file{read_stream_raw(path)};
+      if (!file.has_value()) {
+        return nullptr;
+      }
+
+      std::ostringstream contents;
+      // Clients cannot decode our preset dictionaries, so we only ever keep
+      // such payloads around in their original form
+      const auto internal{file.value().encoding == Encoding::DeflateDictionary};
+      if (internal) {
+        read_payload(file.value(), contents);
+      } else {
+        contents << file.value().data.rdbuf();
+      }
+
+      result->body = std::move(contents).str();
+      result->stored_bytes = result->body.value().size();
+      result->fill(file.value());
+      if (internal) {
+        result->encoding = Encoding::Identity;
+      }
+    } else {
+      auto file{read_metadata(path)};
+      if (!file.has_value()) {
+        return nullptr;
+      }
+
+      // We can neither stream nor transcode these without decoding them first
+      if (file.value().encoding == Encoding::DeflateDictionary) {
+        return from(path, true);
+      }
+
+      result->stored_bytes = file.value().data;
+      result->fill(file.value());
+    }
+
+    result->validated.store(
+        std::chrono::steady_clock::now().time_since_epoch().count(),
+        std::memory_order_relaxed);
+    return result;
+  }
+
+  /// Read one of the precompressed variants of this entry into an entry of
+  /// its own, unless the file changed since we read this entry
+  [[nodiscard]] auto variant(const FileVariant &variant) const
+      -> std::shared_ptr<CachedResponse> {
+    std::error_code error;
+    const auto current{std::filesystem::last_write_time(this->path, error)};
+    if (error || current != this->modified) {
+      return nullptr;
+    }
+
+    std::ifstream stream{this->path, std::ios::binary};
+    std::string contents(variant.stored_bytes, '\0');
+    stream.seekg(static_cast<std::streamoff>(variant.offset));
+    stream.read(contents.data(), static_cast<std::streamsize>(contents.size()));
+    if (!stream) {
+      return nullptr;
+    }
+
+    auto result{this->copy()};
+    result->body = std::move(contents);
+    result->encoding = variant.encoding;
+    result->stored_bytes = variant.stored_bytes;
+    return result;
+  }
+
+  /// Create a copy of a complete entry with its body in the given encoding
+  [[nodiscard]] auto transcode(const Encoding target) const
+      -> std::shared_ptr<CachedResponse> {
+    assert(this->body.has_value());
+    auto result{this->copy()};
+    if (target == this->encoding) {
+      result->body = this->body;
+    } else if (target == Encoding::GZIP) {
+      assert(this->encoding == Encoding::Identity);
+      result->body = gzip(this->body.value());
+    } else {
+      assert(target == Encoding::Identity);
+      assert(this->encoding == Encoding::GZIP);
+      result->body = gunzip(this->body.value());
+    }
+
+    result->encoding = target;
+    result->stored_bytes = result->body.value().size();
+    return result;
+  }
+
+private:
+  // Everything but the body and its encoding
+  [[nodiscard]] auto copy() const -> std::shared_ptr<CachedResponse> {
+    auto result{std::make_shared<CachedResponse>()};
+    result->path = this->path;
+    result->modified = this->modified;
+    result->encoding = this->encoding;
+    result->bytes = this->bytes;
+    result->stored_bytes = this->stored_bytes;
+    result->mime = this->mime;
+    result->checksum = this->checksum;
+    result->etag = this->etag;
+    result->last_modified = this->last_modified;
+    result->last_modified_header = this->last_modified_header;
+    result->link = this->link;
+    result->variants = this->variants;
+    result->validated.store(this->validated.load(std::memory_order_relaxed),
+                            std::memory_order_relaxed);
+    return result;
+  }
+
+  template <typename T> auto fill(File<T> &file) -> void {
+    this->encoding = file.encoding;
+    this->bytes = file.bytes;
+    this->mime = std::move(file.mime);
+    this->checksum = std::move(file.checksum);
+    this->etag = '"' + this->checksum + '"';
+    this->last_modified = file.last_modified;
+    this->last_modified_header = sourcemeta::core::to_gmt(file.last_modified);
+    this->variants = std::move(file.variants);
+
+    // See
+    // https://json-schema.org/draft/2020-12/json-schema-core.html#section-9.5.1.1
+    const auto &dialect{file.extension};
+    if (dialect.is_string()) {
+      this->link = "<" + dialect.to_string() + ">; rel=\"describedby\"";
+    }
+  }
+};
+
+/// A bounded, memory-budgeted and lock-free cache of static responses, meant
+/// to be shared across all the server threads. Every path maps to a single
+/// slot and entries are published atomically, so readers never block each
+/// other. Once the memory budget is reached, entries are evicted following the
+/// CLOCK (second chance) policy
+class ResponseCache {
+public:
+  // By default, a single large artifact should not flush the rest of the cache
+  ResponseCache(const std::size_t budget, const std::size_t size)
+      : ResponseCache{budget, size, budget / 8} {}
+
+  ResponseCache(const std::size_t budget, const std::size_t size,
+                const std::size_t entry_limit)
+      : budget_{budget}, size_{size}, entry_limit_{entry_limit},
+        slots_{std::make_unique<Slot[]>(size)} {
+    assert(this->size_ > 0);
+    assert(this->entry_limit_ <= this->budget_);
+  }
+
+  // Just to prevent mistakes
+  ResponseCache(const ResponseCache &) = delete;
+  ResponseCache &operator=(const ResponseCache &) = delete;
+  ResponseCache(ResponseCache &&) = delete;
+  ResponseCache &operator=(ResponseCache &&) = delete;
+
+  /// Every file might be cached once per encoding, so that we only transcode
+  /// it the first time a client asks for a specific encoding
+  auto at(const std::filesystem::path &path, const Encoding encoding)
+      -> std::shared_ptr<const CachedResponse> {
+    auto &slot{this->slot(path.native(), encoding)};
+    auto entry{slot.load(std::memory_order_acquire)};
+    if (!entry || entry->path != path.native() || entry->encoding != encoding) {
+      return nullptr;
+    }
+
+    // Hitting the file-system on every request defeats the point of this
+    // cache, so we only confirm that the artifact did not change every once
+    // in a while
+    const auto now{std::chrono::steady_clock::now().time_since_epoch()};
+    const auto validated{std::chrono::steady_clock::duration{
+        entry->validated.load(std::memory_order_relaxed)}};
+    if (now - validated > REVALIDATE_INTERVAL) {
+      std::error_code error;
+      const auto modified{std::filesystem::last_write_time(path, error)};
+      if (error || modified != entry->modified) {
+        this->evict(slot, entry);
+        return nullptr;
+      }
+
+      entry->validated.store(now.count(), std::memory_order_relaxed);
+    }
+
+    entry->referenced.store(true, std::memory_order_relaxed);
+    return entry;
+  }
+
+  auto insert(std::shared_ptr<const CachedResponse> entry) -> void {
+    assert(entry);
+    assert(entry->body.has_value());
+    const auto footprint{entry->footprint()};
+    if (footprint > this->entry_limit_) {
+      return;
+    }
+
+    // Note that concurrent insertions might slightly overshoot the budget,
+    // which we tolerate to keep this lock-free
+    for (std::size_t attempt = 0;
+         attempt < this->size_ &&
+         this->usage_.load(std::memory_order_relaxed) + footprint >
+             this->budget_;
+         attempt++) {
+      auto &victim{this->slots_[this->hand_.fetch_add(
+                                    1, std::memory_order_relaxed) %
+                                this->size_]};
+      auto current{victim.load(std::memory_order_acquire)};
+      if (current &&
+          !current->referenced.exchange(false, std::memory_order_relaxed)) {
+        this->evict(victim, current);
+      }
+    }
+
+    if (this->usage_.load(std::memory_order_relaxed) + footprint >
+        this->budget_) {
+      return;
+    }
+
+    auto &slot{this->slot(entry->path, entry->encoding)};
+    this->usage_.fetch_add(footprint, std::memory_order_relaxed);
+    const auto previous{
+        slot.exchange(std::move(entry), std::memory_order_acq_rel)};
+    if (previous) {
+      this->usage_.fetch_sub(previous->footprint(), std::memory_order_relaxed);
+    }
+  }
+
+  [[nodiscard]] auto usage() const noexcept -> std::size_t {
+    return this->usage_.load(std::memory_order_relaxed);
+  }
+
+  [[nodiscard]] auto budget() const noexcept -> std::size_t {
+    return this->budget_;
+  }
+
+  /// The paths of every cached entry, starting with the ones that were hit
+  /// since the last eviction sweep. A path cached in more than one encoding
+  /// is listed more than once
+  [[nodiscard]] auto paths() const -> std::vector<std::string> {
+    std::vector<std::string> result;
+    std::vector<std::string> rest;
+    for (std::size_t index = 0; index < this->size_; index++) {
+      const auto entry{this->slots_[index].load(std::memory_order_acquire)};
+      if (!entry) {
+        continue;
+      } else if (entry->referenced.load(std::memory_order_relaxed)) {
+        result.push_back(entry->path);
+      } else {
+        rest.push_back(entry->path);
+      }
+    }
+
+    result.insert(result.end(), rest.begin(), rest.end());
+    return result;
+  }
+
+  /// Move the entries of a directory over to another one with the same
+  /// layout, such as a new generation of the output directory, keeping only
+  /// the entries whose checksum did not change. Returns how many entries were
+  /// kept out of how many were considered
+  auto rebase(const std::filesystem::path &from,
+              const std::filesystem::path &to)
+      -> std::pair<std::size_t, std::size_t> {
+    std::pair<std::size_t, std::size_t> result{0, 0};
+    for (std::size_t index = 0; index < this->size_; index++) {
+      auto &slot{this->slots_[index]};
+      auto entry{slot.load(std::memory_order_acquire)};
+      if (!entry || !entry->path.starts_with(from.native()) ||
+          entry->path.size() <= from.native().size() ||
+          entry->path[from.native().size()] !=
+              std::filesystem::path::preferred_separator) {
+        continue;
+      }
+
+      result.second++;
+      const auto target{to /
+                        entry->path.substr(from.native().size() + 1)};
+      // Reading the modification time first, for the same reasons as when
+      // creating an entry
+      std::error_code error;
+      const auto modified{std::filesystem::last_write_time(target, error)};
+      const auto metadata{error ? std::nullopt : read_metadata(target)};
+      auto current{entry};
+      this->evict(slot, current);
+      if (!metadata.has_value() ||
+          metadata.value().checksum != entry->checksum) {
+        continue;
+      }
+
+      // Re-encoding into the same encoding is just a copy
+      auto copy{entry->transcode(entry->encoding)};
+      copy->path = target.native();
+      copy->modified = modified;
+      copy->last_modified = metadata.value().last_modified;
+      copy->last_modified_header =
+          sourcemeta::core::to_gmt(copy->last_modified);
+      this->insert(std::move(copy));
+      result.first++;
+    }
+
+    return result;
+  }
+
+private:
+  using Slot = std::atomic<std::shared_ptr<const CachedResponse>>;
+
+  auto slot(const std::string &key, const Encoding encoding) -> Slot & {
+    const auto hash{std::hash<std::string>{}(key) +
+                    static_cast<std::size_t>(encoding)};
+    return this->slots_[hash % this->size_];
+  }
+
+  auto evict(Slot &slot, std::shared_ptr<const CachedResponse> &expected)
+      -> void {
+    const auto footprint{expected->footprint()};
+    // Only account for the entry if we were the ones taking it out
+    if (slot.compare_exchange_strong(expected, nullptr,
+                                     std::memory_order_acq_rel)) {
+      this->usage_.fetch_sub(footprint, std::memory_order_relaxed);
+    }
+  }
+
+  static constexpr std::chrono::seconds REVALIDATE_INTERVAL{1};
+  const std::size_t budget_;
+  const std::size_t size_;
+  const std::size_t entry_limit_;
+  std::unique_ptr<Slot[]> slots_;
+  std::atomic<std::size_t> usage_{0};
+  std::atomic<std::size_t> hand_{0};
+};
+
+/// A memory-budgeted LRU cache of deserialised evaluation templates, keyed by
+/// the checksum of the template metapack file. Concurrent misses for the same
+/// template are coalesced, so only one of them pays for deserialisation
+class TemplateCache {
+public:
+  using Value = std::shared_ptr<const sourcemeta::blaze::Template>;
+
+  TemplateCache(const std::size_t budget) : budget_{budget} {}
+
+  // Just to prevent mistakes
+  TemplateCache(const TemplateCache &) = delete;
+  TemplateCache &operator=(const TemplateCache &) = delete;
+  TemplateCache(TemplateCache &&) = delete;
+  TemplateCache &operator=(TemplateCache &&) = delete;
+
+  auto fetch(const std::filesystem::path &path) -> Value {
+    // The checksum is part of the metapack header, so this is cheap compared
+    // to parsing and deserialising the actual template
+    auto file{read_stream_raw(path)};
+    if (!file.has_value()) {
+      throw std::runtime_error("Could not read the template: " +
+                               path.string());
+    }
+
+    const auto &key{file.value().checksum};
+    // We don't know the exact amount of memory a deserialised template takes,
+    // but its JSON size is a good enough proxy
+    const auto cost{file.value().bytes};
+
+    std::unique_lock<std::mutex> lock{this->mutex_};
+    const auto match{this->entries_.find(key)};
+    if (match != this->entries_.end()) {
+      this->hits_.fetch_add(1, std::memory_order_relaxed);
+      this->order_.splice(this->order_.begin(), this->order_,
+                          match->second.position);
+      const auto result{match->second.value};
+      lock.unlock();
+      // Might block until another thread finishes loading the same template
+      return result.get();
+    }
+
+    this->misses_.fetch_add(1, std::memory_order_relaxed);
+    // Caching a template that exceeds the budget on its own would evict every
+    // other template for nothing, so we load it every time instead, without
+    // coalescing concurrent misses
+    if (cost > this->budget_) {
+      lock.unlock();
+      return load(file.value());
+    }
+
+    std::promise<Value> promise;
+    this->order_.push_front(key);
+    this->entries_.emplace(key, Entry{.value = promise.get_future().share(),
+                                      .cost = cost,
+                                      .position = this->order_.begin(),
+                                      .path = path.native()});
+    this->usage_ += cost;
+    this->shrink();
+    lock.unlock();
+
+    try {
+      auto result{load(file.value())};
+      promise.set_value(result);
+      return result;
+    } catch (...) {
+      promise.set_exception(std::current_exception());
+      // Let the next request try again
+      lock.lock();
+      const auto failed{this->entries_.find(key)};
+      if (failed != this->entries_.end()) {
+        this->usage_ -= failed->second.cost;
+        this->order_.erase(failed->second.position);
+        this->entries_.erase(failed);
+      }
+
+      throw;
+    }
+  }
+
+  [[nodiscard]] auto hits() const noexcept -> std::size_t {
+    return this->hits_.load(std::memory_order_relaxed);
+  }
+
+  [[nodiscard]] auto misses() const noexcept -> std::size_t {
+    return this->misses_.load(std::memory_order_relaxed);
+  }
+
+  /// The paths that every cached template was loaded from, starting with the
+  /// most recently used one
+  [[nodiscard]] auto paths() -> std::vector<std::string> {
+    std::lock_guard<std::mutex> lock{this->mutex_};
+    std::vector<std::string> result;
+    result.reserve(this->order_.size());
+    for (const auto &key : this->order_) {
+      result.push_back(this->entries_.at(key).path);
+    }
+
+    return result;
+  }
+
+private:
+  struct Entry {
+    std::shared_future<Value> value;
+    std::size_t cost;
+    std::list<std::string>::iterator position;
+    // The first path we loaded this template from
+    std::string path;
+  };
+
+  static auto load(File<std::ifstream> &file) -> Value {
+    std::ostringstream buffer;
+    read_payload(file, buffer);
+
+    const auto template_json{sourcemeta::core::parse_json(buffer.str())};
+    auto result{sourcemeta::blaze::from_json(template_json)};
+    if (!result.has_value()) {
+      throw std::runtime_error("Invalid evaluation template");
+    }
+
+    return std::make_shared<const sourcemeta::blaze::Template>(
+        std::move(result).value());
+  }
+
+  // Must be called with the mutex held. As no entry exceeds the budget on its
+  // own, this never evicts the most recently used entry
+  auto shrink() -> void {
+    while (this->usage_ > this->budget_) {
+      assert(this->order_.size() > 1);
+      const auto victim{this->entries_.find(this->order_.back())};
+      assert(victim != this->entries_.end());
+      this->usage_ -= victim->second.cost;
+      this->entries_.erase(victim);
+      this->order_.pop_back();
+    }
+  }
+
+  const std::size_t budget_;
+  std::size_t usage_{0};
+  std::mutex mutex_;
+  std::list<std::string> order_;
+  std::unordered_map<std::string, Entry> entries_;
+  std::atomic<std::size_t> hits_{0};
+  std::atomic<std::size_t> misses_{0};
+};
+
+} // namespace sourcemeta::registry
+
+#endif
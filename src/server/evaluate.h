@@ -9,19 +9,46 @@
 
 #include <sourcemeta/registry/shared.h>
 
+#include "timing.h"
+
 #include <cassert>     // assert
+#include <cstddef>     // std::size_t
 #include <filesystem>  // std::filesystem::path
+#include <functional>  // std::ref, std::function
+#include <limits>      // std::numeric_limits
+#include <optional>    // std::optional
+#include <ostream>     // std::ostream
+#include <sstream>     // std::ostringstream
+#include <string>      // std::string
+#include <string_view> // std::string_view
 #include <type_traits> // std::underlying_type_t
 #include <utility>     // std::move
 
+namespace sourcemeta::registry {
+
+/// Describing every step of an evaluation is far more expensive than the
+/// evaluation itself, so these narrow down which steps we describe
+struct TraceOptions {
+  // Only the steps that failed
+  bool failures{false};
+  // Stop describing steps after this many
+  std::size_t limit{std::numeric_limits<std::size_t>::max()};
+  // Only the steps about this location of the instance or any of its children
+  std::optional<sourcemeta::core::Pointer> instance_location;
+};
+
+} // namespace sourcemeta::registry
+
 namespace {
 
 auto trace(sourcemeta::blaze::Evaluator &evaluator,
            const sourcemeta::blaze::Template &schema_template,
            const std::string &instance,
-           const std::filesystem::path &template_path)
-    -> sourcemeta::core::JSON {
-  auto steps{sourcemeta::core::JSON::make_array()};
+           const std::filesystem::path &template_path,
+           const sourcemeta::registry::TraceOptions &options,
+           const std::function<void(sourcemeta::core::JSON &&)> &callback,
+           sourcemeta::registry::ServerTiming &timing) -> bool {
+  std::size_t count{0};
 
   auto locations_path{template_path.parent_path() / "locations.metapack"};
   // TODO: Cache this across runs?
@@ -30,16 +57,38 @@ auto trace(sourcemeta::blaze::Evaluator &evaluator,
   const auto &static_locations{locations.at("static")};
 
   sourcemeta::core::PointerPositionTracker tracker;
-  const auto instance_json{
-      sourcemeta::core::parse_json(instance, std::ref(tracker))};
-  const auto result{evaluator.validate(
+  const auto instance_json{[&instance, &tracker, &timing] {
+    const auto timer{timing.scope("parse")};
+    return sourcemeta::core::parse_json(instance, std::ref(tracker));
+  }()};
+  const auto timer{timing.scope("evaluate")};
+  return evaluator.validate(
       schema_template, instance_json,
-      [&steps, &tracker, &static_locations, &instance_json](
-          const sourcemeta::blaze::EvaluationType type, const bool valid,
-          const sourcemeta::blaze::Instruction &instruction,
-          const sourcemeta::core::WeakPointer &evaluate_path,
-          const sourcemeta::core::WeakPointer &instance_location,
-          const sourcemeta::core::JSON &annotation) {
+      [&options, &callback, &count, &tracker, &static_locations,
+       &instance_json](const sourcemeta::blaze::EvaluationType type,
+                       const bool valid,
+                       const sourcemeta::blaze::Instruction &instruction,
+                       const sourcemeta::core::WeakPointer &evaluate_path,
+                       const sourcemeta::core::WeakPointer &instance_location,
+                       const sourcemeta::core::JSON &annotation) {
+        // We still run the rest of the evaluation, as it is cheap without
+        // describing its steps, to tell whether the instance is valid
+        if (count >= options.limit ||
+            (options.failures &&
+             (type == sourcemeta::blaze::EvaluationType::Pre || valid))) {
+          return;
+        }
+
+        // TODO: Can we avoid converting the weak pointer into a pointer
+        // here?
+        const auto instance_pointer{
+            sourcemeta::core::to_pointer(instance_location)};
+        if (options.instance_location.has_value() &&
+            !instance_pointer.starts_with(options.instance_location.value())) {
+          return;
+        }
+
+        count += 1;
         auto step{sourcemeta::core::JSON::make_object()};
 
         if (type == sourcemeta::blaze::EvaluationType::Pre) {
@@ -58,10 +107,7 @@ auto trace(sourcemeta::blaze::Evaluator &evaluator,
         step.assign("evaluatePath", sourcemeta::core::to_json(evaluate_path));
         step.assign("instanceLocation",
                     sourcemeta::core::to_json(instance_location));
-        auto instance_positions{tracker.get(
-            // TODO: Can we avoid converting the weak pointer into a pointer
-            // here?
-            sourcemeta::core::to_pointer(instance_location))};
+        auto instance_positions{tracker.get(instance_pointer)};
         assert(instance_positions.has_value());
         step.assign(
             "instancePositions",
@@ -91,43 +137,67 @@ auto trace(sourcemeta::blaze::Evaluator &evaluator,
         step.assign("vocabulary",
                     sourcemeta::core::to_json(walker_result.vocabulary));
 
-        steps.push_back(std::move(step));
-      })};
-
-  auto document{sourcemeta::core::JSON::make_object()};
-  document.assign("valid", sourcemeta::core::JSON{result});
-  document.assign("steps", std::move(steps));
-  return document;
+        callback(std::move(step));
+      });
 }
 
 } // namespace
 
 namespace sourcemeta::registry {
 
-enum class EvaluateType { Standard, Trace };
-
-auto evaluate(const std::filesystem::path &template_path,
-              const std::string &instance, const EvaluateType type)
-    -> sourcemeta::core::JSON {
-  assert(std::filesystem::exists(template_path));
+enum class EvaluateType {
+  // The Basic standard output
+  Standard,
+  // Only whether the instance is valid, for which the fast template is enough
+  Flag,
+  Trace
+};
 
-  // TODO: Cache this conversion across runs, potentially using the schema file
-  // "checksum" as the cache key. This is important as the template might be
-  // compressed
-  const auto template_json{read_json(template_path)};
-  const auto schema_template{sourcemeta::blaze::from_json(template_json)};
-  assert(schema_template.has_value());
+auto flag(const bool valid) -> sourcemeta::core::JSON {
+  auto result{sourcemeta::core::JSON::make_object()};
+  result.assign("valid", sourcemeta::core::JSON{valid});
+  return result;
+}
 
+auto evaluate(const sourcemeta::blaze::Template &schema_template,
+              const std::filesystem::path &template_path,
+              const std::string &instance, const EvaluateType type,
+              const TraceOptions &trace_options, ServerTiming &timing)
+    -> sourcemeta::core::JSON {
   sourcemeta::blaze::Evaluator evaluator;
 
   switch (type) {
-    case EvaluateType::Standard:
+    case EvaluateType::Standard: {
+      const auto instance_json{[&instance, &timing] {
+        const auto timer{timing.scope("parse")};
+        return sourcemeta::core::parse_json(instance);
+      }()};
+      const auto timer{timing.scope("evaluate")};
       return sourcemeta::blaze::standard(
-          evaluator, schema_template.value(),
-          sourcemeta::core::parse_json(instance),
+          evaluator, schema_template, instance_json,
           sourcemeta::blaze::StandardOutput::Basic);
-    case EvaluateType::Trace:
-      return trace(evaluator, schema_template.value(), instance, template_path);
+    }
+    case EvaluateType::Flag: {
+      const auto instance_json{[&instance, &timing] {
+        const auto timer{timing.scope("parse")};
+        return sourcemeta::core::parse_json(instance);
+      }()};
+      const auto timer{timing.scope("evaluate")};
+      return flag(evaluator.validate(schema_template, instance_json));
+    }
+    case EvaluateType::Trace: {
+      auto steps{sourcemeta::core::JSON::make_array()};
+      const auto valid{trace(evaluator, schema_template, instance,
+                             template_path, trace_options,
+                             [&steps](sourcemeta::core::JSON &&step) {
+                               steps.push_back(std::move(step));
+                             },
+                             timing)};
+      auto document{sourcemeta::core::JSON::make_object()};
+      document.assign("valid", sourcemeta::core::JSON{valid});
+      document.assign("steps", std::move(steps));
+      return document;
+    }
     default:
       // We should never get here
       assert(false);
@@ -135,6 +205,87 @@ auto evaluate(const std::filesystem::path &template_path,
   }
 }
 
+/// Trace the evaluation of an instance as JSON Lines, one step per line,
+/// handing over the output in parts of about the given size as we go, so that
+/// we never hold the entire trace in memory. The last line tells whether the
+/// instance is valid
+auto trace_lines(const sourcemeta::blaze::Template &schema_template,
+                 const std::filesystem::path &template_path,
+                 const std::string &instance, const TraceOptions &options,
+                 const std::size_t chunk_size,
+                 const std::function<void(std::string &&, bool)> &callback,
+                 ServerTiming &timing) -> void {
+  sourcemeta::blaze::Evaluator evaluator;
+  std::ostringstream output;
+  const auto valid{trace(
+      evaluator, schema_template, instance, template_path, options,
+      [chunk_size, &callback, &output](sourcemeta::core::JSON &&step) {
+        sourcemeta::core::stringify(step, output);
+        output << '\n';
+        if (static_cast<std::size_t>(output.tellp()) >= chunk_size) {
+          callback(std::move(output).str(), false);
+          output.str("");
+        }
+      },
+      timing)};
+
+  sourcemeta::core::stringify(flag(valid), output);
+  output << '\n';
+  callback(std::move(output).str(), true);
+}
+
+/// Evaluate every line of a JSON Lines input against the same template,
+/// reusing the given evaluator, and write a compact result per line, in
+/// order. Lines that are not valid JSON get an error instead of a result, and
+/// empty lines are skipped. Returns the number of results written
+auto evaluate_lines(sourcemeta::blaze::Evaluator &evaluator,
+                    const sourcemeta::blaze::Template &schema_template,
+                    std::string_view input, const EvaluateType type,
+                    std::ostream &output, ServerTiming &timing)
+    -> std::size_t {
+  assert(type != EvaluateType::Trace);
+  std::size_t count{0};
+  while (!input.empty()) {
+    const auto end{input.find('\n')};
+    auto line{input.substr(0, end)};
+    input.remove_prefix(end == std::string_view::npos ? input.size()
+                                                      : end + 1);
+    if (line.find_first_not_of(" \t\r") == std::string_view::npos) {
+      continue;
+    }
+
+    count += 1;
+    std::optional<sourcemeta::core::JSON> instance;
+    try {
+      const auto timer{timing.scope("parse")};
+      instance = sourcemeta::core::parse_json(std::string{line});
+    } catch (const sourcemeta::core::JSONParseError &error) {
+      auto object{sourcemeta::core::JSON::make_object()};
+      object.assign("title", sourcemeta::core::JSON{
+                                 "sourcemeta:registry/invalid-instance"});
+      object.assign("detail", sourcemeta::core::JSON{error.what()});
+      sourcemeta::core::stringify(object, output);
+      output << '\n';
+      continue;
+    }
+
+    const auto result{[&evaluator, &schema_template, &instance, type,
+                       &timing] {
+      const auto timer{timing.scope("evaluate")};
+      return type == EvaluateType::Flag
+                 ? flag(evaluator.validate(schema_template, instance.value()))
+                 : sourcemeta::blaze::standard(
+                       evaluator, schema_template, instance.value(),
+                       sourcemeta::blaze::StandardOutput::Basic);
+    }()};
+    const auto timer{timing.scope("serialise")};
+    sourcemeta::core::stringify(result, output);
+    output << '\n';
+  }
+
+  return count;
+}
+
 } // namespace sourcemeta::registry
 
 #endif
@@ -0,0 +1,90 @@
+#ifndef SOURCEMETA_REGISTRY_SERVER_GENERATION_H
+#define SOURCEMETA_REGISTRY_SERVER_GENERATION_H
+
+#include "artifacts.h"
+#include "search.h"
+#include "validators.h"
+
+#include <atomic>       // std::atomic
+#include <cassert>      // assert
+#include <filesystem>   // std::filesystem
+#include <memory>       // std::shared_ptr, std::make_shared
+#include <system_error> // std::error_code
+#include <utility>      // std::move
+
+namespace sourcemeta::registry {
+
+/// An output directory as the server found it when loading it. As long as the
+/// indexer never modifies a directory that it published, every request sees
+/// a consistent set of artifacts for as long as it holds on to its generation
+struct Generation {
+  Generation(std::filesystem::path path)
+      : base{std::move(path)}, artifacts{this->base},
+        is_headless{!this->artifacts.contains(
+            "explorer/%/directory-html.metapack")},
+        search{this->base / "explorer" / "%" / "search-index.metapack"},
+        completion{this->base / "explorer" / "%" / "search-complete.metapack"} {
+    assert(this->base.is_absolute());
+  }
+
+  const std::filesystem::path base;
+  // These are loaded in the background after creating the generation
+  mutable ArtifactIndex artifacts;
+  mutable ValidatorTable validators;
+  const bool is_headless;
+  // These lazily map their indexes on first use
+  mutable SearchService search;
+  mutable CompletionService completion;
+};
+
+/// Tracks the current generation of an output directory, which might be a
+/// symbolic link that the indexer atomically points to a new directory
+class Generations {
+public:
+  Generations(std::filesystem::path root)
+      : root_{std::move(root)},
+        current_{std::make_shared<const Generation>(
+            std::filesystem::canonical(this->root_))} {}
+
+  // Just to prevent mistakes
+  Generations(const Generations &) = delete;
+  Generations &operator=(const Generations &) = delete;
+  Generations(Generations &&) = delete;
+  Generations &operator=(Generations &&) = delete;
+
+  [[nodiscard]] auto current() const -> std::shared_ptr<const Generation> {
+    return this->current_.load(std::memory_order_acquire);
+  }
+
+  /// Whether the root now resolves to a different directory than the current
+  /// generation
+  [[nodiscard]] auto changed() const -> bool {
+    std::error_code error;
+    const auto target{std::filesystem::canonical(this->root_, error)};
+    // The root might be briefly missing while the indexer swaps it
+    return !error && target != this->current()->base;
+  }
+
+  /// Load the directory that the root resolves to as a new generation,
+  /// without publishing it yet
+  [[nodiscard]] auto load() const -> std::shared_ptr<const Generation> {
+    return std::make_shared<const Generation>(
+        std::filesystem::canonical(this->root_));
+  }
+
+  /// Returns the previous generation, which stays valid for as long as any
+  /// in-flight request holds on to it
+  auto publish(std::shared_ptr<const Generation> generation)
+      -> std::shared_ptr<const Generation> {
+    return this->current_.exchange(std::move(generation),
+                                   std::memory_order_acq_rel);
+  }
+
+private:
+  const std::filesystem::path root_;
+  std::atomic<std::shared_ptr<const Generation>> current_;
+};
+
+} // namespace sourcemeta::registry
+
+#endif
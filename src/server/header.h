@@ -0,0 +1,76 @@
+#ifndef SOURCEMETA_REGISTRY_SERVER_HEADER_H
+#define SOURCEMETA_REGISTRY_SERVER_HEADER_H
+
+#include <charconv>     // std::from_chars
+#include <optional>     // std::optional
+#include <string_view>  // std::string_view
+#include <system_error> // std::errc
+
+namespace sourcemeta::registry {
+
+/// Walks the elements of a comma-separated header list, like `Accept-Encoding`
+/// or `If-None-Match`, in order and without allocating. A header list element
+/// consists of the element value and its quality value. See
+/// https://developer.mozilla.org/en-US/docs/Glossary/Quality_values
+class HeaderList {
+public:
+  struct Element {
+    std::string_view value;
+    float quality;
+  };
+
+  HeaderList(const std::string_view value) : rest_{value} {}
+
+  auto next() -> std::optional<Element> {
+    while (!this->rest_.empty()) {
+      const auto separator{this->rest_.find(',')};
+      auto token{this->rest_.substr(0, separator)};
+      this->rest_.remove_prefix(separator == std::string_view::npos
+                                    ? this->rest_.size()
+                                    : separator + 1);
+
+      // No quality value is 1.0 by default
+      float quality{1.0f};
+      const auto parameters{token.find(';')};
+      if (parameters != std::string_view::npos) {
+        const auto parameter{trim(token.substr(parameters + 1))};
+        if (parameter.starts_with("q=")) {
+          const auto result{std::from_chars(
+              parameter.data() + 2, parameter.data() + parameter.size(),
+              quality)};
+          if (result.ec != std::errc{}) {
+            quality = 1.0f;
+          }
+        }
+
+        token = token.substr(0, parameters);
+      }
+
+      token = trim(token);
+      if (!token.empty()) {
+        return Element{.value = token, .quality = quality};
+      }
+    }
+
+    return std::nullopt;
+  }
+
+private:
+  static auto trim(std::string_view value) -> std::string_view {
+    while (!value.empty() && (value.front() == ' ' || value.front() == '\t')) {
+      value.remove_prefix(1);
+    }
+
+    while (!value.empty() && (value.back() == ' ' || value.back() == '\t')) {
+      value.remove_suffix(1);
+    }
+
+    return value;
+  }
+
+  std::string_view rest_;
+};
+
+} // namespace sourcemeta::registry
+
+#endif
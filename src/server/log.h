@@ -0,0 +1,271 @@
+#ifndef SOURCEMETA_REGISTRY_SERVER_LOG_H
+#define SOURCEMETA_REGISTRY_SERVER_LOG_H
+
+#include <sourcemeta/core/json.h>
+#include <sourcemeta/core/time.h>
+
+#include <array>              // std::array
+#include <atomic>             // std::atomic
+#include <chrono>             // std::chrono
+#include <condition_variable> // std::condition_variable
+#include <cstddef>            // std::size_t
+#include <cstdint>            // std::uint16_t, std::uint64_t, std::int64_t
+#include <memory>             // std::unique_ptr, std::make_unique
+#include <mutex>              // std::mutex, std::lock_guard, std::unique_lock
+#include <ostream>            // std::ostream
+#include <sstream>            // std::ostringstream
+#include <string>             // std::string
+#include <string_view>        // std::string_view
+#include <thread>             // std::thread, std::this_thread
+#include <utility>            // std::move
+#include <vector>             // std::vector
+
+namespace sourcemeta::registry {
+
+/// A bounded queue with exactly one producer and one consumer thread, that
+/// never blocks, and that never allocates once every slot was used at least
+/// once, as slots are re-used in place
+template <typename T, std::size_t Capacity> class RingBuffer {
+  static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0,
+                "The capacity must be a power of two");
+
+public:
+  /// Fill the next free slot, or return false if the buffer is full
+  template <typename Callback> auto push(Callback &&callback) -> bool {
+    const auto tail{this->tail_.load(std::memory_order_relaxed)};
+    if (tail - this->head_.load(std::memory_order_acquire) == Capacity) {
+      return false;
+    }
+
+    callback(this->slots_[tail & (Capacity - 1)]);
+    this->tail_.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  /// Consume every slot that is ready, returning how many there were
+  template <typename Callback> auto drain(Callback &&callback) -> std::size_t {
+    const auto head{this->head_.load(std::memory_order_relaxed)};
+    const auto tail{this->tail_.load(std::memory_order_acquire)};
+    for (auto index{head}; index != tail; index++) {
+      callback(this->slots_[index & (Capacity - 1)]);
+    }
+
+    this->head_.store(tail, std::memory_order_release);
+    return tail - head;
+  }
+
+private:
+  std::array<T, Capacity> slots_;
+  // On separate cache lines, as each is written by a different thread
+  alignas(64) std::atomic<std::size_t> head_{0};
+  alignas(64) std::atomic<std::size_t> tail_{0};
+};
+
+/// Writes JSON lines out of per-thread buffers from a background thread, so
+/// that logging never blocks or serialises the threads that answer requests.
+/// Lines that do not fit in the buffers are dropped and counted instead
+class Logger {
+public:
+  struct Record {
+    std::chrono::system_clock::time_point timestamp;
+    std::thread::id thread;
+    // Zero for plain messages
+    std::uint16_t status;
+    std::string method;
+    // The URL for access records, or the message itself otherwise
+    std::string message;
+    std::chrono::steady_clock::duration latency;
+    std::uint64_t bytes;
+  };
+
+  /// Only every nth access record is logged, while server errors and plain
+  /// messages are always logged. A sample of zero disables access records
+  Logger(std::ostream &stream, const std::size_t sample)
+      : stream_{stream}, sample_{sample}, writer_{[this] { this->work(); }} {}
+
+  ~Logger() {
+    {
+      std::lock_guard<std::mutex> guard{this->mutex_};
+      this->running_ = false;
+    }
+
+    this->condition_.notify_one();
+    this->writer_.join();
+  }
+
+  // Just to prevent mistakes
+  Logger(const Logger &) = delete;
+  Logger &operator=(const Logger &) = delete;
+  Logger(Logger &&) = delete;
+  Logger &operator=(Logger &&) = delete;
+
+  auto message(const std::string_view message) -> void {
+    this->push(0, {}, message, {}, 0);
+  }
+
+  auto access(const std::uint16_t status, const std::string_view method,
+              const std::string_view url,
+              const std::chrono::steady_clock::duration latency,
+              const std::uint64_t bytes) -> void {
+    if (status < 500) {
+      if (this->sample_ == 0) {
+        return;
+      }
+
+      thread_local std::size_t counter{0};
+      if (counter++ % this->sample_ != 0) {
+        return;
+      }
+    }
+
+    this->push(status, method, url, latency, bytes);
+  }
+
+  /// The number of lines that were lost because a buffer was full
+  [[nodiscard]] auto dropped() const -> std::uint64_t {
+    std::lock_guard<std::mutex> guard{this->mutex_};
+    std::uint64_t result{0};
+    for (const auto &buffer : this->buffers_) {
+      result += buffer->dropped.load(std::memory_order_relaxed);
+    }
+
+    return result;
+  }
+
+private:
+  static constexpr std::size_t BUFFER_CAPACITY{1024};
+  static constexpr std::chrono::milliseconds FLUSH_INTERVAL{100};
+
+  struct Buffer {
+    RingBuffer<Record, BUFFER_CAPACITY> records;
+    std::atomic<std::uint64_t> dropped{0};
+  };
+
+  // Each thread registers its own buffer the first time it logs, which is the
+  // only time a producer ever takes the lock. This assumes a single logger
+  auto buffer() -> Buffer & {
+    thread_local Buffer *current{nullptr};
+    if (current == nullptr) {
+      auto buffer{std::make_unique<Buffer>()};
+      current = buffer.get();
+      std::lock_guard<std::mutex> guard{this->mutex_};
+      this->buffers_.push_back(std::move(buffer));
+    }
+
+    return *current;
+  }
+
+  auto push(const std::uint16_t status, const std::string_view method,
+            const std::string_view message,
+            const std::chrono::steady_clock::duration latency,
+            const std::uint64_t bytes) -> void {
+    auto &buffer{this->buffer()};
+    const auto pushed{buffer.records.push([&](Record &record) {
+      record.timestamp = std::chrono::system_clock::now();
+      record.thread = std::this_thread::get_id();
+      record.status = status;
+      record.method.assign(method);
+      record.message.assign(message);
+      record.latency = latency;
+      record.bytes = bytes;
+    })};
+
+    if (!pushed) {
+      buffer.dropped.fetch_add(1, std::memory_order_relaxed);
+    }
+  }
+
+  auto write(const Record &record) -> void {
+    auto line{sourcemeta::core::JSON::make_object()};
+    line.assign("timestamp",
+                sourcemeta::core::JSON{sourcemeta::core::to_gmt(
+                    record.timestamp)});
+    std::ostringstream thread;
+    thread << record.thread;
+    line.assign("thread", sourcemeta::core::JSON{std::move(thread).str()});
+    if (record.status == 0) {
+      line.assign("message", sourcemeta::core::JSON{record.message});
+    } else {
+      line.assign("status", sourcemeta::core::JSON{
+                                static_cast<std::int64_t>(record.status)});
+      line.assign("method", sourcemeta::core::JSON{record.method});
+      line.assign("url", sourcemeta::core::JSON{record.message});
+      line.assign("latencyMicroseconds",
+                  sourcemeta::core::JSON{static_cast<std::int64_t>(
+                      std::chrono::duration_cast<std::chrono::microseconds>(
+                          record.latency)
+                          .count())});
+      line.assign("bytes", sourcemeta::core::JSON{
+                               static_cast<std::int64_t>(record.bytes)});
+    }
+
+    sourcemeta::core::stringify(line, this->stream_);
+    this->stream_ << '\n';
+  }
+
+  auto flush() -> void {
+    std::vector<Buffer *> buffers;
+    {
+      std::lock_guard<std::mutex> guard{this->mutex_};
+      buffers.reserve(this->buffers_.size());
+      for (const auto &buffer : this->buffers_) {
+        buffers.push_back(buffer.get());
+      }
+    }
+
+    std::size_t count{0};
+    std::uint64_t dropped{0};
+    for (auto *const buffer : buffers) {
+      count += buffer->records.drain(
+          [this](const Record &record) { this->write(record); });
+      dropped += buffer->dropped.load(std::memory_order_relaxed);
+    }
+
+    // Report losses as soon as we notice them
+    if (dropped != this->dropped_reported_) {
+      auto line{sourcemeta::core::JSON::make_object()};
+      line.assign("timestamp",
+                  sourcemeta::core::JSON{sourcemeta::core::to_gmt(
+                      std::chrono::system_clock::now())});
+      line.assign("dropped",
+                  sourcemeta::core::JSON{static_cast<std::int64_t>(dropped)});
+      sourcemeta::core::stringify(line, this->stream_);
+      this->stream_ << '\n';
+      this->dropped_reported_ = dropped;
+      count++;
+    }
+
+    if (count > 0) {
+      this->stream_.flush();
+    }
+  }
+
+  auto work() -> void {
+    std::unique_lock<std::mutex> lock{this->mutex_};
+    while (this->running_) {
+      this->condition_.wait_for(lock, FLUSH_INTERVAL);
+      lock.unlock();
+      this->flush();
+      lock.lock();
+    }
+
+    lock.unlock();
+    // Whatever was logged right before stopping
+    this->flush();
+  }
+
+  std::ostream &stream_;
+  const std::size_t sample_;
+  mutable std::mutex mutex_;
+  std::condition_variable condition_;
+  bool running_{true};
+  std::vector<std::unique_ptr<Buffer>> buffers_;
+  // Only accessed by the writer thread
+  std::uint64_t dropped_reported_{0};
+  // Must be last, so it starts once everything else is initialised
+  std::thread writer_;
+};
+
+} // namespace sourcemeta::registry
+
+#endif
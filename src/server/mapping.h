@@ -0,0 +1,79 @@
+#ifndef SOURCEMETA_REGISTRY_SERVER_MAPPING_H
+#define SOURCEMETA_REGISTRY_SERVER_MAPPING_H
+
+#include <fcntl.h>    // open, O_RDONLY
+#include <sys/mman.h> // mmap, munmap, madvise
+#include <sys/stat.h> // fstat
+#include <unistd.h>   // close
+
+#include <cassert>     // assert
+#include <cstddef>     // std::size_t
+#include <filesystem>  // std::filesystem
+#include <memory>      // std::shared_ptr, std::make_shared
+#include <string_view> // std::string_view
+
+namespace sourcemeta::registry {
+
+/// A read-only memory mapping of an entire file. Its contents stay valid for
+/// the lifetime of the mapping even if the file is replaced or deleted,
+/// as long as writers never modify files in place
+class MappedFile {
+public:
+  static auto open(const std::filesystem::path &path)
+      -> std::shared_ptr<const MappedFile> {
+    const auto descriptor{::open(path.c_str(), O_RDONLY)};
+    if (descriptor == -1) {
+      return nullptr;
+    }
+
+    struct stat status;
+    if (fstat(descriptor, &status) != 0 || status.st_size <= 0) {
+      close(descriptor);
+      return nullptr;
+    }
+
+    const auto size{static_cast<std::size_t>(status.st_size)};
+    auto *const address{
+        mmap(nullptr, size, PROT_READ, MAP_PRIVATE, descriptor, 0)};
+    // The mapping holds its own reference to the file
+    close(descriptor);
+    if (address == MAP_FAILED) {
+      return nullptr;
+    }
+
+    // We mostly read these files from start to end
+    madvise(address, size, MADV_SEQUENTIAL);
+    return std::make_shared<const MappedFile>(address, size);
+  }
+
+  MappedFile(void *const address, const std::size_t size)
+      : address_{address}, size_{size} {
+    assert(this->address_ != nullptr);
+  }
+
+  ~MappedFile() { munmap(this->address_, this->size_); }
+
+  // Just to prevent mistakes
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+  MappedFile(MappedFile &&) = delete;
+  MappedFile &operator=(MappedFile &&) = delete;
+
+  [[nodiscard]] auto view() const noexcept -> std::string_view {
+    return {static_cast<const char *>(this->address_), this->size_};
+  }
+
+  /// Ask the kernel to start reading the entire file into the page cache in
+  /// the background, which outlives the mapping itself
+  auto prefetch() const noexcept -> void {
+    madvise(this->address_, this->size_, MADV_WILLNEED);
+  }
+
+private:
+  void *const address_;
+  const std::size_t size_;
+};
+
+} // namespace sourcemeta::registry
+
+#endif
@@ -0,0 +1,297 @@
+#ifndef SOURCEMETA_REGISTRY_SERVER_METRICS_H
+#define SOURCEMETA_REGISTRY_SERVER_METRICS_H
+
+#include <array>       // std::array
+#include <atomic>      // std::atomic
+#include <bit>         // std::bit_width
+#include <chrono>      // std::chrono
+#include <cstddef>     // std::size_t
+#include <cstdint>     // std::uint8_t, std::uint16_t, std::uint64_t
+#include <memory>      // std::unique_ptr, std::make_unique
+#include <mutex>       // std::mutex, std::lock_guard
+#include <ostream>     // std::ostream
+#include <string_view> // std::string_view
+#include <utility>     // std::move
+#include <vector>      // std::vector
+
+namespace sourcemeta::registry {
+
+/// The groups of routes that we keep separate metrics for
+enum class RouteFamily : std::uint8_t {
+  Schema,
+  Explorer,
+  List,
+  Metadata,
+  Search,
+  Complete,
+  Evaluate,
+  Trace,
+  Static,
+  Metrics,
+  Other
+};
+
+/// Events that we count regardless of the route
+enum class MetricsCounter : std::uint8_t {
+  Compressions,
+  Decompressions,
+  ResponseCacheHits,
+  ResponseCacheMisses
+};
+
+/// Writes a single sample in the Prometheus text exposition format
+inline auto expose_metric(std::ostream &stream, const std::string_view name,
+                          const std::string_view type,
+                          const std::string_view help, const auto value)
+    -> void {
+  stream << "# HELP " << name << ' ' << help << "\n# TYPE " << name << ' '
+         << type << '\n'
+         << name << ' ' << value << '\n';
+}
+
+/// Counters and latency histograms for every route family, recorded into
+/// per-thread shards that are only ever written by their own thread, and only
+/// summed up when scraped
+class Metrics {
+public:
+  Metrics() = default;
+
+  // Just to prevent mistakes
+  Metrics(const Metrics &) = delete;
+  Metrics &operator=(const Metrics &) = delete;
+  Metrics(Metrics &&) = delete;
+  Metrics &operator=(Metrics &&) = delete;
+
+  auto response(const RouteFamily route, const std::uint16_t status,
+                const std::chrono::steady_clock::duration latency,
+                const std::uint64_t bytes) -> void {
+    auto &counters{this->shard().routes[static_cast<std::size_t>(route)]};
+    // Anything outside the standard classes counts as a server error
+    const std::size_t status_class{
+        status >= 100 && status < 600 ? status / 100u - 1u : 4u};
+    increment(counters.responses[status_class]);
+    if (status == 304) {
+      increment(counters.not_modified);
+    }
+
+    const auto microseconds{to_microseconds(latency)};
+    increment(counters.latency[bucket(microseconds)]);
+    increment(counters.latency_sum, microseconds);
+    increment(counters.bytes, bytes);
+  }
+
+  /// Record how long an evaluation waited for a worker
+  auto queue(const std::chrono::steady_clock::duration wait) -> void {
+    auto &shard{this->shard()};
+    const auto microseconds{to_microseconds(wait)};
+    increment(shard.queue[bucket(microseconds)]);
+    increment(shard.queue_sum, microseconds);
+  }
+
+  auto count(const MetricsCounter counter) -> void {
+    increment(this->shard().counters[static_cast<std::size_t>(counter)]);
+  }
+
+  [[nodiscard]] auto total(const MetricsCounter counter) const
+      -> std::uint64_t {
+    std::lock_guard<std::mutex> guard{this->mutex_};
+    std::uint64_t result{0};
+    for (const auto &shard : this->shards_) {
+      result += shard->counters[static_cast<std::size_t>(counter)].load(
+          std::memory_order_relaxed);
+    }
+
+    return result;
+  }
+
+  /// Write every route metric in the Prometheus text exposition format
+  auto expose(std::ostream &stream) const -> void {
+    std::array<Totals, ROUTE_FAMILIES.size()> totals{};
+    std::array<std::uint64_t, LATENCY_BUCKETS + 1> queue{};
+    std::uint64_t queue_sum{0};
+    {
+      std::lock_guard<std::mutex> guard{this->mutex_};
+      for (const auto &shard : this->shards_) {
+        for (std::size_t route = 0; route < totals.size(); route++) {
+          totals[route].add(shard->routes[route]);
+        }
+
+        for (std::size_t index = 0; index < queue.size(); index++) {
+          queue[index] += shard->queue[index].load(std::memory_order_relaxed);
+        }
+
+        queue_sum += shard->queue_sum.load(std::memory_order_relaxed);
+      }
+    }
+
+    stream << "# HELP sourcemeta_registry_responses_total The number of "
+              "responses by route and status class\n"
+              "# TYPE sourcemeta_registry_responses_total counter\n";
+    for (std::size_t route = 0; route < totals.size(); route++) {
+      for (std::size_t status = 0; status < STATUS_CLASSES; status++) {
+        stream << "sourcemeta_registry_responses_total{route=\""
+               << ROUTE_FAMILIES[route] << "\",status=\"" << status + 1
+               << "xx\"} " << totals[route].responses[status] << '\n';
+      }
+    }
+
+    stream << "# HELP sourcemeta_registry_not_modified_total The number of "
+              "304 responses by route\n"
+              "# TYPE sourcemeta_registry_not_modified_total counter\n";
+    for (std::size_t route = 0; route < totals.size(); route++) {
+      stream << "sourcemeta_registry_not_modified_total{route=\""
+             << ROUTE_FAMILIES[route] << "\"} " << totals[route].not_modified
+             << '\n';
+    }
+
+    stream << "# HELP sourcemeta_registry_response_bytes_total The number of "
+              "body bytes sent by route\n"
+              "# TYPE sourcemeta_registry_response_bytes_total counter\n";
+    for (std::size_t route = 0; route < totals.size(); route++) {
+      stream << "sourcemeta_registry_response_bytes_total{route=\""
+             << ROUTE_FAMILIES[route] << "\"} " << totals[route].bytes << '\n';
+    }
+
+    constexpr std::string_view HISTOGRAM{
+        "sourcemeta_registry_response_duration_seconds"};
+    stream << "# HELP " << HISTOGRAM
+           << " The time from receiving a request to answering it by route\n"
+           << "# TYPE " << HISTOGRAM << " histogram\n";
+    for (std::size_t route = 0; route < totals.size(); route++) {
+      std::uint64_t cumulative{0};
+      for (std::size_t bucket = 0; bucket < LATENCY_BUCKETS; bucket++) {
+        cumulative += totals[route].latency[bucket];
+        stream << HISTOGRAM << "_bucket{route=\"" << ROUTE_FAMILIES[route]
+               << "\",le=\""
+               << static_cast<double>(std::uint64_t{1} << bucket) / 1e6
+               << "\"} " << cumulative << '\n';
+      }
+
+      cumulative += totals[route].latency[LATENCY_BUCKETS];
+      stream << HISTOGRAM << "_bucket{route=\"" << ROUTE_FAMILIES[route]
+             << "\",le=\"+Inf\"} " << cumulative << '\n';
+      stream << HISTOGRAM << "_sum{route=\"" << ROUTE_FAMILIES[route] << "\"} "
+             << static_cast<double>(totals[route].latency_sum) / 1e6 << '\n';
+      stream << HISTOGRAM << "_count{route=\"" << ROUTE_FAMILIES[route]
+             << "\"} " << cumulative << '\n';
+    }
+
+    constexpr std::string_view QUEUE{
+        "sourcemeta_registry_evaluate_queue_duration_seconds"};
+    stream << "# HELP " << QUEUE
+           << " The time evaluations waited for a worker\n"
+           << "# TYPE " << QUEUE << " histogram\n";
+    std::uint64_t cumulative{0};
+    for (std::size_t bucket = 0; bucket < LATENCY_BUCKETS; bucket++) {
+      cumulative += queue[bucket];
+      stream << QUEUE << "_bucket{le=\""
+             << static_cast<double>(std::uint64_t{1} << bucket) / 1e6 << "\"} "
+             << cumulative << '\n';
+    }
+
+    cumulative += queue[LATENCY_BUCKETS];
+    stream << QUEUE << "_bucket{le=\"+Inf\"} " << cumulative << '\n';
+    stream << QUEUE << "_sum " << static_cast<double>(queue_sum) / 1e6 << '\n';
+    stream << QUEUE << "_count " << cumulative << '\n';
+  }
+
+private:
+  // Powers of two from 1 us to roughly 8 s, plus an overflow bucket
+  static constexpr std::size_t LATENCY_BUCKETS{24};
+  static constexpr std::size_t STATUS_CLASSES{5};
+  // In the same order as the enumeration
+  static constexpr std::array<std::string_view, 11> ROUTE_FAMILIES{
+      {"schema", "explorer", "list", "metadata", "search", "complete",
+       "evaluate", "trace", "static", "metrics", "other"}};
+  static constexpr std::size_t COUNTERS{4};
+
+  using Counter = std::atomic<std::uint64_t>;
+
+  struct RouteCounters {
+    std::array<Counter, STATUS_CLASSES> responses{};
+    Counter not_modified{0};
+    std::array<Counter, LATENCY_BUCKETS + 1> latency{};
+    // In microseconds
+    Counter latency_sum{0};
+    Counter bytes{0};
+  };
+
+  struct Shard {
+    std::array<RouteCounters, ROUTE_FAMILIES.size()> routes{};
+    std::array<Counter, COUNTERS> counters{};
+    std::array<Counter, LATENCY_BUCKETS + 1> queue{};
+    // In microseconds
+    Counter queue_sum{0};
+  };
+
+  struct Totals {
+    std::array<std::uint64_t, STATUS_CLASSES> responses{};
+    std::uint64_t not_modified{0};
+    std::array<std::uint64_t, LATENCY_BUCKETS + 1> latency{};
+    std::uint64_t latency_sum{0};
+    std::uint64_t bytes{0};
+
+    auto add(const RouteCounters &counters) -> void {
+      for (std::size_t index = 0; index < this->responses.size(); index++) {
+        this->responses[index] +=
+            counters.responses[index].load(std::memory_order_relaxed);
+      }
+
+      this->not_modified +=
+          counters.not_modified.load(std::memory_order_relaxed);
+      for (std::size_t index = 0; index < this->latency.size(); index++) {
+        this->latency[index] +=
+            counters.latency[index].load(std::memory_order_relaxed);
+      }
+
+      this->latency_sum += counters.latency_sum.load(std::memory_order_relaxed);
+      this->bytes += counters.bytes.load(std::memory_order_relaxed);
+    }
+  };
+
+  static auto to_microseconds(const std::chrono::steady_clock::duration value)
+      -> std::uint64_t {
+    return static_cast<std::uint64_t>(
+        std::chrono::duration_cast<std::chrono::microseconds>(value).count());
+  }
+
+  // The smallest bucket whose upper bound is at least the given value, or the
+  // overflow bucket
+  static auto bucket(const std::uint64_t microseconds) -> std::size_t {
+    const auto result{
+        microseconds <= 1
+            ? std::size_t{0}
+            : static_cast<std::size_t>(std::bit_width(microseconds - 1))};
+    return result < LATENCY_BUCKETS ? result : LATENCY_BUCKETS;
+  }
+
+  // As every counter has a single writer, there is no need for an atomic
+  // read-modify-write, which would otherwise lock the cache line
+  static auto increment(Counter &counter, const std::uint64_t value = 1)
+      -> void {
+    counter.store(counter.load(std::memory_order_relaxed) + value,
+                  std::memory_order_relaxed);
+  }
+
+  // Each thread registers its own shard the first time it records something,
+  // which is the only time it ever takes the lock. This assumes a single
+  // instance
+  auto shard() -> Shard & {
+    thread_local Shard *current{nullptr};
+    if (current == nullptr) {
+      auto shard{std::make_unique<Shard>()};
+      current = shard.get();
+      std::lock_guard<std::mutex> guard{this->mutex_};
+      this->shards_.push_back(std::move(shard));
+    }
+
+    return *current;
+  }
+
+  mutable std::mutex mutex_;
+  std::vector<std::unique_ptr<Shard>> shards_;
+};
+
+} // namespace sourcemeta::registry
+
+#endif
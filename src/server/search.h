@@ -5,50 +5,147 @@
 
 #include <sourcemeta/registry/shared.h>
 
-#include <algorithm>   // std::search
-#include <cassert>     // assert
-#include <filesystem>  // std::filesystem
-#include <string>      // std::string, std::getline
-#include <string_view> // std::string_view
+#include "mapping.h"
+
+#include <atomic>       // std::atomic
+#include <cassert>      // assert
+#include <chrono>       // std::chrono
+#include <exception>    // std::exception
+#include <filesystem>   // std::filesystem
+#include <memory>       // std::shared_ptr, std::make_shared
+#include <optional>     // std::optional, std::nullopt
+#include <string>       // std::string
+#include <string_view>  // std::string_view
+#include <system_error> // std::error_code
+#include <utility>      // std::move
+#include <vector>       // std::vector
 
 namespace sourcemeta::registry {
 
-static auto search(const std::filesystem::path &search_index,
-                   const std::string_view query) -> sourcemeta::core::JSON {
-  assert(std::filesystem::exists(search_index));
-  assert(search_index.is_absolute());
-  auto file{read_stream_raw(search_index)};
-  assert(file.has_value());
+/// A memory mapped index, which is transparently re-loaded if the index
+/// changes on disk
+template <typename Index> class MappedIndex {
+public:
+  struct State {
+    std::shared_ptr<const MappedFile> mapping;
+    // Unset if the index is missing or corrupted
+    std::optional<Index> index;
+    std::filesystem::file_time_type modified;
+    std::chrono::steady_clock::time_point validated;
+  };
 
-  auto result{sourcemeta::core::JSON::make_array()};
-  // TODO: Extend the Core JSONL iterators to be able
-  // to access the stringified contents of the current entry
-  // BEFORE parsing it as JSON, letting the client decide
-  // whether to parse or not.
-  std::string line;
-  while (std::getline(file.value().data, line)) {
-    if (std::search(line.cbegin(), line.cend(), query.begin(), query.end(),
-                    [](const auto left, const auto right) {
-                      return std::tolower(left) == std::tolower(right);
-                    }) == line.cend()) {
-      continue;
+  MappedIndex(std::filesystem::path path) : path_{std::move(path)} {
+    assert(this->path_.is_absolute());
+  }
+
+  // The index views into the mapping, so callers must hold on to the state
+  auto state() -> std::shared_ptr<const State> {
+    auto current{this->state_.load(std::memory_order_acquire)};
+    const auto now{std::chrono::steady_clock::now()};
+    // Only hit the file-system to check for a new index every once in a while
+    if (current && now - current->validated < REVALIDATE_INTERVAL) {
+      return current;
+    }
+
+    std::error_code error;
+    const auto modified{std::filesystem::last_write_time(this->path_, error)};
+    if (current && (error || modified == current->modified)) {
+      auto refreshed{std::make_shared<const State>(State{
+          current->mapping, current->index, current->modified, now})};
+      this->state_.compare_exchange_strong(current, refreshed);
+      return refreshed;
+    }
+
+    auto next{this->load(modified, now)};
+    this->state_.store(next, std::memory_order_release);
+    return next;
+  }
+
+private:
+  auto load(const std::filesystem::file_time_type modified,
+            const std::chrono::steady_clock::time_point now) const
+      -> std::shared_ptr<const State> {
+    // A missing or corrupted index must not take the server down
+    try {
+      const auto metadata{read_metadata(this->path_)};
+      auto mapping{MappedFile::open(this->path_)};
+      // The payload is always at the end of the file
+      if (metadata.has_value() && mapping &&
+          mapping->view().size() >= metadata.value().data) {
+        Index index{mapping->view().substr(mapping->view().size() -
+                                           metadata.value().data)};
+        return std::make_shared<const State>(
+            State{std::move(mapping), index, modified, now});
+      }
+    } catch (const std::exception &) {
     }
 
+    return std::make_shared<const State>(
+        State{nullptr, std::nullopt, modified, now});
+  }
+
+  static constexpr std::chrono::seconds REVALIDATE_INTERVAL{1};
+  const std::filesystem::path path_;
+  std::atomic<std::shared_ptr<const State>> state_;
+};
+
+inline auto to_json(const std::vector<SearchIndex::Match> &matches)
+    -> sourcemeta::core::JSON {
+  auto result{sourcemeta::core::JSON::make_array()};
+  for (const auto &match : matches) {
     auto entry{sourcemeta::core::JSON::make_object()};
-    auto line_json{sourcemeta::core::parse_json(line)};
-    entry.assign("path", std::move(line_json.at(0)));
-    entry.assign("title", std::move(line_json.at(1)));
-    entry.assign("description", std::move(line_json.at(2)));
+    entry.assign("path", sourcemeta::core::JSON{std::string{match.path}});
+    entry.assign("title", sourcemeta::core::JSON{std::string{match.title}});
+    entry.assign("description",
+                 sourcemeta::core::JSON{std::string{match.description}});
     result.push_back(std::move(entry));
+  }
+
+  return result;
+}
+
+/// Serves search queries out of a memory mapped search index
+class SearchService {
+public:
+  SearchService(std::filesystem::path path) : index_{std::move(path)} {}
+
+  /// Returns nothing if the search index is not available
+  auto search(const std::string_view query, const SearchFilter &filter)
+      -> std::optional<sourcemeta::core::JSON> {
+    const auto state{this->index_.state()};
+    if (!state->index.has_value()) {
+      return std::nullopt;
+    }
 
     constexpr auto MAXIMUM_SEARCH_COUNT{10};
-    if (result.array_size() >= MAXIMUM_SEARCH_COUNT) {
-      break;
+    return to_json(
+        state->index.value().search(query, MAXIMUM_SEARCH_COUNT, filter));
+  }
+
+private:
+  MappedIndex<SearchIndex> index_;
+};
+
+/// Serves prefix completions out of a memory mapped completion index
+class CompletionService {
+public:
+  CompletionService(std::filesystem::path path) : index_{std::move(path)} {}
+
+  /// Returns nothing if the completion index is not available
+  auto complete(const std::string_view prefix)
+      -> std::optional<sourcemeta::core::JSON> {
+    const auto state{this->index_.state()};
+    if (!state->index.has_value()) {
+      return std::nullopt;
     }
+
+    return to_json(state->index.value().complete(
+        prefix, CompletionIndex::MAXIMUM_COMPLETIONS));
   }
 
-  return result;
-}
+private:
+  MappedIndex<CompletionIndex> index_;
+};
 
 } // namespace sourcemeta::registry
 
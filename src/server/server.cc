@@ -7,98 +7,247 @@
 
 #include "uwebsockets.h"
 
+#include "cache.h"
 #include "evaluate.h"
+#include "generation.h"
+#include "header.h"
+#include "log.h"
+#include "metrics.h"
+#include "mapping.h"
 #include "search.h"
 #include "status.h"
+#include "timing.h"
+#include "warmup.h"
+#include "worker.h"
 
-#include <cassert>     // assert
-#include <cctype>      // std::tolower
-#include <chrono>      // std::chrono::system_clock
-#include <csignal>     // std::signal, SIGINT, SIGTERM
-#include <cstdint>     // std::uint32_t, std::atoi, std::stoul
-#include <cstdlib>     // EXIT_FAILURE, std::exit
-#include <filesystem>  // std::filesystem
-#include <iostream>    // std::cerr, std::cout
-#include <memory>      // std::unique_ptr
-#include <mutex>       // std::mutex, std::lock_guard
-#include <optional>    // std::optional
-#include <sstream>     // std::ostringstream, std::istringstream
-#include <stdexcept>   // std::invalid_argument
-#include <string>      // std::string, std::getline
-#include <string_view> // std::string_view
-#include <thread>      // std::this_thread
-#include <utility>     // std::move, std::pair
-#include <vector>      // std::vector
+#include <algorithm>    // std::find_if, std::min
+#include <array>        // std::array
+#include <atomic>       // std::atomic
+#include <cassert>      // assert
+#include <charconv>     // std::from_chars
+#include <chrono>       // std::chrono
+#include <csignal>      // std::signal, SIGINT, SIGTERM, SIGHUP
+#include <cstdint>      // std::uint32_t, std::uintmax_t, std::atoi,
+                        // std::stoul
+#include <cstdlib>      // EXIT_FAILURE, std::exit, std::getenv
+#include <filesystem>   // std::filesystem
+#include <functional>   // std::ref
+#include <iostream>     // std::cerr, std::cout
+#include <limits>       // std::numeric_limits
+#include <memory>       // std::unique_ptr, std::make_shared,
+                        // std::weak_ptr
+#include <mutex>        // std::mutex, std::lock_guard
+#include <optional>     // std::optional
+#include <span>         // std::span
+#include <sstream>      // std::ostringstream
+#include <stdexcept>    // std::invalid_argument
+#include <string>       // std::string
+#include <string_view>  // std::string_view
+#include <system_error> // std::errc
+#include <thread>       // std::thread, std::this_thread
+#include <utility>      // std::move, std::make_pair
+#include <vector>       // std::vector, std::erase_if
+
+static auto environment_number(const char *const name,
+                               const std::size_t fallback) -> std::size_t {
+  const auto *const value{std::getenv(name)};
+  if (value == nullptr || *value == '\0') {
+    return fallback;
+  }
+
+  const std::string_view input{value};
+  std::size_t result{0};
+  const auto parse{
+      std::from_chars(input.data(), input.data() + input.size(), result)};
+  if (parse.ec != std::errc{} || parse.ptr != input.data() + input.size()) {
+    throw std::invalid_argument{"The " + std::string{name} +
+                                " environment variable must be a "
+                                "non-negative integer but it was set to " +
+                                std::string{input}};
+  }
+
+  return result;
+}
+
+static auto logger() -> sourcemeta::registry::Logger & {
+  static sourcemeta::registry::Logger instance{
+      std::cerr,
+      environment_number("SOURCEMETA_REGISTRY_ACCESS_LOG_SAMPLE", 1)};
+  return instance;
+}
 
 static auto log(std::string_view message) -> void {
-  // Otherwise we can get messed up output interleaved from multiple threads
-  static std::mutex log_mutex;
-  std::lock_guard<std::mutex> guard{log_mutex};
-  std::cerr << "[" << sourcemeta::core::to_gmt(std::chrono::system_clock::now())
-            << "] " << std::this_thread::get_id() << ' ' << message << "\n";
+  logger().message(message);
+}
+
+static auto metrics() -> sourcemeta::registry::Metrics & {
+  static sourcemeta::registry::Metrics instance;
+  return instance;
+}
+
+static auto server_timing_enabled() -> bool {
+  static const bool enabled{
+      environment_number("SOURCEMETA_REGISTRY_SERVER_TIMING", 0) > 0};
+  return enabled;
+}
+
+struct RequestState {
+  std::chrono::steady_clock::time_point start;
+  sourcemeta::registry::RouteFamily route;
+  sourcemeta::registry::ServerTiming timing;
+  // Keeps the generation alive until the request is answered, even if the
+  // server switched to a new one in the meantime
+  std::shared_ptr<const sourcemeta::registry::Generation> generation;
+  // The precompressed encodings that the client accepts, by preference
+  std::array<sourcemeta::registry::Encoding, 2> variants;
+  std::size_t variants_size;
+};
+
+// The request that the current thread is answering. Handlers that answer
+// asynchronously must hold on to it and restore it before responding
+static thread_local RequestState current_request{};
+
+// Must be called after the status and before ending the response
+static auto write_server_timing(uWS::HttpResponse<true> *response) -> void {
+  if (current_request.timing.enabled()) {
+    response->writeHeader("Server-Timing",
+                          current_request.timing.header(
+                              std::chrono::steady_clock::now() -
+                              current_request.start));
+  }
+}
+
+static auto log_access(const char *const code, const std::string_view method,
+                       const std::string_view url, const std::size_t bytes)
+    -> void {
+  assert(code);
+  const auto status{static_cast<std::uint16_t>(std::atoi(code))};
+  const auto latency{std::chrono::steady_clock::now() - current_request.start};
+  metrics().response(current_request.route, status, latency, bytes);
+  logger().access(status, method, url, latency, bytes);
 }
 
 static auto send_response(const char *const code, const std::string_view method,
                           const std::string_view url,
                           uWS::HttpResponse<true> *response) -> void {
+  write_server_timing(response);
   response->end();
-  std::ostringstream line;
-  assert(code);
-  line << code << ' ' << method << ' ' << url;
-  log(std::move(line).str());
+  log_access(code, method, url, 0);
 }
 
-// TODO: Use `Encoding` from `src/shared`
-enum class ServerContentEncoding { Identity, GZIP };
+// Brotli and Zstandard are only ever used for precompressed variants, while
+// GZIP is the encoding we fall back to, transcoding on the fly if needed
+using ServerContentEncoding = sourcemeta::registry::Encoding;
+
+static auto write_content_encoding(uWS::HttpResponse<true> *response,
+                                   const ServerContentEncoding encoding)
+    -> void {
+  switch (encoding) {
+    case ServerContentEncoding::GZIP:
+      response->writeHeader("Content-Encoding", "gzip");
+      break;
+    case ServerContentEncoding::Brotli:
+      response->writeHeader("Content-Encoding", "br");
+      break;
+    case ServerContentEncoding::Zstd:
+      response->writeHeader("Content-Encoding", "zstd");
+      break;
+    default:
+      break;
+  }
+}
 
 static auto send_response(const char *const code, const std::string_view method,
                           const std::string_view url,
                           uWS::HttpResponse<true> *response,
                           const std::string &message,
                           const ServerContentEncoding expected_encoding,
-                          const ServerContentEncoding current_encoding)
+                          const ServerContentEncoding current_encoding,
+                          const bool close_connection = false) -> void {
+  // Only set if we need to transcode the response on the fly, which we only
+  // ever do between identity and GZIP
+  std::string effective_message;
+  write_content_encoding(response, expected_encoding);
+  if (expected_encoding == current_encoding) {
+    // Nothing to do
+  } else if (expected_encoding == ServerContentEncoding::GZIP) {
+    assert(current_encoding == ServerContentEncoding::Identity);
+    const auto timer{current_request.timing.scope("compress")};
+    effective_message = sourcemeta::registry::gzip(message);
+    metrics().count(sourcemeta::registry::MetricsCounter::Compressions);
+  } else {
+    assert(expected_encoding == ServerContentEncoding::Identity);
+    assert(current_encoding == ServerContentEncoding::GZIP);
+    const auto timer{current_request.timing.scope("decompress")};
+    effective_message = sourcemeta::registry::gunzip(message);
+    metrics().count(sourcemeta::registry::MetricsCounter::Decompressions);
+  }
+
+  const std::string_view body{expected_encoding == current_encoding
+                                  ? message
+                                  : effective_message};
+  write_server_timing(response);
+  std::size_t bytes{0};
+  if (method == "head") {
+    response->endWithoutBody(body.size());
+    response->end();
+  } else {
+    bytes = body.size();
+    response->end(body, close_connection);
+  }
+
+  log_access(code, method, url, bytes);
+}
+
+// For answering `HEAD` requests when we know the size of the response
+// without having its contents at hand
+static auto send_response_metadata(const char *const code,
+                                   const std::string_view method,
+                                   const std::string_view url,
+                                   uWS::HttpResponse<true> *response,
+                                   const std::size_t size,
+                                   const ServerContentEncoding encoding)
     -> void {
-  if (expected_encoding == ServerContentEncoding::GZIP) {
-    response->writeHeader("Content-Encoding", "gzip");
-    if (current_encoding == ServerContentEncoding::Identity) {
-      auto effective_message{sourcemeta::registry::gzip(message)};
-      if (method == "head") {
-        response->endWithoutBody(effective_message.size());
-        response->end();
-      } else {
-        response->end(std::move(effective_message));
-      }
-    } else {
-      if (method == "head") {
-        response->endWithoutBody(message.size());
-        response->end();
-      } else {
-        response->end(message);
-      }
-    }
-  } else if (expected_encoding == ServerContentEncoding::Identity) {
-    if (current_encoding == ServerContentEncoding::GZIP) {
-      auto effective_message{sourcemeta::registry::gunzip(message)};
-      if (method == "head") {
-        response->endWithoutBody(effective_message.size());
-        response->end();
-      } else {
-        response->end(effective_message);
-      }
-    } else {
-      if (method == "head") {
-        response->endWithoutBody(message.size());
-        response->end();
-      } else {
-        response->end(message);
-      }
-    }
+  assert(method == "head");
+  write_content_encoding(response, encoding);
+
+  write_server_timing(response);
+  response->endWithoutBody(size);
+  response->end();
+  log_access(code, method, url, 0);
+}
+
+// Responses at least this large are streamed instead of loaded into memory
+constexpr std::size_t STREAM_THRESHOLD{1024 * 1024};
+
+// Send a part of a memory mapping as a response, and only as fast as the
+// client is able to receive it
+static auto
+stream_response(const char *const code, const std::string_view method,
+                const std::string_view url, uWS::HttpResponse<true> *response,
+                std::shared_ptr<const sourcemeta::registry::MappedFile> mapping,
+                const std::size_t offset, const std::size_t size,
+                const ServerContentEncoding encoding) -> void {
+  write_content_encoding(response, encoding);
+  write_server_timing(response);
+  const auto body{mapping->view().substr(offset, size)};
+  const auto done{response->tryEnd(body, body.size()).second};
+  if (!done) {
+    // The mapping must outlive the response, so its handlers keep it around
+    response->onAborted([mapping]() {});
+    response->onWritable(
+        [response, mapping, offset, size](const std::uintmax_t written)
+            -> bool {
+          // The write offset is the amount of the body we already sent
+          const auto rest{mapping->view().substr(
+              offset + static_cast<std::size_t>(written),
+              size - static_cast<std::size_t>(written))};
+          return response->tryEnd(rest, size).first;
+        });
   }
 
-  std::ostringstream line;
-  assert(code);
-  line << code << ' ' << method << ' ' << url;
-  log(std::move(line).str());
+  // What we intend to send, even if the client goes away half-way through
+  log_access(code, method, url, body.size());
 }
 
 // See https://www.rfc-editor.org/rfc/rfc7807
@@ -107,7 +256,8 @@ static auto json_error(const std::string_view method,
                        uWS::HttpResponse<true> *response,
                        const ServerContentEncoding encoding,
                        const char *const code, std::string &&id,
-                       std::string &&message) -> void {
+                       std::string &&message,
+                       const bool close_connection = false) -> void {
   auto object{sourcemeta::core::JSON::make_object()};
   object.assign("title",
                 // A URI with a custom scheme
@@ -121,75 +271,65 @@ static auto json_error(const std::string_view method,
   std::ostringstream output;
   sourcemeta::core::prettify(object, output);
   send_response(code, method, url, response, output.str(), encoding,
-                ServerContentEncoding::Identity);
+                ServerContentEncoding::Identity, close_connection);
 }
 
-/// A header list element consists of the element value and its quality value
-/// See https://developer.mozilla.org/en-US/docs/Glossary/Quality_values
-static auto header_list(const std::string_view &value)
-    -> std::vector<std::pair<std::string, float>> {
-  std::istringstream stream{std::string{value}};
-  std::string token;
-  std::vector<std::pair<std::string, float>> result;
-
-  while (std::getline(stream, token, ',')) {
-    const std::size_t start{token.find_first_not_of(" ")};
-    const std::size_t end{token.find_last_not_of(" ")};
-    if (start == std::string::npos || end == std::string::npos) {
-      continue;
-    }
-
-    // See https://developer.mozilla.org/en-US/docs/Glossary/Quality_values
-    const std::size_t value_start{token.find_first_of(";")};
-    if (value_start != std::string::npos && token[value_start + 1] == 'q' &&
-        token[value_start + 2] == '=') {
-      result.emplace_back(token.substr(start, value_start - start),
-                          std::stof(token.substr(value_start + 3)));
-    } else {
-      // No quality value is 1.0 by default
-      result.emplace_back(token.substr(start, end - start + 1), 1.0f);
-    }
-  }
+static auto response_cache() -> sourcemeta::registry::ResponseCache & {
+  constexpr std::size_t RESPONSE_CACHE_SLOTS{16384};
+  static sourcemeta::registry::ResponseCache cache{
+      environment_number("SOURCEMETA_REGISTRY_RESPONSE_CACHE_MB", 64) * 1024 *
+          1024,
+      RESPONSE_CACHE_SLOTS};
+  return cache;
+}
 
-  // For convenient, automatically sort by the quality value
-  std::sort(result.begin(), result.end(),
-            [](const auto &left, const auto &right) {
-              return left.second > right.second;
-            });
+// Static responses in an encoding other than the one they are stored in live
+// in a cache of their own, so that we only ever transcode each of them once,
+// no matter their size or whether the response cache is enabled
+static auto transcode_cache() -> sourcemeta::registry::ResponseCache & {
+  constexpr std::size_t TRANSCODE_CACHE_SLOTS{4096};
+  static const std::size_t budget{
+      environment_number("SOURCEMETA_REGISTRY_TRANSCODE_CACHE_MB", 256) *
+      1024 * 1024};
+  static sourcemeta::registry::ResponseCache cache{
+      budget, TRANSCODE_CACHE_SLOTS, budget};
+  return cache;
+}
 
-  return result;
+static auto template_cache() -> sourcemeta::registry::TemplateCache & {
+  static sourcemeta::registry::TemplateCache cache{
+      environment_number("SOURCEMETA_REGISTRY_TEMPLATE_CACHE_MB", 128) * 1024 *
+      1024};
+  return cache;
 }
 
-static auto
-serve_static_file(uWS::HttpRequest *request, uWS::HttpResponse<true> *response,
-                  const ServerContentEncoding encoding,
-                  const std::filesystem::path &absolute_path,
-                  const char *const code, const bool enable_cors = false,
-                  const std::optional<std::string> &mime = std::nullopt)
-    -> void {
-  if (request->getMethod() != "get" && request->getMethod() != "head") {
-    if (std::filesystem::exists(absolute_path)) {
-      json_error(request->getMethod(), request->getUrl(), response, encoding,
-                 sourcemeta::registry::STATUS_METHOD_NOT_ALLOWED,
-                 "method-not-allowed",
-                 "This HTTP method is invalid for this URL");
-    } else {
-      json_error(request->getMethod(), request->getUrl(), response, encoding,
-                 sourcemeta::registry::STATUS_NOT_FOUND, "not-found",
-                 "There is nothing at this URL");
-    }
+// The most we reserve upfront for a request body based on its declared length
+constexpr std::size_t EVALUATE_RESERVE_LIMIT{64 * 1024};
 
-    return;
-  }
+// The largest request body we are willing to hold in memory for a single
+// evaluation, where zero means no limit
+static auto evaluate_body_limit() -> std::size_t {
+  static const std::size_t limit{
+      environment_number("SOURCEMETA_REGISTRY_EVALUATE_MAX_BODY_MB", 16) *
+      1024 * 1024};
+  return limit;
+}
 
-  auto file{sourcemeta::registry::read_stream_raw(absolute_path)};
-  if (!file.has_value()) {
-    json_error(request->getMethod(), request->getUrl(), response, encoding,
-               sourcemeta::registry::STATUS_NOT_FOUND, "not-found",
-               "There is nothing at this URL");
-    return;
-  }
+static auto evaluate_pool() -> sourcemeta::registry::WorkerPool & {
+  // Give it a generous thread stack size, otherwise we might overflow
+  // the small-by-default thread stack with Blaze
+  constexpr auto THREAD_STACK_SIZE{8 * 1024 * 1024};
+  static sourcemeta::registry::WorkerPool pool{
+      environment_number("SOURCEMETA_REGISTRY_EVALUATE_WORKERS",
+                         std::thread::hardware_concurrency()),
+      THREAD_STACK_SIZE};
+  return pool;
+}
 
+static auto
+is_not_modified(uWS::HttpRequest *request, const std::string_view etag,
+                const std::chrono::system_clock::time_point last_modified)
+    -> bool {
   // Note that `If-Modified-Since` can only be used with a `GET` or `HEAD`.
   // See
   // https://developer.mozilla.org/en-US/docs/Web/HTTP/Headers/If-Modified-Since
@@ -199,15 +339,8 @@ serve_static_file(uWS::HttpRequest *request, uWS::HttpResponse<true> *response,
       // Time comparison can be flaky, but adding a bit of tolerance leads
       // to more consistent behavior.
       if ((sourcemeta::core::from_gmt(std::string{if_modified_since}) +
-           std::chrono::seconds(1)) >= file.value().last_modified) {
-        response->writeStatus(sourcemeta::registry::STATUS_NOT_MODIFIED);
-        if (enable_cors) {
-          response->writeHeader("Access-Control-Allow-Origin", "*");
-        }
-
-        send_response(sourcemeta::registry::STATUS_NOT_MODIFIED,
-                      request->getMethod(), request->getUrl(), response);
-        return;
+           std::chrono::seconds(1)) >= last_modified) {
+        return true;
       }
       // If there is an error parsing the `If-Modified-Since` timestamp, don't
       // abort, but lean on the safe side: the requested resource has been
@@ -216,29 +349,38 @@ serve_static_file(uWS::HttpRequest *request, uWS::HttpResponse<true> *response,
     }
   }
 
-  const auto &checksum{file.value().checksum};
   const auto if_none_match{request->getHeader("if-none-match")};
   if (!if_none_match.empty()) {
-    std::ostringstream etag_value_strong;
-    std::ostringstream etag_value_weak;
-    etag_value_strong << '"' << checksum << '"';
-    etag_value_weak << 'W' << '/' << '"' << checksum << '"';
-    for (const auto &match : header_list(if_none_match)) {
+    sourcemeta::registry::HeaderList list{if_none_match};
+    while (const auto match{list.next()}) {
       // Cache hit
-      if (match.first == "*" || match.first == etag_value_weak.str() ||
-          match.first == etag_value_strong.str()) {
-        response->writeStatus(sourcemeta::registry::STATUS_NOT_MODIFIED);
-        if (enable_cors) {
-          response->writeHeader("Access-Control-Allow-Origin", "*");
-        }
-
-        send_response(sourcemeta::registry::STATUS_NOT_MODIFIED,
-                      request->getMethod(), request->getUrl(), response);
-        return;
+      if (match->value == "*" || match->value == etag ||
+          (match->value.starts_with("W/") && match->value.substr(2) == etag)) {
+        return true;
       }
     }
   }
 
+  return false;
+}
+
+static auto send_not_modified(uWS::HttpRequest *const request,
+                              uWS::HttpResponse<true> *const response,
+                              const bool enable_cors) -> void {
+  response->writeStatus(sourcemeta::registry::STATUS_NOT_MODIFIED);
+  if (enable_cors) {
+    response->writeHeader("Access-Control-Allow-Origin", "*");
+  }
+
+  send_response(sourcemeta::registry::STATUS_NOT_MODIFIED, request->getMethod(),
+                request->getUrl(), response);
+}
+
+static auto
+write_static_file_headers(uWS::HttpResponse<true> *response,
+                          const sourcemeta::registry::CachedResponse &file,
+                          const char *const code, const bool enable_cors,
+                          const std::optional<std::string> &mime) -> void {
   response->writeStatus(code);
 
   // To support requests from web browsers
@@ -249,35 +391,228 @@ serve_static_file(uWS::HttpRequest *request, uWS::HttpResponse<true> *response,
   if (mime.has_value()) {
     response->writeHeader("Content-Type", mime.value());
   } else {
-    response->writeHeader("Content-Type", file.value().mime);
+    response->writeHeader("Content-Type", file.mime);
+  }
+
+  response->writeHeader("Last-Modified", file.last_modified_header);
+  response->writeHeader("ETag", file.etag);
+  // As the encoding of the response depends on what the client accepts
+  response->writeHeader("Vary", "Accept-Encoding");
+  if (file.link.has_value()) {
+    response->writeHeader("Link", file.link.value());
   }
+}
 
-  response->writeHeader("Last-Modified",
-                        sourcemeta::core::to_gmt(file.value().last_modified));
+// Returns false if we could not read the variant after all, in which case the
+// caller should fall back to the regular payload
+static auto serve_static_file_variant(
+    uWS::HttpRequest *request, uWS::HttpResponse<true> *response,
+    const sourcemeta::registry::CachedResponse &file,
+    const sourcemeta::registry::FileVariant &variant, const char *const code,
+    const bool enable_cors, const std::optional<std::string> &mime) -> bool {
+  auto entry{[&file, &variant] {
+    const auto timer{current_request.timing.scope("cache")};
+    return response_cache().at(file.path, variant.encoding);
+  }()};
+  metrics().count(
+      entry ? sourcemeta::registry::MetricsCounter::ResponseCacheHits
+            : sourcemeta::registry::MetricsCounter::ResponseCacheMisses);
+  if (!entry) {
+    if (request->getMethod() == "head") {
+      write_static_file_headers(response, file, code, enable_cors, mime);
+      send_response_metadata(code, request->getMethod(), request->getUrl(),
+                             response, variant.stored_bytes, variant.encoding);
+      return true;
+    }
 
-  std::ostringstream etag;
-  etag << '"' << checksum << '"';
-  response->writeHeader("ETag", std::move(etag).str());
+    if (variant.stored_bytes >= STREAM_THRESHOLD) {
+      auto mapping{sourcemeta::registry::MappedFile::open(file.path)};
+      if (!mapping ||
+          mapping->view().size() < variant.offset + variant.stored_bytes) {
+        return false;
+      }
 
-  // See
-  // https://json-schema.org/draft/2020-12/json-schema-core.html#section-9.5.1.1
-  const auto &dialect{file.value().extension};
-  if (dialect.is_string()) {
-    std::ostringstream link;
-    link << "<" << dialect.to_string() << ">; rel=\"describedby\"";
-    response->writeHeader("Link", std::move(link).str());
+      write_static_file_headers(response, file, code, enable_cors, mime);
+      stream_response(code, request->getMethod(), request->getUrl(), response,
+                      std::move(mapping), variant.offset, variant.stored_bytes,
+                      variant.encoding);
+      return true;
+    }
+
+    entry = [&file, &variant] {
+      const auto timer{current_request.timing.scope("read")};
+      return file.variant(variant);
+    }();
+    if (!entry) {
+      return false;
+    }
+
+    response_cache().insert(entry);
   }
 
-  std::ostringstream contents;
-  contents << file.value().data.rdbuf();
+  write_static_file_headers(response, *entry, code, enable_cors, mime);
+  send_response(code, request->getMethod(), request->getUrl(), response,
+                entry->body.value(), variant.encoding, variant.encoding);
+  return true;
+}
 
-  if (file.value().encoding == sourcemeta::registry::Encoding::GZIP) {
-    send_response(code, request->getMethod(), request->getUrl(), response,
-                  contents.str(), encoding, ServerContentEncoding::GZIP);
-  } else {
-    send_response(code, request->getMethod(), request->getUrl(), response,
-                  contents.str(), encoding, ServerContentEncoding::Identity);
+static auto
+serve_static_file(uWS::HttpRequest *request, uWS::HttpResponse<true> *response,
+                  const ServerContentEncoding encoding,
+                  const std::filesystem::path &absolute_path,
+                  const char *const code, const bool enable_cors = false,
+                  const std::optional<std::string> &mime = std::nullopt)
+    -> void {
+  if (request->getMethod() != "get" && request->getMethod() != "head") {
+    if (std::filesystem::exists(absolute_path)) {
+      json_error(request->getMethod(), request->getUrl(), response, encoding,
+                 sourcemeta::registry::STATUS_METHOD_NOT_ALLOWED,
+                 "method-not-allowed",
+                 "This HTTP method is invalid for this URL");
+    } else {
+      json_error(request->getMethod(), request->getUrl(), response, encoding,
+                 sourcemeta::registry::STATUS_NOT_FOUND, "not-found",
+                 "There is nothing at this URL");
+    }
+
+    return;
+  }
+
+  const auto expected_encoding{encoding};
+  auto file{[&absolute_path, expected_encoding] {
+    const auto timer{current_request.timing.scope("cache")};
+    auto result{response_cache().at(absolute_path, expected_encoding)};
+    return result ? result
+                  : transcode_cache().at(absolute_path, expected_encoding);
+  }()};
+  metrics().count(
+      file ? sourcemeta::registry::MetricsCounter::ResponseCacheHits
+           : sourcemeta::registry::MetricsCounter::ResponseCacheMisses);
+  // Whether we read the entire file ourselves, rather than out of the cache
+  bool fresh{false};
+  if (!file) {
+    // Most of our traffic consists of conditional requests, which we can
+    // answer without opening the file at all
+    const auto *const validator{
+        current_request.generation
+            ? current_request.generation->validators.find(absolute_path)
+            : nullptr};
+    if (validator &&
+        is_not_modified(request, validator->etag, validator->last_modified)) {
+      send_not_modified(request, response, enable_cors);
+      return;
+    }
+
+    // Conditional requests, `HEAD` requests, and large responses can be
+    // served without reading the entire file into memory, so we start with
+    // its metadata and only load the rest if we need to
+    {
+      const auto timer{current_request.timing.scope("open")};
+      file = sourcemeta::registry::CachedResponse::from(absolute_path, false);
+    }
+
+    if (!file) {
+      json_error(request->getMethod(), request->getUrl(), response, encoding,
+                 sourcemeta::registry::STATUS_NOT_FOUND, "not-found",
+                 "There is nothing at this URL");
+      return;
+    }
+
+    // Payloads stored in an encoding that clients cannot decode are read in
+    // full right away
+    fresh = file->body.has_value();
+  }
+
+  if (is_not_modified(request, file->etag, file->last_modified)) {
+    send_not_modified(request, response, enable_cors);
+    return;
+  }
+
+  // Prefer a precompressed variant that the client accepts, if any
+  for (std::size_t index = 0; index < current_request.variants_size; index++) {
+    const auto match{std::find_if(
+        file->variants.cbegin(), file->variants.cend(),
+        [&index](const auto &variant) {
+          return variant.encoding == current_request.variants[index];
+        })};
+    if (match != file->variants.cend() &&
+        serve_static_file_variant(request, response, *file, *match, code,
+                                  enable_cors, mime)) {
+      return;
+    }
+  }
+
+  const auto current_encoding{file->encoding};
+
+  if (!file->body.has_value()) {
+    // We know the size of the response in advance unless we would need to
+    // compress it on the fly
+    if (request->getMethod() == "head" &&
+        (encoding == current_encoding ||
+         encoding == ServerContentEncoding::Identity)) {
+      write_static_file_headers(response, *file, code, enable_cors, mime);
+      send_response_metadata(code, request->getMethod(), request->getUrl(),
+                             response,
+                             encoding == current_encoding ? file->stored_bytes
+                                                          : file->bytes,
+                             encoding);
+      return;
+    }
+
+    // Large responses that don't need re-encoding are streamed from a memory
+    // mapping, rather than copied into the heap
+    if (encoding == current_encoding &&
+        file->stored_bytes >= STREAM_THRESHOLD) {
+      auto mapping{sourcemeta::registry::MappedFile::open(absolute_path)};
+      // The payload is always at the end of the file
+      if (mapping && mapping->view().size() >= file->stored_bytes) {
+        const auto offset{mapping->view().size() - file->stored_bytes};
+        write_static_file_headers(response, *file, code, enable_cors, mime);
+        stream_response(code, request->getMethod(), request->getUrl(),
+                        response, std::move(mapping), offset,
+                        file->stored_bytes, encoding);
+        return;
+      }
+    }
+
+    auto entry{[&absolute_path] {
+      const auto timer{current_request.timing.scope("read")};
+      return sourcemeta::registry::CachedResponse::from(absolute_path, true);
+    }()};
+    if (!entry) {
+      json_error(request->getMethod(), request->getUrl(), response, encoding,
+                 sourcemeta::registry::STATUS_NOT_FOUND, "not-found",
+                 "There is nothing at this URL");
+      return;
+    }
+
+    file = std::move(entry);
+    fresh = true;
+  }
+
+  if (fresh) {
+    // As we cache the result, we only transcode the file the first time a
+    // client asks for this encoding
+    if (file->encoding != expected_encoding) {
+      {
+        const auto timer{current_request.timing.scope("transcode")};
+        file = file->transcode(expected_encoding);
+        metrics().count(
+            expected_encoding == sourcemeta::registry::Encoding::GZIP
+                ? sourcemeta::registry::MetricsCounter::Compressions
+                : sourcemeta::registry::MetricsCounter::Decompressions);
+      }
+
+      transcode_cache().insert(file);
+    } else {
+      response_cache().insert(file);
+    }
   }
+
+  assert(file->encoding == expected_encoding);
+  write_static_file_headers(response, *file, code, enable_cors, mime);
+  send_response(code, request->getMethod(), request->getUrl(), response,
+                file->body.value(), encoding, encoding);
 }
 
 static auto prefers_html(uWS::HttpRequest *const request) -> bool {
@@ -288,319 +623,1359 @@ static auto prefers_html(uWS::HttpRequest *const request) -> bool {
 
 constexpr auto SENTINEL{"%"};
 
+// Returns an empty path if there is no template to evaluate against, in
+// which case we already responded
+static auto evaluate_template(const std::filesystem::path &base,
+                              const std::string_view &path,
+                              uWS::HttpRequest *request,
+                              uWS::HttpResponse<true> *response,
+                              const ServerContentEncoding encoding,
+                              const sourcemeta::registry::EvaluateType mode)
+    -> std::filesystem::path {
+  auto template_path{base / "schemas"};
+  template_path /= path;
+  template_path /= SENTINEL;
+  // The exhaustive template can answer anything the fast one can, so we fall
+  // back to it if the collection did not opt into fast templates
+  if (mode == sourcemeta::registry::EvaluateType::Flag) {
+    template_path /= "blaze-fast.metapack";
+    if (std::filesystem::exists(template_path)) {
+      return template_path;
+    }
+
+    template_path.replace_filename("blaze-exhaustive.metapack");
+  } else {
+    template_path /= "blaze-exhaustive.metapack";
+  }
+
+  if (std::filesystem::exists(template_path)) {
+    return template_path;
+  }
+
+  const auto schema_path{template_path.parent_path() / "schema.metapack"};
+  if (std::filesystem::exists(schema_path)) {
+    json_error(request->getMethod(), request->getUrl(), response, encoding,
+               sourcemeta::registry::STATUS_METHOD_NOT_ALLOWED, "no-template",
+               "This schema was not precompiled for schema evaluation");
+  } else {
+    json_error(request->getMethod(), request->getUrl(), response, encoding,
+               sourcemeta::registry::STATUS_NOT_FOUND, "not-found",
+               "There is nothing at this URL");
+  }
+
+  return {};
+}
+
+// A CORS pre-flight request
+static auto send_evaluate_preflight(uWS::HttpRequest *request,
+                                    uWS::HttpResponse<true> *response)
+    -> void {
+  response->writeStatus(sourcemeta::registry::STATUS_NO_CONTENT);
+  response->writeHeader("Access-Control-Allow-Origin", "*");
+  response->writeHeader("Access-Control-Allow-Methods", "POST, OPTIONS");
+  response->writeHeader("Access-Control-Allow-Headers", "Content-Type");
+  response->writeHeader("Access-Control-Max-Age", "3600");
+  send_response(sourcemeta::registry::STATUS_NO_CONTENT, request->getMethod(),
+                request->getUrl(), response);
+}
+
+// Clients may compress large instances to save on upload bandwidth, but we
+// only support GZIP, as it is the encoding that every client can produce
+static auto request_content_encoding(uWS::HttpRequest *request)
+    -> std::optional<ServerContentEncoding> {
+  const auto value{request->getHeader("content-encoding")};
+  if (value.empty() || value == "identity") {
+    return ServerContentEncoding::Identity;
+  } else if (value == "gzip" || value == "x-gzip") {
+    return ServerContentEncoding::GZIP;
+  } else {
+    return std::nullopt;
+  }
+}
+
+static auto stream_trace(uWS::HttpResponse<true> *response,
+                         const ServerContentEncoding encoding,
+                         RequestState &&state, std::string &&url,
+                         std::string &&instance,
+                         const std::filesystem::path &template_path,
+                         const sourcemeta::registry::TraceOptions &options)
+    -> void;
+
 static auto on_evaluate(const std::filesystem::path &base,
                         const std::string_view &path, uWS::HttpRequest *request,
                         uWS::HttpResponse<true> *response,
                         const ServerContentEncoding encoding,
-                        const sourcemeta::registry::EvaluateType mode) -> void {
-  // A CORS pre-flight request
+                        const sourcemeta::registry::EvaluateType mode,
+                        const sourcemeta::registry::TraceOptions &trace_options,
+                        const bool lines) -> void {
   if (request->getMethod() == "options") {
-    response->writeStatus(sourcemeta::registry::STATUS_NO_CONTENT);
-    response->writeHeader("Access-Control-Allow-Origin", "*");
-    response->writeHeader("Access-Control-Allow-Methods", "POST, OPTIONS");
-    response->writeHeader("Access-Control-Allow-Headers", "Content-Type");
-    response->writeHeader("Access-Control-Max-Age", "3600");
-    send_response(sourcemeta::registry::STATUS_NO_CONTENT, request->getMethod(),
-                  request->getUrl(), response);
+    send_evaluate_preflight(request, response);
   } else if (request->getMethod() == "post") {
-    auto template_path{base / "schemas"};
-    template_path /= path;
-    template_path /= SENTINEL;
-    template_path /= "blaze-exhaustive.metapack";
-    if (!std::filesystem::exists(template_path)) {
-      const auto schema_path{template_path.parent_path() / "schema.metapack"};
-      if (std::filesystem::exists(schema_path)) {
-        json_error(request->getMethod(), request->getUrl(), response, encoding,
-                   sourcemeta::registry::STATUS_METHOD_NOT_ALLOWED,
-                   "no-template",
-                   "This schema was not precompiled for schema evaluation");
-      } else {
-        json_error(request->getMethod(), request->getUrl(), response, encoding,
-                   sourcemeta::registry::STATUS_NOT_FOUND, "not-found",
-                   "There is nothing at this URL");
-      }
+    auto template_path{
+        evaluate_template(base, path, request, response, encoding, mode)};
+    if (template_path.empty()) {
+      return;
+    }
 
+    const auto content_encoding{request_content_encoding(request)};
+    if (!content_encoding.has_value()) {
+      json_error(request->getMethod(), request->getUrl(), response, encoding,
+                 sourcemeta::registry::STATUS_UNSUPPORTED_MEDIA_TYPE,
+                 "unsupported-encoding",
+                 "The request body must be either uncompressed or compressed "
+                 "using GZIP",
+                 true);
       return;
     }
 
-    response->onAborted([]() {});
-    std::unique_ptr<std::string> buffer;
+    const auto limit{evaluate_body_limit()};
+    // The limit also applies to the decompressed body, as otherwise a small
+    // request might decompress into an arbitrarily large instance
+    std::unique_ptr<sourcemeta::registry::GUNZIPStream> decompressor;
+    if (content_encoding.value() == ServerContentEncoding::GZIP) {
+      decompressor = std::make_unique<sourcemeta::registry::GUNZIPStream>(
+          limit > 0 ? limit : std::numeric_limits<std::size_t>::max());
+    }
+
+    auto buffer{std::make_unique<std::string>()};
+    const auto content_length{request->getHeader("content-length")};
+    if (!content_length.empty()) {
+      std::size_t length{0};
+      const auto result{std::from_chars(
+          content_length.data(), content_length.data() + content_length.size(),
+          length)};
+      // Otherwise the body framing is not our problem
+      if (result.ec == std::errc{}) {
+        if (limit > 0 && length > limit) {
+          // Closing the connection, as otherwise we would still have to read
+          // the entire body before we can take the next request
+          json_error(request->getMethod(), request->getUrl(), response,
+                     encoding, sourcemeta::registry::STATUS_PAYLOAD_TOO_LARGE,
+                     "payload-too-large",
+                     "The instance exceeds the maximum size of " +
+                         std::to_string(limit) + " bytes",
+                     true);
+          return;
+        }
+
+        // Avoid some re-allocations as the chunks come in. The client controls
+        // the declared length, so we never reserve much before the body
+        // actually arrives. The length of a compressed body says nothing about
+        // the size of the instance, so we don't bother in that case
+        if (!decompressor) {
+          buffer->reserve(std::min(
+              {length, limit > 0 ? limit : length, EVALUATE_RESERVE_LIMIT}));
+        }
+      }
+    }
+
+    // The response must not be touched once the client goes away, and this is
+    // only ever written and read from the event loop thread
+    auto aborted{std::make_shared<bool>(false)};
+    response->onAborted([aborted]() { *aborted = true; });
     // Because `request` gets de-allocated
     std::string url{request->getUrl()};
-    response->onData([response, encoding, mode, buffer = std::move(buffer),
+    response->onData([response, encoding, mode, trace_options, lines, aborted,
+                      limit, state = current_request,
+                      buffer = std::move(buffer),
+                      decompressor = std::move(decompressor),
                       template_path = std::move(template_path),
                       url = std::move(url)](const std::string_view chunk,
                                             const bool is_last) mutable {
-      try {
-        if (!buffer.get()) {
-          buffer = std::make_unique<std::string>(chunk);
-        } else {
-          buffer->append(chunk);
-        }
+      // We already responded, but the connection only closes once the
+      // parser is done with what it has at hand
+      if (!buffer) {
+        return;
+      }
 
-        if (is_last) {
-          if (buffer->empty()) {
-            json_error("post", url, response, encoding,
-                       sourcemeta::registry::STATUS_BAD_REQUEST, "no-instance",
-                       "You must pass an instance to validate against");
-          } else {
-            const auto result{
-                sourcemeta::registry::evaluate(template_path, *buffer, mode)};
-            response->writeStatus(sourcemeta::registry::STATUS_OK);
-            response->writeHeader("Content-Type", "application/json");
-            response->writeHeader("Access-Control-Allow-Origin", "*");
-            std::ostringstream payload;
-            sourcemeta::core::prettify(result, payload);
-            send_response(sourcemeta::registry::STATUS_OK, "post", url,
-                          response, payload.str(), encoding,
-                          ServerContentEncoding::Identity);
+      // Closing the connection, as the client is still sending the body
+      const auto reject{[&](const char *const code, std::string &&id,
+                            std::string &&message) {
+        buffer.reset();
+        current_request = std::move(state);
+        json_error("post", url, response, encoding, code, std::move(id),
+                   std::move(message), true);
+        current_request.generation.reset();
+      }};
+
+      bool within_limit{true};
+      if (decompressor) {
+        // Decompressing as the chunks arrive, to overlap the work with the
+        // upload and to never hold the compressed body in memory
+        try {
+          within_limit = decompressor->write(chunk, *buffer);
+          if (within_limit && is_last) {
+            decompressor->end();
           }
+        } catch (const sourcemeta::registry::GZIPError &) {
+          reject(sourcemeta::registry::STATUS_BAD_REQUEST, "invalid-encoding",
+                 "The request body is not valid GZIP");
+          return;
         }
-      } catch (const std::exception &error) {
-        json_error("post", url, response, encoding,
-                   sourcemeta::registry::STATUS_METHOD_NOT_ALLOWED,
-                   "uncaught-error", error.what());
+      } else if (limit > 0 && buffer->size() + chunk.size() > limit) {
+        // Chunked requests do not declare their size upfront
+        within_limit = false;
+      } else {
+        buffer->append(chunk);
       }
-    });
-  } else {
-    json_error(request->getMethod(), request->getUrl(), response, encoding,
-               sourcemeta::registry::STATUS_METHOD_NOT_ALLOWED,
-               "method-not-allowed",
-               "This HTTP method is invalid for this URL");
-  }
-}
 
-static auto on_schema(const std::filesystem::path &base,
-                      const std::string_view &path, uWS::HttpRequest *request,
-                      uWS::HttpResponse<true> *response,
-                      const ServerContentEncoding encoding) -> void {
-  // Otherwise we may get unexpected results in case-sensitive file-systems
-  std::string lowercase_path{path};
-  std::transform(
-      lowercase_path.begin(), lowercase_path.end(), lowercase_path.begin(),
-      [](const unsigned char character) { return std::tolower(character); });
+      if (!within_limit) {
+        reject(sourcemeta::registry::STATUS_PAYLOAD_TOO_LARGE,
+               "payload-too-large",
+               "The instance exceeds the maximum size of " +
+                   std::to_string(limit) + " bytes");
+        return;
+      }
 
-  // Because Visual Studio Code famously does not support `$id` or `id`
-  // See
-  // https://github.com/microsoft/vscode-json-languageservice/issues/224
-  const auto &user_agent{request->getHeader("user-agent")};
-  const auto is_vscode{user_agent.starts_with("Visual Studio Code") ||
-                       user_agent.starts_with("VSCodium")};
-  const auto is_deno{user_agent.starts_with("Deno/")};
-  const auto bundle{!request->getQuery("bundle").empty()};
-  auto absolute_path{base / "schemas" / lowercase_path / SENTINEL};
-  if (is_vscode) {
-    absolute_path /= "editor.metapack";
-  } else if (bundle || is_deno) {
-    absolute_path /= "bundle.metapack";
-  } else {
-    absolute_path /= "schema.metapack";
-  }
+      if (!is_last) {
+        return;
+      }
 
-  if (is_deno) {
-    serve_static_file(request, response, encoding, absolute_path,
-                      sourcemeta::registry::STATUS_OK, true,
-                      // For HTTP imports, as Deno won't like the
-                      // `application/schema+json` one
-                      "application/json");
+      if (state.timing.enabled()) {
+        state.timing.add("receive",
+                         std::chrono::steady_clock::now() - state.start);
+      }
+
+      if (buffer->empty()) {
+        current_request = std::move(state);
+        json_error("post", url, response, encoding,
+                   sourcemeta::registry::STATUS_BAD_REQUEST, "no-instance",
+                   "You must pass an instance to validate against");
+        current_request.generation.reset();
+        return;
+      }
+
+      if (lines) {
+        assert(mode == sourcemeta::registry::EvaluateType::Trace);
+        stream_trace(response, encoding, std::move(state), std::move(url),
+                     std::move(*buffer), template_path, trace_options);
+        return;
+      }
+
+      // Evaluation might take an arbitrary amount of time, so we do it
+      // outside the event loop and post the result back to it
+      auto *const loop{uWS::Loop::get()};
+      evaluate_pool().submit(
+          [loop, response, encoding, mode, trace_options, aborted, state,
+           instance = std::move(*buffer), template_path, url](
+              const std::chrono::steady_clock::duration wait,
+              const std::size_t) mutable {
+            metrics().queue(wait);
+            state.timing.add("queue", wait);
+
+            std::string payload;
+            std::optional<std::string> error;
+            try {
+              const auto schema_template{[&state, &template_path] {
+                const auto timer{state.timing.scope("template")};
+                return template_cache().fetch(template_path);
+              }()};
+              const auto result{sourcemeta::registry::evaluate(
+                  *schema_template, template_path, instance, mode,
+                  trace_options, state.timing)};
+              const auto timer{state.timing.scope("serialise")};
+              std::ostringstream output;
+              sourcemeta::core::prettify(result, output);
+              payload = std::move(output).str();
+            } catch (const std::exception &exception) {
+              error = exception.what();
+            }
+
+            loop->defer([response, encoding, aborted, state = std::move(state),
+                         url = std::move(url), payload = std::move(payload),
+                         error = std::move(error)]() mutable {
+              // The client went away while we were busy
+              if (*aborted) {
+                return;
+              }
+
+              current_request = std::move(state);
+              response->cork([response, encoding, &url, &payload, &error]() {
+                if (error.has_value()) {
+                  json_error("post", url, response, encoding,
+                             sourcemeta::registry::STATUS_METHOD_NOT_ALLOWED,
+                             "uncaught-error", std::move(error).value());
+                } else {
+                  response->writeStatus(sourcemeta::registry::STATUS_OK);
+                  response->writeHeader("Content-Type", "application/json");
+                  response->writeHeader("Access-Control-Allow-Origin", "*");
+                  send_response(sourcemeta::registry::STATUS_OK, "post", url,
+                                response, payload, encoding,
+                                ServerContentEncoding::Identity);
+                }
+              });
+
+              current_request.generation.reset();
+            });
+          });
+    });
   } else {
-    serve_static_file(request, response, encoding, absolute_path,
-                      sourcemeta::registry::STATUS_OK, true);
+    json_error(request->getMethod(), request->getUrl(), response, encoding,
+               sourcemeta::registry::STATUS_METHOD_NOT_ALLOWED,
+               "method-not-allowed",
+               "This HTTP method is invalid for this URL");
   }
 }
 
-static auto on_request(const std::filesystem::path &base,
-                       uWS::HttpRequest *request,
-                       uWS::HttpResponse<true> *response,
-                       const ServerContentEncoding encoding,
-                       const bool is_headless) -> void {
-  if (request->getUrl() == "/") {
-    if (prefers_html(request)) {
-      serve_static_file(request, response, encoding,
-                        base / "explorer" / SENTINEL /
-                            "directory-html.metapack",
-                        sourcemeta::registry::STATUS_OK);
-    } else if (request->getMethod() == "get" ||
-               request->getMethod() == "head") {
-      json_error(request->getMethod(), request->getUrl(), response, encoding,
-                 sourcemeta::registry::STATUS_NOT_FOUND, "not-found",
-                 "There is nothing at this URL");
-    } else {
-      json_error(request->getMethod(), request->getUrl(), response, encoding,
-                 sourcemeta::registry::STATUS_METHOD_NOT_ALLOWED,
-                 "method-not-allowed",
-                 "This HTTP method is invalid for this URL");
+// Once the complete lines of a batch that are waiting to be evaluated take
+// more than this, we stop reading the request until we catch up
+constexpr std::size_t BATCH_PENDING_LIMIT{1024 * 1024};
+// The most input we evaluate before posting the results, so that we notice
+// soon enough if the client is not reading them
+constexpr std::size_t BATCH_ROUND_LIMIT{64 * 1024};
+// The same as the idle timeout of uWebSockets
+constexpr unsigned int BATCH_IDLE_TIMEOUT{10};
+
+// A batch evaluation is driven by the event loop thread, which receives the
+// request and sends the response, and by at most one worker at a time, which
+// evaluates whatever complete lines arrived so far and posts the results back
+struct BatchEvaluation {
+  uWS::Loop *loop;
+  uWS::HttpResponse<true> *response;
+  ServerContentEncoding encoding;
+  sourcemeta::registry::EvaluateType mode;
+  std::filesystem::path template_path;
+  std::string url;
+  bool timing;
+  // The response must not be touched once the client goes away
+  std::atomic<bool> aborted{false};
+
+  // Only ever touched by the event loop thread
+  RequestState state;
+  bool started{false};
+  std::size_t bytes{0};
+
+  // Only ever touched by the worker that is running
+  std::shared_ptr<const sourcemeta::blaze::Template> schema_template;
+  sourcemeta::blaze::Evaluator evaluator;
+
+  std::mutex mutex;
+  // Guarded by the mutex
+  std::string pending;
+  // We got the entire request
+  bool received{false};
+  // We evaluated the entire request, or gave up
+  bool finished{false};
+  bool running{false};
+  // We stopped reading the request
+  bool throttled{false};
+  // We stopped evaluating until the client reads what we sent so far
+  bool congested{false};
+};
+
+static auto drain_batch(const std::shared_ptr<BatchEvaluation> &batch,
+                        const std::chrono::steady_clock::duration wait)
+    -> void;
+
+// Must be called with the mutex held
+static auto schedule_batch(const std::shared_ptr<BatchEvaluation> &batch)
+    -> void {
+  if (batch->running || batch->finished || batch->congested ||
+      (!batch->received && batch->pending.find('\n') == std::string::npos)) {
+    return;
+  }
+
+  batch->running = true;
+  evaluate_pool().submit(
+      [batch](const std::chrono::steady_clock::duration wait,
+              const std::size_t) { drain_batch(batch, wait); });
+}
+
+// Runs on the event loop thread
+static auto send_batch(const std::shared_ptr<BatchEvaluation> &batch,
+                       const std::string &chunk,
+                       std::optional<std::string> &&error, const bool last)
+    -> void {
+  if (batch->aborted.load(std::memory_order_relaxed)) {
+    return;
+  }
+
+  auto *const response{batch->response};
+  current_request = batch->state;
+  response->cork([&batch, response, &chunk, &error, last]() {
+    if (!batch->started) {
+      if (error.has_value()) {
+        json_error("post", batch->url, response, batch->encoding,
+                   sourcemeta::registry::STATUS_METHOD_NOT_ALLOWED,
+                   "uncaught-error", std::move(error).value());
+        return;
+      } else if (chunk.empty()) {
+        // Nothing but empty lines so far
+        if (last) {
+          json_error("post", batch->url, response, batch->encoding,
+                     sourcemeta::registry::STATUS_BAD_REQUEST, "no-instance",
+                     "You must pass at least one instance to validate against");
+        }
+
+        return;
+      }
+
+      // We stream the results as they come, so we don't compress them
+      response->writeStatus(sourcemeta::registry::STATUS_OK);
+      response->writeHeader("Content-Type", "application/jsonl");
+      response->writeHeader("Access-Control-Allow-Origin", "*");
+      write_server_timing(response);
+      batch->started = true;
     }
-  } else if (request->getUrl() == "/self/api/list") {
-    serve_static_file(request, response, encoding,
-                      base / "explorer" / SENTINEL / "directory.metapack",
-                      sourcemeta::registry::STATUS_OK, true);
-  } else if (request->getUrl().starts_with("/self/api/list/")) {
-    const auto absolute_path{base / "explorer" / request->getUrl().substr(15) /
-                             SENTINEL / "directory.metapack"};
-    serve_static_file(request, response, encoding, absolute_path,
-                      sourcemeta::registry::STATUS_OK, true);
-  } else if (request->getUrl().starts_with("/self/api/schemas/dependencies/")) {
-    if (request->getMethod() == "get" || request->getMethod() == "head") {
-      auto absolute_path{base / "schemas"};
-      absolute_path /= request->getUrl().substr(31);
-      absolute_path /= SENTINEL;
-      absolute_path /= "dependencies.metapack";
-      serve_static_file(request, response, encoding, absolute_path,
-                        sourcemeta::registry::STATUS_OK, true);
-    } else {
-      json_error(request->getMethod(), request->getUrl(), response, encoding,
-                 sourcemeta::registry::STATUS_METHOD_NOT_ALLOWED,
-                 "method-not-allowed",
-                 "This HTTP method is invalid for this URL");
+
+    std::string body{chunk};
+    // The status is already out, so the best we can do is to say so in place
+    // of the rest of the results
+    if (error.has_value()) {
+      auto object{sourcemeta::core::JSON::make_object()};
+      object.assign("title", sourcemeta::core::JSON{
+                                 "sourcemeta:registry/uncaught-error"});
+      object.assign("detail",
+                    sourcemeta::core::JSON{std::move(error).value()});
+      std::ostringstream line;
+      sourcemeta::core::stringify(object, line);
+      line << '\n';
+      body += line.view();
     }
-  } else if (request->getUrl().starts_with("/self/api/schemas/health/")) {
-    if (request->getMethod() == "get" || request->getMethod() == "head") {
-      auto absolute_path{base / "schemas"};
-      absolute_path /= request->getUrl().substr(25);
-      absolute_path /= SENTINEL;
-      absolute_path /= "health.metapack";
-      serve_static_file(request, response, encoding, absolute_path,
-                        sourcemeta::registry::STATUS_OK, true);
-    } else {
-      json_error(request->getMethod(), request->getUrl(), response, encoding,
-                 sourcemeta::registry::STATUS_METHOD_NOT_ALLOWED,
-                 "method-not-allowed",
-                 "This HTTP method is invalid for this URL");
+
+    batch->bytes += body.size();
+    // Whatever does not fit in the socket is kept by uWebSockets
+    if (!response->write(body) && !last) {
+      std::lock_guard<std::mutex> lock{batch->mutex};
+      batch->congested = true;
+      response->onWritable([batch](const std::uintmax_t) {
+        // uWebSockets only sends what it kept once we stop listening
+        batch->response->onWritable(nullptr);
+        std::lock_guard<std::mutex> writable_lock{batch->mutex};
+        batch->congested = false;
+        schedule_batch(batch);
+        return true;
+      });
     }
-  } else if (request->getUrl().starts_with("/self/api/schemas/locations/")) {
-    if (request->getMethod() == "get" || request->getMethod() == "head") {
-      auto absolute_path{base / "schemas"};
-      absolute_path /= request->getUrl().substr(28);
-      absolute_path /= SENTINEL;
-      absolute_path /= "locations.metapack";
-      serve_static_file(request, response, encoding, absolute_path,
-                        sourcemeta::registry::STATUS_OK, true);
-    } else {
-      json_error(request->getMethod(), request->getUrl(), response, encoding,
-                 sourcemeta::registry::STATUS_METHOD_NOT_ALLOWED,
-                 "method-not-allowed",
-                 "This HTTP method is invalid for this URL");
+
+    if (last) {
+      response->end();
+      log_access(sourcemeta::registry::STATUS_OK, "post", batch->url,
+                 batch->bytes);
     }
-  } else if (request->getUrl().starts_with("/self/api/schemas/positions/")) {
-    if (request->getMethod() == "get" || request->getMethod() == "head") {
-      auto absolute_path{base / "schemas"};
-      absolute_path /= request->getUrl().substr(28);
-      absolute_path /= SENTINEL;
-      absolute_path /= "positions.metapack";
-      serve_static_file(request, response, encoding, absolute_path,
-                        sourcemeta::registry::STATUS_OK, true);
-    } else {
-      json_error(request->getMethod(), request->getUrl(), response, encoding,
-                 sourcemeta::registry::STATUS_METHOD_NOT_ALLOWED,
-                 "method-not-allowed",
-                 "This HTTP method is invalid for this URL");
+  });
+
+  current_request.generation.reset();
+}
+
+static auto drain_batch(const std::shared_ptr<BatchEvaluation> &batch,
+                        const std::chrono::steady_clock::duration wait)
+    -> void {
+  // Each round reports the timing of the work that went into it, but only
+  // the first one with results makes it into the response headers
+  sourcemeta::registry::ServerTiming timing{batch->timing};
+  metrics().queue(wait);
+  timing.add("queue", wait);
+  while (!batch->aborted.load(std::memory_order_relaxed)) {
+    std::string input;
+    bool last{false};
+    bool resume{false};
+    {
+      std::lock_guard<std::mutex> lock{batch->mutex};
+      // Complete lines up to the round limit, unless a single line is bigger
+      // than that. We only take the last line without a newline once we got
+      // the entire request
+      const auto &pending{batch->pending};
+      auto newline{pending.size() > BATCH_ROUND_LIMIT
+                       ? pending.rfind('\n', BATCH_ROUND_LIMIT)
+                       : pending.rfind('\n')};
+      if (newline == std::string::npos) {
+        newline = pending.find('\n');
+      }
+
+      const auto end{newline != std::string::npos ? newline + 1
+                     : batch->received           ? pending.size()
+                                                 : 0};
+      if (batch->congested || (end == 0 && !batch->received)) {
+        batch->running = false;
+        return;
+      }
+
+      input = pending.substr(0, end);
+      batch->pending.erase(0, end);
+      last = batch->received && batch->pending.empty();
+      batch->finished = last;
+      if (batch->throttled && batch->pending.size() < BATCH_PENDING_LIMIT) {
+        batch->throttled = false;
+        resume = true;
+      }
     }
-  } else if (request->getUrl().starts_with("/self/api/schemas/stats/")) {
-    if (request->getMethod() == "get" || request->getMethod() == "head") {
-      auto absolute_path{base / "schemas"};
-      absolute_path /= request->getUrl().substr(24);
-      absolute_path /= SENTINEL;
-      absolute_path /= "stats.metapack";
-      serve_static_file(request, response, encoding, absolute_path,
-                        sourcemeta::registry::STATUS_OK, true);
-    } else {
-      json_error(request->getMethod(), request->getUrl(), response, encoding,
-                 sourcemeta::registry::STATUS_METHOD_NOT_ALLOWED,
-                 "method-not-allowed",
-                 "This HTTP method is invalid for this URL");
+
+    if (resume) {
+      batch->loop->defer([batch]() {
+        if (!batch->aborted.load(std::memory_order_relaxed)) {
+          sourcemeta::registry::throttle_reads(batch->response, false,
+                                              BATCH_IDLE_TIMEOUT);
+        }
+      });
     }
-  } else if (request->getUrl().starts_with("/self/api/schemas/metadata/")) {
-    if (request->getMethod() == "get" || request->getMethod() == "head") {
-      auto absolute_path{base / "explorer"};
-      absolute_path /= request->getUrl().substr(27);
-      absolute_path /= SENTINEL;
-      absolute_path /= "schema.metapack";
-      serve_static_file(request, response, encoding, absolute_path,
-                        sourcemeta::registry::STATUS_OK, true);
-    } else {
-      json_error(request->getMethod(), request->getUrl(), response, encoding,
-                 sourcemeta::registry::STATUS_METHOD_NOT_ALLOWED,
-                 "method-not-allowed",
-                 "This HTTP method is invalid for this URL");
+
+    std::ostringstream output;
+    std::optional<std::string> error;
+    try {
+      if (!batch->schema_template) {
+        const auto timer{timing.scope("template")};
+        batch->schema_template = template_cache().fetch(batch->template_path);
+      }
+
+      sourcemeta::registry::evaluate_lines(batch->evaluator,
+                                           *batch->schema_template, input,
+                                           batch->mode, output, timing);
+    } catch (const std::exception &exception) {
+      error = exception.what();
+      std::lock_guard<std::mutex> lock{batch->mutex};
+      batch->finished = true;
+      batch->pending.clear();
+      last = true;
     }
-  } else if (request->getUrl().starts_with("/self/api/schemas/evaluate/")) {
-    on_evaluate(base, request->getUrl().substr(27), request, response, encoding,
-                sourcemeta::registry::EvaluateType::Standard);
-  } else if (request->getUrl().starts_with("/self/api/schemas/trace/")) {
-    on_evaluate(base, request->getUrl().substr(24), request, response, encoding,
-                sourcemeta::registry::EvaluateType::Trace);
-  } else if (request->getUrl() == "/self/api/schemas/search") {
-    if (request->getMethod() == "get") {
-      const auto query{request->getQuery("q")};
-      if (query.empty()) {
-        json_error(request->getMethod(), request->getUrl(), response, encoding,
-                   sourcemeta::registry::STATUS_BAD_REQUEST, "missing-query",
-                   "You must provide a query parameter to search for");
-      } else {
-        auto result{sourcemeta::registry::search(
-            base / "explorer" / SENTINEL / "search.metapack", query)};
-        response->writeStatus(sourcemeta::registry::STATUS_OK);
-        response->writeHeader("Access-Control-Allow-Origin", "*");
-        response->writeHeader("Content-Type", "application/json");
-        std::ostringstream output;
-        sourcemeta::core::prettify(result, output);
-        send_response(sourcemeta::registry::STATUS_OK, request->getMethod(),
-                      request->getUrl(), response, output.str(), encoding,
-                      ServerContentEncoding::Identity);
+
+    batch->loop->defer([batch, chunk = std::move(output).str(),
+                        error = std::move(error), last, timing]() mutable {
+      if (!batch->started) {
+        batch->state.timing = timing;
       }
-    } else {
-      json_error(request->getMethod(), request->getUrl(), response, encoding,
-                 sourcemeta::registry::STATUS_METHOD_NOT_ALLOWED,
-                 "method-not-allowed",
-                 "This HTTP method is invalid for this URL");
+
+      send_batch(batch, chunk, std::move(error), last);
+    });
+
+    if (last) {
+      return;
+    }
+
+    timing = sourcemeta::registry::ServerTiming{batch->timing};
+  }
+}
+
+// How much of a streaming trace the worker hands over to the event loop thread
+// at once
+constexpr std::size_t TRACE_CHUNK_SIZE{64 * 1024};
+// Once this much of a trace is waiting for a slow client, the worker gives up
+// on the rest of the evaluation instead of waiting for the client to catch up
+constexpr std::size_t TRACE_PENDING_LIMIT{16 * 1024 * 1024};
+
+// A streaming trace is evaluated by a single worker, which hands the steps
+// over to the event loop thread as it goes. The event loop thread holds on to
+// whatever the client is not ready for yet, so a slow client never blocks a
+// worker, and only ever up to a limit, so we never hold the entire trace
+struct TraceStream {
+  uWS::Loop *loop;
+  uWS::HttpResponse<true> *response;
+  ServerContentEncoding encoding;
+  std::string url;
+
+  // Only ever touched by the event loop thread
+  RequestState state;
+  bool started{false};
+  std::size_t bytes{0};
+  // The output we wait to send until the client reads what we sent so far
+  std::string pending;
+  bool congested{false};
+  bool finished{false};
+
+  // The output we handed over that the event loop thread did not pass on to
+  // uWebSockets yet, including what is pending
+  std::atomic<std::size_t> queued{0};
+  // The response must not be touched once the client goes away
+  std::atomic<bool> aborted{false};
+};
+
+// Thrown from within the evaluation to stop it half-way through
+struct TraceStopped {};
+
+// Runs on the event loop thread
+static auto finish_trace(const std::shared_ptr<TraceStream> &stream) -> void {
+  stream->response->end();
+  log_access(sourcemeta::registry::STATUS_OK, "post", stream->url,
+             stream->bytes);
+}
+
+// Runs on the event loop thread
+static auto send_trace(const std::shared_ptr<TraceStream> &stream,
+                       const std::string &chunk,
+                       std::optional<std::string> &&error, const bool last)
+    -> void {
+  if (stream->aborted.load(std::memory_order_relaxed)) {
+    stream->queued.fetch_sub(chunk.size(), std::memory_order_relaxed);
+    return;
+  }
+
+  auto *const response{stream->response};
+  current_request = stream->state;
+  response->cork([&stream, response, &chunk, &error, last]() {
+    if (!stream->started) {
+      if (error.has_value()) {
+        json_error("post", stream->url, response, stream->encoding,
+                   sourcemeta::registry::STATUS_METHOD_NOT_ALLOWED,
+                   "uncaught-error", std::move(error).value());
+        return;
+      }
+
+      // We stream the steps as they come, so we don't compress them
+      response->writeStatus(sourcemeta::registry::STATUS_OK);
+      response->writeHeader("Content-Type", "application/jsonl");
+      response->writeHeader("Access-Control-Allow-Origin", "*");
+      write_server_timing(response);
+      stream->started = true;
+    }
+
+    std::string body{chunk};
+    // The status is already out, so the best we can do is to say so in place
+    // of the rest of the steps
+    if (error.has_value()) {
+      auto object{sourcemeta::core::JSON::make_object()};
+      object.assign("title", sourcemeta::core::JSON{
+                                 "sourcemeta:registry/uncaught-error"});
+      object.assign("detail",
+                    sourcemeta::core::JSON{std::move(error).value()});
+      std::ostringstream line;
+      sourcemeta::core::stringify(object, line);
+      line << '\n';
+      body += line.view();
+    }
+
+    stream->bytes += body.size();
+    stream->finished = last;
+    if (stream->congested) {
+      stream->queued.fetch_add(body.size() - chunk.size(),
+                               std::memory_order_relaxed);
+      stream->pending += body;
+      return;
+    }
+
+    // Whatever does not fit in the socket is kept by uWebSockets, but we
+    // keep the rest to ourselves until the client reads it
+    stream->queued.fetch_sub(chunk.size(), std::memory_order_relaxed);
+    if (!response->write(body)) {
+      stream->congested = true;
+      response->onWritable([stream](const std::uintmax_t) {
+        if (!stream->pending.empty()) {
+          const auto pending{std::move(stream->pending)};
+          stream->pending.clear();
+          stream->queued.fetch_sub(pending.size(), std::memory_order_relaxed);
+          // Writing also sends what uWebSockets kept so far
+          if (!stream->response->write(pending)) {
+            return true;
+          }
+        }
+
+        // uWebSockets only sends what it kept once we stop listening
+        stream->response->onWritable(nullptr);
+        stream->congested = false;
+        if (stream->finished) {
+          finish_trace(stream);
+        }
+
+        return true;
+      });
+    }
+
+    if (last && !stream->congested) {
+      finish_trace(stream);
+    }
+  });
+
+  current_request.generation.reset();
+}
+
+static auto stream_trace(uWS::HttpResponse<true> *response,
+                         const ServerContentEncoding encoding,
+                         RequestState &&state, std::string &&url,
+                         std::string &&instance,
+                         const std::filesystem::path &template_path,
+                         const sourcemeta::registry::TraceOptions &options)
+    -> void {
+  auto stream{std::make_shared<TraceStream>()};
+  stream->loop = uWS::Loop::get();
+  stream->response = response;
+  stream->encoding = encoding;
+  stream->url = std::move(url);
+  stream->state = std::move(state);
+  response->onAborted([stream]() {
+    stream->aborted.store(true, std::memory_order_relaxed);
+  });
+
+  evaluate_pool().submit([stream, instance = std::move(instance),
+                          template_path, options,
+                          timing = stream->state.timing](
+                             const std::chrono::steady_clock::duration wait,
+                             const std::size_t) mutable {
+    metrics().queue(wait);
+    timing.add("queue", wait);
+
+    // Only the timing of the work before the first part of the trace makes it
+    // into the response headers
+    const auto post{[&stream, &timing](std::string &&chunk,
+                                       std::optional<std::string> &&error,
+                                       const bool last) {
+      stream->queued.fetch_add(chunk.size(), std::memory_order_relaxed);
+      stream->loop->defer([stream, chunk = std::move(chunk),
+                           error = std::move(error), last,
+                           timing]() mutable {
+        if (!stream->started) {
+          stream->state.timing = timing;
+        }
+
+        send_trace(stream, chunk, std::move(error), last);
+      });
+    }};
+
+    std::optional<std::string> error;
+    try {
+      const auto schema_template{[&timing, &template_path] {
+        const auto timer{timing.scope("template")};
+        return template_cache().fetch(template_path);
+      }()};
+      sourcemeta::registry::trace_lines(
+          *schema_template, template_path, instance, options,
+          TRACE_CHUNK_SIZE,
+          [&stream, &post](std::string &&chunk, const bool last) {
+            if (stream->aborted.load(std::memory_order_relaxed)) {
+              throw TraceStopped{};
+            }
+
+            // Waiting for the client would hold on to a worker that other
+            // evaluations need, so we give up on the client instead
+            if (stream->queued.load(std::memory_order_relaxed) +
+                    chunk.size() >
+                TRACE_PENDING_LIMIT) {
+              auto object{sourcemeta::core::JSON::make_object()};
+              object.assign("title", sourcemeta::core::JSON{
+                                         "sourcemeta:registry/trace-too-slow"});
+              object.assign("detail",
+                            sourcemeta::core::JSON{
+                                "The client did not read the trace fast "
+                                "enough, so the rest of it was discarded"});
+              std::ostringstream line;
+              sourcemeta::core::stringify(object, line);
+              line << '\n';
+              post(std::move(line).str(), std::nullopt, true);
+              throw TraceStopped{};
+            }
+
+            post(std::move(chunk), std::nullopt, last);
+          },
+          timing);
+      return;
+    } catch (const TraceStopped &) {
+      return;
+    } catch (const std::exception &exception) {
+      error = exception.what();
     }
-  } else if (request->getUrl().starts_with("/self/api/")) {
+
+    post(std::string{}, std::move(error), true);
+  });
+}
+
+static auto on_evaluate_batch(const std::filesystem::path &base,
+                              const std::string_view &path,
+                              uWS::HttpRequest *request,
+                              uWS::HttpResponse<true> *response,
+                              const ServerContentEncoding encoding,
+                              const sourcemeta::registry::EvaluateType mode)
+    -> void {
+  if (request->getMethod() == "options") {
+    send_evaluate_preflight(request, response);
+    return;
+  } else if (request->getMethod() != "post") {
     json_error(request->getMethod(), request->getUrl(), response, encoding,
-               sourcemeta::registry::STATUS_NOT_FOUND, "not-found",
-               "There is nothing at this URL");
-  } else if (!is_headless && request->getUrl().starts_with("/self/static/")) {
-    std::ostringstream absolute_path;
-    absolute_path << SOURCEMETA_REGISTRY_STATIC;
-    absolute_path << request->getUrl().substr(12);
-    serve_static_file(request, response, encoding, absolute_path.str(),
-                      sourcemeta::registry::STATUS_OK);
-  } else if (request->getUrl().ends_with(".json")) {
-    on_schema(base, request->getUrl().substr(1, request->getUrl().size() - 6),
-              request, response, encoding);
-  } else if (request->getMethod() == "get" || request->getMethod() == "head") {
-    if (prefers_html(request)) {
-      auto absolute_path{base / "explorer" / request->getUrl().substr(1) /
-                         SENTINEL};
-      if (std::filesystem::exists(absolute_path / "schema-html.metapack")) {
-        serve_static_file(request, response, encoding,
-                          absolute_path / "schema-html.metapack",
-                          sourcemeta::registry::STATUS_OK);
-      } else {
-        absolute_path /= "directory-html.metapack";
-        if (std::filesystem::exists(absolute_path)) {
-          serve_static_file(request, response, encoding, absolute_path,
-                            sourcemeta::registry::STATUS_OK);
-        } else {
-          serve_static_file(request, response, encoding,
-                            base / "explorer" / SENTINEL / "404.metapack",
-                            sourcemeta::registry::STATUS_NOT_FOUND);
+               sourcemeta::registry::STATUS_METHOD_NOT_ALLOWED,
+               "method-not-allowed",
+               "This HTTP method is invalid for this URL");
+    return;
+  }
+
+  auto template_path{
+      evaluate_template(base, path, request, response, encoding, mode)};
+  if (template_path.empty()) {
+    return;
+  }
+
+  if (request_content_encoding(request) != ServerContentEncoding::Identity) {
+    json_error(request->getMethod(), request->getUrl(), response, encoding,
+               sourcemeta::registry::STATUS_UNSUPPORTED_MEDIA_TYPE,
+               "unsupported-encoding", "The request body must be uncompressed",
+               true);
+    return;
+  }
+
+  auto batch{std::make_shared<BatchEvaluation>()};
+  batch->loop = uWS::Loop::get();
+  batch->response = response;
+  batch->template_path = std::move(template_path);
+  // Because `request` gets de-allocated
+  batch->url = request->getUrl();
+  batch->encoding = encoding;
+  batch->mode = mode;
+  batch->timing = current_request.timing.enabled();
+  batch->state = current_request;
+  response->onAborted([batch]() {
+    batch->aborted.store(true, std::memory_order_relaxed);
+  });
+
+  response->onData([batch](const std::string_view chunk, const bool is_last) {
+    std::lock_guard<std::mutex> lock{batch->mutex};
+    if (batch->finished) {
+      return;
+    }
+
+    batch->pending.append(chunk);
+    batch->received = is_last;
+    // Throttling again even if we think we already did, as the socket might
+    // have started reading by itself
+    const auto end{batch->pending.rfind('\n')};
+    if (!is_last && end != std::string::npos && end >= BATCH_PENDING_LIMIT) {
+      batch->throttled = true;
+      sourcemeta::registry::throttle_reads(batch->response, true,
+                                          BATCH_IDLE_TIMEOUT);
+    }
+
+    schedule_batch(batch);
+  });
+}
+
+struct RequestContext {
+  const sourcemeta::registry::Generation &generation;
+  uWS::HttpRequest *const request;
+  uWS::HttpResponse<true> *const response;
+  const ServerContentEncoding encoding;
+};
+
+static auto not_found(const RequestContext &context) -> void {
+  json_error(context.request->getMethod(), context.request->getUrl(),
+             context.response, context.encoding,
+             sourcemeta::registry::STATUS_NOT_FOUND, "not-found",
+             "There is nothing at this URL");
+}
+
+static auto method_not_allowed(const RequestContext &context) -> void {
+  json_error(context.request->getMethod(), context.request->getUrl(),
+             context.response, context.encoding,
+             sourcemeta::registry::STATUS_METHOD_NOT_ALLOWED,
+             "method-not-allowed", "This HTTP method is invalid for this URL");
+}
+
+static auto serve_artifact(const RequestContext &context,
+                           const std::string_view key, const char *const code,
+                           const bool enable_cors = false,
+                           const std::optional<std::string> &mime =
+                               std::nullopt) -> void {
+  if (context.generation.artifacts.contains(key)) {
+    serve_static_file(context.request, context.response, context.encoding,
+                      context.generation.artifacts.path(key), code,
+                      enable_cors, mime);
+  } else {
+    not_found(context);
+  }
+}
+
+static auto on_schema(const RequestContext &context,
+                      const std::string_view &path) -> void {
+  // Because Visual Studio Code famously does not support `$id` or `id`
+  // See
+  // https://github.com/microsoft/vscode-json-languageservice/issues/224
+  const auto &user_agent{context.request->getHeader("user-agent")};
+  const auto is_vscode{user_agent.starts_with("Visual Studio Code") ||
+                       user_agent.starts_with("VSCodium")};
+  const auto is_deno{user_agent.starts_with("Deno/")};
+  const auto bundle{!context.request->getQuery("bundle").empty()};
+  std::string buffer;
+  const auto key{sourcemeta::registry::ArtifactIndex::key(
+      buffer, "schemas", path,
+      is_vscode             ? "editor.metapack"
+      : bundle || is_deno ? "bundle.metapack"
+                            : "schema.metapack",
+      true)};
+
+  if (is_deno) {
+    serve_artifact(context, key, sourcemeta::registry::STATUS_OK, true,
+                   // For HTTP imports, as Deno won't like the
+                   // `application/schema+json` one
+                   "application/json");
+  } else {
+    serve_artifact(context, key, sourcemeta::registry::STATUS_OK, true);
+  }
+}
+
+// Returns nothing if any facet is invalid
+static auto search_filter(uWS::HttpRequest *request)
+    -> std::optional<sourcemeta::registry::SearchFilter> {
+  sourcemeta::registry::SearchFilter result;
+  const auto dialect{request->getQuery("dialect")};
+  if (!dialect.empty()) {
+    result.dialect = dialect;
+  }
+
+  const auto health{request->getQuery("health")};
+  if (!health.empty()) {
+    unsigned int value{0};
+    const auto parsed{
+        std::from_chars(health.data(), health.data() + health.size(), value)};
+    if (parsed.ec != std::errc{} ||
+        parsed.ptr != health.data() + health.size() || value > 100) {
+      return std::nullopt;
+    }
+
+    result.health = static_cast<std::uint8_t>(value);
+  }
+
+  const auto collection{request->getQuery("collection")};
+  if (!collection.empty()) {
+    result.collection = collection;
+  }
+
+  for (const auto &[name, facet] :
+       {std::make_pair("alert", &result.alert),
+        std::make_pair("provenance", &result.provenance)}) {
+    const auto value{request->getQuery(name)};
+    if (value == "true") {
+      *facet = true;
+    } else if (value == "false") {
+      *facet = false;
+    } else if (!value.empty()) {
+      return std::nullopt;
+    }
+  }
+
+  return result;
+}
+
+struct Route;
+using RouteHandler = auto (*)(const RequestContext &, const Route &,
+                              std::string_view) -> void;
+
+struct Route {
+  std::string_view url;
+  // Otherwise the URL must match exactly
+  bool is_prefix;
+  RouteHandler handler;
+  sourcemeta::registry::RouteFamily family;
+  // For routes that serve pre-computed artifacts
+  std::string_view tree{};
+  std::string_view artifact{};
+};
+
+static auto on_route_artifact(const RequestContext &context,
+                              const Route &route, std::string_view rest)
+    -> void {
+  std::string buffer;
+  const auto key{sourcemeta::registry::ArtifactIndex::key(
+      buffer, route.tree, rest, route.artifact)};
+  if (context.request->getMethod() == "get" ||
+      context.request->getMethod() == "head") {
+    serve_artifact(context, key, sourcemeta::registry::STATUS_OK, true);
+  } else if (context.generation.artifacts.contains(key)) {
+    method_not_allowed(context);
+  } else {
+    not_found(context);
+  }
+}
+
+// Responds with an error if the output format is not one we know about
+static auto evaluate_output(const RequestContext &context)
+    -> std::optional<sourcemeta::registry::EvaluateType> {
+  const auto output{context.request->getQuery("output")};
+  if (output.empty() || output == "basic") {
+    return sourcemeta::registry::EvaluateType::Standard;
+  } else if (output == "flag") {
+    return sourcemeta::registry::EvaluateType::Flag;
+  }
+
+  json_error(context.request->getMethod(), context.request->getUrl(),
+             context.response, context.encoding,
+             sourcemeta::registry::STATUS_BAD_REQUEST, "invalid-output",
+             "The output parameter must be either basic or flag");
+  return std::nullopt;
+}
+
+static auto on_route_evaluate(const RequestContext &context, const Route &,
+                              std::string_view rest) -> void {
+  const auto mode{evaluate_output(context)};
+  if (mode.has_value()) {
+    on_evaluate(context.generation.base, rest, context.request,
+                context.response, context.encoding, mode.value(), {}, false);
+  }
+}
+
+static auto on_route_evaluate_batch(const RequestContext &context,
+                                    const Route &, std::string_view rest)
+    -> void {
+  const auto mode{evaluate_output(context)};
+  if (mode.has_value()) {
+    on_evaluate_batch(context.generation.base, rest, context.request,
+                      context.response, context.encoding, mode.value());
+  }
+}
+
+static auto on_route_trace(const RequestContext &context, const Route &,
+                           std::string_view rest) -> void {
+  const auto output{context.request->getQuery("output")};
+  if (!output.empty() && output != "json" && output != "jsonl") {
+    json_error(context.request->getMethod(), context.request->getUrl(),
+               context.response, context.encoding,
+               sourcemeta::registry::STATUS_BAD_REQUEST, "invalid-output",
+               "The output parameter must be either json or jsonl");
+    return;
+  }
+
+  const bool lines{output == "jsonl"};
+  sourcemeta::registry::TraceOptions options;
+  options.failures = !context.request->getQuery("failures").empty();
+
+  const auto limit{context.request->getQuery("limit")};
+  if (!limit.empty()) {
+    const auto result{std::from_chars(limit.data(),
+                                      limit.data() + limit.size(),
+                                      options.limit)};
+    if (result.ec != std::errc{} ||
+        result.ptr != limit.data() + limit.size()) {
+      json_error(context.request->getMethod(), context.request->getUrl(),
+                 context.response, context.encoding,
+                 sourcemeta::registry::STATUS_BAD_REQUEST, "invalid-limit",
+                 "The limit parameter must be a non-negative integer");
+      return;
+    }
+  }
+
+  const auto instance_location{context.request->getQuery("instanceLocation")};
+  if (!instance_location.empty()) {
+    try {
+      options.instance_location =
+          sourcemeta::core::to_pointer(std::string{instance_location});
+    } catch (const sourcemeta::core::PointerParseError &) {
+      json_error(context.request->getMethod(), context.request->getUrl(),
+                 context.response, context.encoding,
+                 sourcemeta::registry::STATUS_BAD_REQUEST,
+                 "invalid-instance-location",
+                 "The instanceLocation parameter must be a JSON Pointer");
+      return;
+    }
+  }
+
+  on_evaluate(context.generation.base, rest, context.request, context.response,
+              context.encoding, sourcemeta::registry::EvaluateType::Trace,
+              options, lines);
+}
+
+static auto send_json(const RequestContext &context,
+                      const sourcemeta::core::JSON &document) -> void {
+  context.response->writeStatus(sourcemeta::registry::STATUS_OK);
+  context.response->writeHeader("Access-Control-Allow-Origin", "*");
+  context.response->writeHeader("Content-Type", "application/json");
+  std::ostringstream output;
+  {
+    const auto timer{current_request.timing.scope("serialise")};
+    sourcemeta::core::prettify(document, output);
+  }
+
+  send_response(sourcemeta::registry::STATUS_OK, context.request->getMethod(),
+                context.request->getUrl(), context.response, output.str(),
+                context.encoding, ServerContentEncoding::Identity);
+}
+
+static auto on_route_search(const RequestContext &context, const Route &,
+                            std::string_view) -> void {
+  if (context.request->getMethod() != "get") {
+    method_not_allowed(context);
+    return;
+  }
+
+  const auto query{context.request->getQuery("q")};
+  const auto filter{search_filter(context.request)};
+  if (!filter.has_value()) {
+    json_error(context.request->getMethod(), context.request->getUrl(),
+               context.response, context.encoding,
+               sourcemeta::registry::STATUS_BAD_REQUEST, "invalid-facet",
+               "The health facet must be an integer between 0 and 100, "
+               "and the alert and provenance facets must be booleans");
+  } else if (query.empty() && !filter.value().dialect.has_value() &&
+             !filter.value().health.has_value() &&
+             !filter.value().collection.has_value() &&
+             !filter.value().alert.has_value() &&
+             !filter.value().provenance.has_value()) {
+    json_error(context.request->getMethod(), context.request->getUrl(),
+               context.response, context.encoding,
+               sourcemeta::registry::STATUS_BAD_REQUEST, "missing-query",
+               "You must provide a query parameter to search for");
+  } else {
+    const auto result{[&context, &query, &filter] {
+      const auto timer{current_request.timing.scope("search")};
+      return context.generation.search.search(query, filter.value());
+    }()};
+    if (result.has_value()) {
+      send_json(context, result.value());
+    } else {
+      json_error(context.request->getMethod(), context.request->getUrl(),
+                 context.response, context.encoding,
+                 sourcemeta::registry::STATUS_SERVICE_UNAVAILABLE,
+                 "search-unavailable", "The search index is not available");
+    }
+  }
+}
+
+static auto on_route_complete(const RequestContext &context, const Route &,
+                              std::string_view) -> void {
+  if (context.request->getMethod() != "get") {
+    method_not_allowed(context);
+    return;
+  }
+
+  const auto prefix{context.request->getQuery("prefix")};
+  if (prefix.empty()) {
+    json_error(context.request->getMethod(), context.request->getUrl(),
+               context.response, context.encoding,
+               sourcemeta::registry::STATUS_BAD_REQUEST, "missing-prefix",
+               "You must provide a prefix parameter to complete");
+  } else {
+    const auto result{[&context, &prefix] {
+      const auto timer{current_request.timing.scope("search")};
+      return context.generation.completion.complete(prefix);
+    }()};
+    if (result.has_value()) {
+      send_json(context, result.value());
+    } else {
+      json_error(context.request->getMethod(), context.request->getUrl(),
+                 context.response, context.encoding,
+                 sourcemeta::registry::STATUS_SERVICE_UNAVAILABLE,
+                 "complete-unavailable",
+                 "The completion index is not available");
+    }
+  }
+}
+
+static auto on_route_metrics(const RequestContext &context, const Route &,
+                             std::string_view) -> void {
+  if (context.request->getMethod() != "get" &&
+      context.request->getMethod() != "head") {
+    method_not_allowed(context);
+    return;
+  }
+
+  std::ostringstream output;
+  metrics().expose(output);
+  sourcemeta::registry::expose_metric(
+      output, "sourcemeta_registry_compressions_total", "counter",
+      "The number of responses compressed on the fly",
+      metrics().total(sourcemeta::registry::MetricsCounter::Compressions));
+  sourcemeta::registry::expose_metric(
+      output, "sourcemeta_registry_decompressions_total", "counter",
+      "The number of responses decompressed on the fly",
+      metrics().total(sourcemeta::registry::MetricsCounter::Decompressions));
+  sourcemeta::registry::expose_metric(
+      output, "sourcemeta_registry_response_cache_hits_total", "counter",
+      "The number of static responses served from memory",
+      metrics().total(
+          sourcemeta::registry::MetricsCounter::ResponseCacheHits));
+  sourcemeta::registry::expose_metric(
+      output, "sourcemeta_registry_response_cache_misses_total", "counter",
+      "The number of static responses not found in memory",
+      metrics().total(
+          sourcemeta::registry::MetricsCounter::ResponseCacheMisses));
+  sourcemeta::registry::expose_metric(
+      output, "sourcemeta_registry_response_cache_bytes", "gauge",
+      "The memory used by the response cache", response_cache().usage());
+  sourcemeta::registry::expose_metric(
+      output, "sourcemeta_registry_transcode_cache_bytes", "gauge",
+      "The memory used by the cache of transcoded responses",
+      transcode_cache().usage());
+  sourcemeta::registry::expose_metric(
+      output, "sourcemeta_registry_template_cache_hits_total", "counter",
+      "The number of evaluation templates served from memory",
+      template_cache().hits());
+  sourcemeta::registry::expose_metric(
+      output, "sourcemeta_registry_template_cache_misses_total", "counter",
+      "The number of evaluation templates not found in memory",
+      template_cache().misses());
+  sourcemeta::registry::expose_metric(
+      output, "sourcemeta_registry_evaluate_queue_depth", "gauge",
+      "The number of evaluations waiting for a worker",
+      evaluate_pool().depth());
+  sourcemeta::registry::expose_metric(
+      output, "sourcemeta_registry_log_dropped_total", "counter",
+      "The number of log lines dropped as the buffers were full",
+      logger().dropped());
+
+  context.response->writeStatus(sourcemeta::registry::STATUS_OK);
+  context.response->writeHeader("Content-Type",
+                                "text/plain; version=0.0.4; charset=utf-8");
+  send_response(sourcemeta::registry::STATUS_OK, context.request->getMethod(),
+                context.request->getUrl(), context.response, output.str(),
+                context.encoding, ServerContentEncoding::Identity);
+}
+
+static auto on_route_not_found(const RequestContext &context, const Route &,
+                               std::string_view) -> void {
+  not_found(context);
+}
+
+static auto on_fallback(const RequestContext &context) -> void {
+  const auto url{context.request->getUrl()};
+  current_request.route = sourcemeta::registry::RouteFamily::Schema;
+  if (url.ends_with(".json")) {
+    on_schema(context, url.substr(1, url.size() - 6));
+  } else if (context.request->getMethod() == "get" ||
+             context.request->getMethod() == "head") {
+    if (prefers_html(context.request)) {
+      current_request.route = sourcemeta::registry::RouteFamily::Explorer;
+      std::string buffer;
+      for (const auto *const artifact :
+           {"schema-html.metapack", "directory-html.metapack"}) {
+        const auto key{sourcemeta::registry::ArtifactIndex::key(
+            buffer, "explorer", url.substr(1), artifact)};
+        if (context.generation.artifacts.contains(key)) {
+          serve_artifact(context, key, sourcemeta::registry::STATUS_OK);
+          return;
         }
       }
+
+      serve_artifact(context, "explorer/%/404.metapack",
+                     sourcemeta::registry::STATUS_NOT_FOUND);
     } else {
-      on_schema(base, request->getUrl().substr(1), request, response, encoding);
+      on_schema(context, url.substr(1));
     }
   } else {
-    json_error(request->getMethod(), request->getUrl(), response, encoding,
-               sourcemeta::registry::STATUS_NOT_FOUND, "not-found",
-               "There is nothing at this URL");
+    not_found(context);
   }
 }
 
-static auto dispatch(const std::filesystem::path &base,
+static auto on_route_static(const RequestContext &context, const Route &,
+                            std::string_view rest) -> void {
+  // There are no static files without a web interface
+  if (context.generation.is_headless) {
+    on_fallback(context);
+    return;
+  }
+
+  std::ostringstream absolute_path;
+  absolute_path << SOURCEMETA_REGISTRY_STATIC;
+  absolute_path << '/' << rest;
+  serve_static_file(context.request, context.response, context.encoding,
+                    absolute_path.str(), sourcemeta::registry::STATUS_OK);
+}
+
+// Every route lives under this prefix, so that we can rule out the rest of
+// the URLs, which are the majority, with a single comparison
+constexpr std::string_view ROUTES_PREFIX{"/self/"};
+
+// Evaluated in order, so more specific routes must go first
+constexpr Route ROUTES[]{
+    {.url = "/self/api/list",
+     .is_prefix = false,
+     .handler = on_route_artifact,
+     .family = sourcemeta::registry::RouteFamily::List,
+     .tree = "explorer",
+     .artifact = "directory.metapack"},
+    {.url = "/self/api/list/",
+     .is_prefix = true,
+     .handler = on_route_artifact,
+     .family = sourcemeta::registry::RouteFamily::List,
+     .tree = "explorer",
+     .artifact = "directory.metapack"},
+    {.url = "/self/api/schemas/dependencies/",
+     .is_prefix = true,
+     .handler = on_route_artifact,
+     .family = sourcemeta::registry::RouteFamily::Metadata,
+     .tree = "schemas",
+     .artifact = "dependencies.metapack"},
+    {.url = "/self/api/schemas/health/",
+     .is_prefix = true,
+     .handler = on_route_artifact,
+     .family = sourcemeta::registry::RouteFamily::Metadata,
+     .tree = "schemas",
+     .artifact = "health.metapack"},
+    {.url = "/self/api/schemas/locations/",
+     .is_prefix = true,
+     .handler = on_route_artifact,
+     .family = sourcemeta::registry::RouteFamily::Metadata,
+     .tree = "schemas",
+     .artifact = "locations.metapack"},
+    {.url = "/self/api/schemas/positions/",
+     .is_prefix = true,
+     .handler = on_route_artifact,
+     .family = sourcemeta::registry::RouteFamily::Metadata,
+     .tree = "schemas",
+     .artifact = "positions.metapack"},
+    {.url = "/self/api/schemas/stats/",
+     .is_prefix = true,
+     .handler = on_route_artifact,
+     .family = sourcemeta::registry::RouteFamily::Metadata,
+     .tree = "schemas",
+     .artifact = "stats.metapack"},
+    {.url = "/self/api/schemas/metadata/",
+     .is_prefix = true,
+     .handler = on_route_artifact,
+     .family = sourcemeta::registry::RouteFamily::Metadata,
+     .tree = "explorer",
+     .artifact = "schema.metapack"},
+    {.url = "/self/api/schemas/evaluate/",
+     .is_prefix = true,
+     .handler = on_route_evaluate,
+     .family = sourcemeta::registry::RouteFamily::Evaluate},
+    {.url = "/self/api/schemas/evaluate-batch/",
+     .is_prefix = true,
+     .handler = on_route_evaluate_batch,
+     .family = sourcemeta::registry::RouteFamily::Evaluate},
+    {.url = "/self/api/schemas/trace/",
+     .is_prefix = true,
+     .handler = on_route_trace,
+     .family = sourcemeta::registry::RouteFamily::Trace},
+    {.url = "/self/api/schemas/search",
+     .is_prefix = false,
+     .handler = on_route_search,
+     .family = sourcemeta::registry::RouteFamily::Search},
+    {.url = "/self/api/schemas/complete",
+     .is_prefix = false,
+     .handler = on_route_complete,
+     .family = sourcemeta::registry::RouteFamily::Complete},
+    {.url = "/self/api/metrics",
+     .is_prefix = false,
+     .handler = on_route_metrics,
+     .family = sourcemeta::registry::RouteFamily::Metrics},
+    {.url = "/self/api/",
+     .is_prefix = true,
+     .handler = on_route_not_found,
+     .family = sourcemeta::registry::RouteFamily::Other},
+    {.url = "/self/static/",
+     .is_prefix = true,
+     .handler = on_route_static,
+     .family = sourcemeta::registry::RouteFamily::Static}};
+
+static auto on_request(const RequestContext &context) -> void {
+  const auto url{context.request->getUrl()};
+  if (url == "/") {
+    current_request.route = sourcemeta::registry::RouteFamily::Explorer;
+    if (prefers_html(context.request)) {
+      serve_artifact(context, "explorer/%/directory-html.metapack",
+                     sourcemeta::registry::STATUS_OK);
+    } else if (context.request->getMethod() == "get" ||
+               context.request->getMethod() == "head") {
+      not_found(context);
+    } else {
+      method_not_allowed(context);
+    }
+  } else if (url.starts_with(ROUTES_PREFIX)) {
+    for (const auto &route : ROUTES) {
+      if (route.is_prefix ? url.starts_with(route.url) : url == route.url) {
+        current_request.route = route.family;
+        route.handler(context, route, url.substr(route.url.size()));
+        return;
+      }
+    }
+
+    on_fallback(context);
+  } else {
+    on_fallback(context);
+  }
+}
+
+static auto dispatch(const sourcemeta::registry::Generations &generations,
                      uWS::HttpResponse<true> *const response,
-                     uWS::HttpRequest *const request,
-                     const bool is_headless) noexcept -> void {
+                     uWS::HttpRequest *const request) noexcept -> void {
+  current_request = {.start = std::chrono::steady_clock::now(),
+                     .route = sourcemeta::registry::RouteFamily::Other,
+                     .timing = {server_timing_enabled()},
+                     .generation = generations.current(),
+                     .variants = {},
+                     .variants_size = 0};
   try {
     // As long as the identity;q=0 or *;q=0 directives do not explicitly
     // forbid the identity value that means no encoding, the server must never
@@ -611,29 +1986,74 @@ static auto dispatch(const std::filesystem::path &base,
 
     const auto accept_encoding{request->getHeader("accept-encoding")};
     if (!accept_encoding.empty()) {
-      for (const auto &rule : header_list(accept_encoding)) {
-        if (rule.second == 0.0f &&
+      // Keep the rules sorted by quality value, highest first and otherwise in
+      // the order the client sent them. Anything past a reasonable amount of
+      // rules is ignored rather than allocated for
+      std::array<sourcemeta::registry::HeaderList::Element, 16> elements;
+      std::size_t size{0};
+      sourcemeta::registry::HeaderList list{accept_encoding};
+      while (const auto element{list.next()}) {
+        if (size == elements.size()) {
+          break;
+        }
+
+        std::size_t index{size++};
+        for (; index > 0 && elements[index - 1].quality < element->quality;
+             index--) {
+          elements[index] = elements[index - 1];
+        }
+
+        elements[index] = element.value();
+      }
+
+      const std::span rules{elements.data(), size};
+      // The quality value of the rule that determined the fallback encoding
+      float quality{0.0f};
+      for (const auto &rule : rules) {
+        if (rule.quality == 0.0f &&
             // The client explicitly prohibited the default encoding
-            (rule.first == "*" || rule.first == "identity")) {
+            (rule.value == "*" || rule.value == "identity")) {
           encoding = std::nullopt;
           break;
-        } else if (rule.first == "identity") {
+        } else if (rule.value == "identity") {
+          quality = rule.quality;
           break;
         } else if (
-            rule.first == "*" || rule.first == "gzip" ||
+            rule.value == "*" || rule.value == "gzip" ||
             // For compatibility with previous implementations of HTTP,
             // applications SHOULD consider "x-gzip" [...] to be equivalent to
             // "gzip". See
             // https://www.w3.org/Protocols/rfc2616/rfc2616-sec3.html#sec3.5
-            rule.first == "x-gzip") {
+            rule.value == "x-gzip") {
           encoding = ServerContentEncoding::GZIP;
+          quality = rule.quality;
+          break;
+        }
+      }
+
+      // Precompressed variants are only worth it if the client likes them at
+      // least as much as the fallback encoding, in which case we prefer them
+      // as they are smaller. Rules are already sorted by quality value
+      for (const auto &rule : rules) {
+        if (!encoding.has_value() ||
+            current_request.variants_size == current_request.variants.size() ||
+            rule.quality == 0.0f || rule.quality < quality) {
           break;
+        } else if (rule.value == "br") {
+          current_request.variants[current_request.variants_size++] =
+              ServerContentEncoding::Brotli;
+        } else if (rule.value == "zstd") {
+          current_request.variants[current_request.variants_size++] =
+              ServerContentEncoding::Zstd;
         }
       }
     }
 
     if (encoding.has_value()) {
-      on_request(base, request, response, encoding.value(), is_headless);
+      on_request({.generation = *current_request.generation,
+                  .request = request,
+                  .response = response,
+                  .encoding = encoding.value()});
     } else {
       json_error(request->getMethod(), request->getUrl(), response,
                  ServerContentEncoding::Identity,
@@ -648,6 +2068,193 @@ static auto dispatch(const std::filesystem::path &base,
                sourcemeta::registry::STATUS_METHOD_NOT_ALLOWED,
                "uncaught-error", error.what());
   }
+
+  // Otherwise an idle thread would prevent a previous generation from ever
+  // draining
+  current_request.generation.reset();
+}
+
+static auto warmup_manifest() -> const std::optional<std::filesystem::path> & {
+  static const std::optional<std::filesystem::path> path{
+      []() -> std::optional<std::filesystem::path> {
+        const auto *const value{std::getenv("SOURCEMETA_REGISTRY_WARMUP")};
+        if (value == nullptr || *value == '\0') {
+          return std::nullopt;
+        }
+
+        return std::filesystem::absolute(value);
+      }()};
+  return path;
+}
+
+static auto is_template(const std::filesystem::path &path) -> bool {
+  return path.filename().native().starts_with("blaze-");
+}
+
+// Load the artifacts of the warm-up manifest into the page cache and into our
+// own caches, so that the first requests after a cold start do not pay for it
+static auto warmup(const std::shared_ptr<const sourcemeta::registry::Generation>
+                       generation,
+                   const std::filesystem::path &manifest_path) -> void {
+  const auto start{std::chrono::steady_clock::now()};
+  const auto manifest{
+      sourcemeta::registry::WarmupManifest::read(manifest_path)};
+
+  // (1) Let the kernel read every artifact in the background, as a single
+  // batch, while we work through them in order
+  std::vector<std::filesystem::path> paths;
+  std::uintmax_t bytes{0};
+  for (const auto &entry : manifest.entries()) {
+    // This also guards against entries outside the output directory
+    if (!generation->artifacts.contains(entry)) {
+      continue;
+    }
+
+    auto path{generation->base / entry};
+    const auto mapping{sourcemeta::registry::MappedFile::open(path)};
+    if (mapping) {
+      mapping->prefetch();
+      bytes += mapping->view().size();
+      paths.push_back(std::move(path));
+    }
+  }
+
+  // (2) Fill the response cache with the most important artifacts until it
+  // is full, as going beyond that would evict the ones we just loaded
+  std::size_t responses{0};
+  for (const auto &path : paths) {
+    if (is_template(path)) {
+      continue;
+    }
+
+    auto entry{sourcemeta::registry::CachedResponse::from(path, true)};
+    if (!entry) {
+      continue;
+    } else if (response_cache().usage() + entry->footprint() >
+               response_cache().budget()) {
+      break;
+    }
+
+    response_cache().insert(std::move(entry));
+    responses++;
+  }
+
+  // (3) Deserialise templates starting with the least important ones, as the
+  // template cache evicts the least recently used entries first
+  std::size_t templates{0};
+  for (auto iterator = paths.crbegin(); iterator != paths.crend();
+       ++iterator) {
+    if (!is_template(*iterator)) {
+      continue;
+    }
+
+    try {
+      template_cache().fetch(*iterator);
+      templates++;
+    } catch (const std::exception &error) {
+      log(std::string{"Could not warm up template "} + iterator->string() +
+          ": " + error.what());
+    }
+  }
+
+  log("Warmed up " + std::to_string(paths.size()) + " out of " +
+      std::to_string(manifest.entries().size()) + " artifacts (" +
+      std::to_string(bytes / 1024) + " KB, " + std::to_string(responses) +
+      " cached responses, " + std::to_string(templates) + " templates) in " +
+      std::to_string(std::chrono::duration_cast<std::chrono::milliseconds>(
+                         std::chrono::steady_clock::now() - start)
+                         .count()) +
+      " ms");
+}
+
+// Record the artifacts in our caches as the warm-up manifest for the next
+// start, unless nothing changed since the last time
+static auto record_warmup(const std::filesystem::path &base,
+                          const std::filesystem::path &manifest_path,
+                          sourcemeta::registry::WarmupManifest &last) -> void {
+  sourcemeta::registry::WarmupManifest manifest;
+  for (const auto &path : template_cache().paths()) {
+    manifest.add(base, path);
+  }
+
+  for (const auto &path : response_cache().paths()) {
+    manifest.add(base, path);
+  }
+
+  if (!manifest.empty() && !(manifest == last)) {
+    manifest.write(manifest_path);
+    last = std::move(manifest);
+  }
+}
+
+static std::atomic<bool> reload_requested{false};
+
+auto reload(int) -> void { reload_requested.store(true); }
+
+// Switch to a new generation when asked to, or as soon as the output
+// directory resolves to a different one
+static auto warmup_record_seconds() -> std::size_t {
+  static const std::size_t seconds{
+      environment_number("SOURCEMETA_REGISTRY_WARMUP_RECORD_SECONDS", 0)};
+  return seconds;
+}
+
+static auto watch(sourcemeta::registry::Generations &generations) -> void {
+  constexpr std::chrono::milliseconds TICK{100};
+  constexpr std::size_t TICKS_PER_POLL{10};
+  const auto ticks_per_record{warmup_record_seconds() * TICKS_PER_POLL};
+  sourcemeta::registry::WarmupManifest recorded;
+  // The generations we switched away from that are still in use
+  std::vector<std::weak_ptr<const sourcemeta::registry::Generation>> draining;
+  for (std::size_t tick = 1;; tick++) {
+    std::this_thread::sleep_for(TICK);
+    std::erase_if(draining, [](const auto &generation) {
+      if (generation.expired()) {
+        log("Drained a previous generation");
+        return true;
+      }
+
+      return false;
+    });
+
+    if (ticks_per_record > 0 && tick % ticks_per_record == 0 &&
+        warmup_manifest().has_value()) {
+      try {
+        record_warmup(generations.current()->base, warmup_manifest().value(),
+                      recorded);
+      } catch (const std::exception &error) {
+        log(std::string{"Could not record the warm-up manifest: "} +
+            error.what());
+      }
+    }
+
+    if (!reload_requested.exchange(false) &&
+        (tick % TICKS_PER_POLL != 0 || !generations.changed())) {
+      continue;
+    }
+
+    try {
+      auto next{generations.load()};
+      const auto size{next->artifacts.load()};
+      next->validators.load(next->base, next->artifacts);
+      const auto previous{generations.current()};
+      // Before publishing, so that the new generation starts warm
+      auto [kept, considered] =
+          response_cache().rebase(previous->base, next->base);
+      const auto transcoded{
+          transcode_cache().rebase(previous->base, next->base)};
+      kept += transcoded.first;
+      considered += transcoded.second;
+      const auto base{next->base};
+      draining.push_back(generations.publish(std::move(next)));
+      log("Switched to generation " + base.string() + " with " +
+          std::to_string(size) + " artifacts, keeping " +
+          std::to_string(kept) + " out of " + std::to_string(considered) +
+          " cached responses");
+    } catch (const std::exception &error) {
+      log(std::string{"Could not switch generations: "} + error.what());
+    }
+  }
 }
 
 auto terminate(int signal) -> void {
@@ -670,6 +2277,7 @@ auto main(int argc, char *argv[]) noexcept -> int {
   // Mainly for Docker Compose
   std::signal(SIGINT, terminate);
   std::signal(SIGTERM, terminate);
+  std::signal(SIGHUP, reload);
 
   try {
     if (argc != 3) {
@@ -679,17 +2287,73 @@ auto main(int argc, char *argv[]) noexcept -> int {
     }
 
     const auto port{static_cast<std::uint32_t>(std::stoul(argv[2]))};
-    const auto base{std::filesystem::canonical(argv[1])};
-    const auto is_headless{!std::filesystem::exists(
-        base / "explorer" / SENTINEL / "directory-html.metapack")};
+
+    // Read the configuration upfront, as otherwise invalid values would only
+    // fail once the first request that needs them comes in
+    try {
+      logger();
+      server_timing_enabled();
+      response_cache();
+      transcode_cache();
+      template_cache();
+      evaluate_body_limit();
+      evaluate_pool();
+      warmup_record_seconds();
+    } catch (const std::invalid_argument &error) {
+      std::cerr << "error: " << error.what() << "\n";
+      return EXIT_FAILURE;
+    }
+
+    // Shared across all threads
+    sourcemeta::registry::Generations generations{
+        std::filesystem::absolute(argv[1])};
+    log("Serving generation " + generations.current()->base.string());
+    std::thread{watch, std::ref(generations)}.detach();
+    // In the background, so that it does not delay listening
+    std::thread{[generation = generations.current()] {
+      const auto start{std::chrono::steady_clock::now()};
+      const auto elapsed{[&start] {
+        return std::to_string(
+            std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::steady_clock::now() - start)
+                .count());
+      }};
+
+      try {
+        const auto size{generation->artifacts.load()};
+        log("Indexed " + std::to_string(size) + " artifacts in " + elapsed() +
+            " ms");
+      } catch (const std::exception &error) {
+        log(std::string{"Could not index the artifacts: "} + error.what());
+        return;
+      }
+
+      try {
+        const auto size{generation->validators.load(generation->base,
+                                                     generation->artifacts)};
+        log("Loaded the validators of " + std::to_string(size) +
+            " artifacts in " + elapsed() + " ms");
+      } catch (const std::exception &error) {
+        log(std::string{"Could not load the validators: "} + error.what());
+      }
+    }}.detach();
+    if (warmup_manifest().has_value()) {
+      std::thread{[generation = generations.current()] {
+        try {
+          warmup(generation, warmup_manifest().value());
+        } catch (const std::exception &error) {
+          log(std::string{"Could not warm up: "} + error.what());
+        }
+      }}.detach();
+    }
 
     uWS::LocalCluster(
         {},
-        [&base, port, is_headless, timestamp_start](uWS::SSLApp &app) -> void {
+        [&generations, port, timestamp_start](uWS::SSLApp &app) -> void {
           app.any("/*",
-                  [&base, is_headless](auto *const response,
-                                       auto *const request) noexcept -> void {
-                    dispatch(base, response, request, is_headless);
+                  [&generations](auto *const response,
+                                 auto *const request) noexcept -> void {
+                    dispatch(generations, response, request);
                   });
 
           app.listen(
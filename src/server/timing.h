@@ -0,0 +1,108 @@
+#ifndef SOURCEMETA_REGISTRY_SERVER_TIMING_H
+#define SOURCEMETA_REGISTRY_SERVER_TIMING_H
+
+#include <array>       // std::array
+#include <chrono>      // std::chrono
+#include <cstddef>     // std::size_t
+#include <sstream>     // std::ostringstream
+#include <string>      // std::string
+#include <string_view> // std::string_view
+
+namespace sourcemeta::registry {
+
+/// Accumulates how long each phase of a request took, to report them in a
+/// `Server-Timing` header. When disabled, measuring a phase does not even read
+/// the clock. See https://www.w3.org/TR/server-timing/
+class ServerTiming {
+public:
+  /// Measures a phase from its construction until it goes out of scope
+  class Scope {
+  public:
+    Scope(ServerTiming *const timing, const std::string_view name)
+        : timing_{timing}, name_{name},
+          start_{timing ? std::chrono::steady_clock::now()
+                        : std::chrono::steady_clock::time_point{}} {}
+
+    ~Scope() {
+      if (this->timing_) {
+        this->timing_->add(this->name_,
+                           std::chrono::steady_clock::now() - this->start_);
+      }
+    }
+
+    // Just to prevent mistakes
+    Scope(const Scope &) = delete;
+    Scope &operator=(const Scope &) = delete;
+    Scope(Scope &&) = delete;
+    Scope &operator=(Scope &&) = delete;
+
+  private:
+    ServerTiming *const timing_;
+    const std::string_view name_;
+    const std::chrono::steady_clock::time_point start_;
+  };
+
+  ServerTiming(const bool enabled = false) : enabled_{enabled} {}
+
+  [[nodiscard]] auto enabled() const noexcept -> bool {
+    return this->enabled_;
+  }
+
+  /// The name must be a token that outlives this object, like a literal
+  [[nodiscard]] auto scope(const std::string_view name) -> Scope {
+    return {this->enabled_ ? this : nullptr, name};
+  }
+
+  /// Phases with the same name are added up, and phases beyond the capacity
+  /// are ignored
+  auto add(const std::string_view name,
+           const std::chrono::steady_clock::duration duration) -> void {
+    if (!this->enabled_) {
+      return;
+    }
+
+    for (std::size_t index = 0; index < this->size_; index++) {
+      if (this->phases_[index].name == name) {
+        this->phases_[index].duration += duration;
+        return;
+      }
+    }
+
+    if (this->size_ < this->phases_.size()) {
+      this->phases_[this->size_++] = {.name = name, .duration = duration};
+    }
+  }
+
+  /// Render the header value, in milliseconds, followed by the given total
+  [[nodiscard]] auto header(
+      const std::chrono::steady_clock::duration total) const -> std::string {
+    std::ostringstream result;
+    for (std::size_t index = 0; index < this->size_; index++) {
+      result << this->phases_[index].name
+             << ";dur=" << milliseconds(this->phases_[index].duration)
+             << ", ";
+    }
+
+    result << "total;dur=" << milliseconds(total);
+    return std::move(result).str();
+  }
+
+private:
+  static auto milliseconds(const std::chrono::steady_clock::duration duration)
+      -> double {
+    return std::chrono::duration<double, std::milli>(duration).count();
+  }
+
+  struct Phase {
+    std::string_view name;
+    std::chrono::steady_clock::duration duration;
+  };
+
+  bool enabled_;
+  std::array<Phase, 8> phases_{};
+  std::size_t size_{0};
+};
+
+} // namespace sourcemeta::registry
+
+#endif
@@ -17,10 +17,56 @@
 #endif
 #include <src/App.h>
 #include <src/LocalCluster.h>
+// Only for the layout of the socket and its poll, which uSockets does not
+// expose. This is the uSockets that comes with uWebSockets v20.74.0, as
+// vendored in `vendor/uwebsockets/uSockets`
+extern "C" {
+#include <internal/internal.h>
+}
 #if defined(__clang__)
 #pragma clang diagnostic pop
 #elif defined(__GNUC__)
 #pragma GCC diagnostic pop
 #endif
 
+#include <cstddef>     // offsetof
+#include <type_traits> // std::is_base_of_v, std::is_empty_v
+
+namespace sourcemeta::registry {
+
+// A response must be nothing but the socket, which in turn starts with its
+// poll, for the casts below to hold. If any of these fail after upgrading
+// uWebSockets, then `throttle_reads` must be revisited
+static_assert(
+    std::is_base_of_v<uWS::AsyncSocket<true>, uWS::HttpResponse<true>>);
+static_assert(std::is_empty_v<uWS::HttpResponse<true>>);
+static_assert(offsetof(us_socket_t, p) == 0);
+
+// The poll event bits are not an `int` everywhere
+constexpr int SOCKET_READABLE{LIBUS_SOCKET_READABLE};
+
+/// Stop or resume reading the request of a response, but not writing to it,
+/// unlike the pause and resume of uWebSockets. We cannot just stop consuming
+/// the `onData` chunks instead, as uWebSockets keeps reading and handing them
+/// over regardless. This mirrors what `uWS::AsyncSocket::throttle_helper` does
+/// in uWebSockets v20.74.0 and relies on the same uSockets internals. The
+/// socket might start reading again by itself, for example after a partial
+/// write, so this is only a hint. While throttled, the request never times out
+template <bool SSL>
+inline auto throttle_reads(uWS::HttpResponse<SSL> *const response,
+                           const bool throttle, const unsigned int timeout)
+    -> void {
+  // See the assertions above. Pinned to uWebSockets v20.74.0
+  auto *const socket{reinterpret_cast<us_socket_t *>(response)};
+  auto *const poll{&socket->p};
+  const auto events{us_poll_events(poll)};
+  us_poll_change(poll,
+                 us_socket_context_loop(SSL, us_socket_context(SSL, socket)),
+                 throttle ? events & ~SOCKET_READABLE
+                          : events | SOCKET_READABLE);
+  us_socket_timeout(SSL, socket, throttle ? 0 : timeout);
+}
+
+} // namespace sourcemeta::registry
+
 #endif
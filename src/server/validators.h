@@ -0,0 +1,121 @@
+#ifndef SOURCEMETA_REGISTRY_SERVER_VALIDATORS_H
+#define SOURCEMETA_REGISTRY_SERVER_VALIDATORS_H
+
+#include <sourcemeta/registry/shared.h>
+
+#include "artifacts.h"
+
+#include <atomic>        // std::atomic
+#include <cassert>       // assert
+#include <chrono>        // std::chrono
+#include <cstddef>       // std::size_t
+#include <filesystem>    // std::filesystem
+#include <memory>        // std::shared_ptr, std::make_shared
+#include <string>        // std::string
+#include <system_error>  // std::error_code
+#include <unordered_map> // std::unordered_map
+
+namespace sourcemeta::registry {
+
+/// The `ETag` and `Last-Modified` validators of every artifact of an output
+/// directory, loaded once in the background, so that we can answer
+/// conditional requests without opening any file
+class ValidatorTable {
+public:
+  struct Entry {
+    std::string etag;
+    std::chrono::system_clock::time_point last_modified;
+    std::filesystem::file_time_type modified;
+    // The last time we confirmed the entry matches what is on disk
+    mutable std::atomic<std::chrono::steady_clock::rep> validated{0};
+  };
+
+  ValidatorTable() = default;
+
+  // Just to prevent mistakes
+  ValidatorTable(const ValidatorTable &) = delete;
+  ValidatorTable &operator=(const ValidatorTable &) = delete;
+  ValidatorTable(ValidatorTable &&) = delete;
+  ValidatorTable &operator=(ValidatorTable &&) = delete;
+
+  /// Read the metadata of every artifact, returning how many we loaded.
+  /// Lookups miss until this is done. This is meant to be called only once,
+  /// after loading the artifacts
+  auto load(const std::filesystem::path &base, const ArtifactIndex &artifacts)
+      -> std::size_t {
+    assert(base.is_absolute());
+    const auto entries{artifacts.entries()};
+    assert(entries);
+    auto table{std::make_shared<Table>()};
+    table->reserve(entries->size());
+    const auto now{std::chrono::steady_clock::now().time_since_epoch()};
+    for (const auto &key : *entries) {
+      auto path{base / key};
+      // Reading the modification time first, for the same reasons as when
+      // creating a cached response
+      std::error_code error;
+      const auto modified{std::filesystem::last_write_time(path, error)};
+      if (error) {
+        continue;
+      }
+
+      const auto metadata{read_metadata(path)};
+      if (!metadata.has_value()) {
+        continue;
+      }
+
+      auto &entry{(*table)[std::move(path).native()]};
+      entry.etag = '"' + metadata.value().checksum + '"';
+      entry.last_modified = metadata.value().last_modified;
+      entry.modified = modified;
+      entry.validated.store(now.count(), std::memory_order_relaxed);
+    }
+
+    const auto size{table->size()};
+    this->table_.store(std::move(table), std::memory_order_release);
+    return size;
+  }
+
+  /// The validators of the given file, unless we don't know them or the file
+  /// changed since we loaded them
+  [[nodiscard]] auto find(const std::filesystem::path &path) const
+      -> const Entry * {
+    const auto table{this->table_.load(std::memory_order_acquire)};
+    if (!table) {
+      return nullptr;
+    }
+
+    const auto match{table->find(path.native())};
+    if (match == table->cend()) {
+      return nullptr;
+    }
+
+    // Just like the response cache, we only confirm that the file did not
+    // change every once in a while. Callers must hold on to the generation
+    // that owns this table, which keeps the entry alive
+    const auto &entry{match->second};
+    const auto now{std::chrono::steady_clock::now().time_since_epoch()};
+    const auto validated{std::chrono::steady_clock::duration{
+        entry.validated.load(std::memory_order_relaxed)}};
+    if (now - validated > REVALIDATE_INTERVAL) {
+      std::error_code error;
+      const auto modified{std::filesystem::last_write_time(path, error)};
+      if (error || modified != entry.modified) {
+        return nullptr;
+      }
+
+      entry.validated.store(now.count(), std::memory_order_relaxed);
+    }
+
+    return &entry;
+  }
+
+private:
+  using Table = std::unordered_map<std::string, Entry>;
+  static constexpr std::chrono::seconds REVALIDATE_INTERVAL{1};
+  std::atomic<std::shared_ptr<const Table>> table_;
+};
+
+} // namespace sourcemeta::registry
+
+#endif
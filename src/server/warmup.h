@@ -0,0 +1,97 @@
+#ifndef SOURCEMETA_REGISTRY_SERVER_WARMUP_H
+#define SOURCEMETA_REGISTRY_SERVER_WARMUP_H
+
+#include <filesystem>    // std::filesystem
+#include <fstream>       // std::ifstream, std::ofstream
+#include <stdexcept>     // std::runtime_error
+#include <string>        // std::string, std::getline
+#include <string_view>   // std::string_view
+#include <unordered_set> // std::unordered_set
+#include <vector>        // std::vector
+
+namespace sourcemeta::registry {
+
+/// The artifacts to load on startup, most important first, as paths relative
+/// to the output directory, one per line. Empty lines and lines starting with
+/// `#` are ignored
+class WarmupManifest {
+public:
+  static auto read(const std::filesystem::path &path) -> WarmupManifest {
+    std::ifstream stream{path};
+    if (!stream) {
+      throw std::runtime_error("Could not read the warm-up manifest: " +
+                               path.string());
+    }
+
+    WarmupManifest result;
+    std::string line;
+    while (std::getline(stream, line)) {
+      if (!line.empty() && line.back() == '\r') {
+        line.pop_back();
+      }
+
+      if (!line.empty() && !line.starts_with('#')) {
+        result.add(line);
+      }
+    }
+
+    return result;
+  }
+
+  /// Duplicates are ignored, so the first occurrence determines the order
+  auto add(const std::string_view entry) -> void {
+    if (this->seen_.emplace(entry).second) {
+      this->entries_.emplace_back(entry);
+    }
+  }
+
+  /// Add a path if it is inside the given directory
+  auto add(const std::filesystem::path &base, const std::string_view path)
+      -> void {
+    const auto &prefix{base.native()};
+    if (path.size() > prefix.size() && path.starts_with(prefix) &&
+        path[prefix.size()] == std::filesystem::path::preferred_separator) {
+      this->add(path.substr(prefix.size() + 1));
+    }
+  }
+
+  [[nodiscard]] auto entries() const noexcept
+      -> const std::vector<std::string> & {
+    return this->entries_;
+  }
+
+  [[nodiscard]] auto empty() const noexcept -> bool {
+    return this->entries_.empty();
+  }
+
+  auto operator==(const WarmupManifest &other) const -> bool {
+    return this->entries_ == other.entries_;
+  }
+
+  /// Replace the manifest at once, so that a concurrent reader never sees a
+  /// partial one
+  auto write(const std::filesystem::path &path) const -> void {
+    const std::filesystem::path temporary{path.string() + ".tmp"};
+    {
+      std::ofstream stream{temporary};
+      if (!stream) {
+        throw std::runtime_error("Could not write the warm-up manifest: " +
+                                 path.string());
+      }
+
+      for (const auto &entry : this->entries_) {
+        stream << entry << '\n';
+      }
+    }
+
+    std::filesystem::rename(temporary, path);
+  }
+
+private:
+  std::vector<std::string> entries_;
+  std::unordered_set<std::string> seen_;
+};
+
+} // namespace sourcemeta::registry
+
+#endif
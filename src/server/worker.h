@@ -0,0 +1,133 @@
+#ifndef SOURCEMETA_REGISTRY_SERVER_WORKER_H
+#define SOURCEMETA_REGISTRY_SERVER_WORKER_H
+
+#include <pthread.h>
+
+#include <algorithm>          // std::max
+#include <atomic>             // std::atomic
+#include <chrono>             // std::chrono
+#include <condition_variable> // std::condition_variable
+#include <cstddef>            // std::size_t
+#include <deque>              // std::deque
+#include <functional>         // std::function
+#include <mutex>              // std::mutex, std::lock_guard, std::unique_lock
+#include <stdexcept>          // std::runtime_error
+#include <utility>            // std::move
+#include <vector>             // std::vector
+
+namespace sourcemeta::registry {
+
+/// A fixed-size pool of threads for running expensive work, like schema
+/// evaluation, without blocking the event loops. Every job is told how long it
+/// waited in the queue, and how many jobs were ahead of it
+class WorkerPool {
+public:
+  using Job = std::function<void(std::chrono::steady_clock::duration wait,
+                                 std::size_t depth)>;
+
+  WorkerPool(const std::size_t size, const std::size_t stack_size_bytes) {
+    const auto effective_size{std::max(size, static_cast<std::size_t>(1))};
+    this->threads_.reserve(effective_size);
+    for (std::size_t index = 0; index < effective_size; index++) {
+      // We can't use std::thread, as it doesn't let us tweak the thread stack
+      // size
+      pthread_attr_t attributes;
+      pthread_attr_init(&attributes);
+      if (stack_size_bytes > 0) {
+        pthread_attr_setstacksize(&attributes, stack_size_bytes);
+      }
+
+      pthread_t handle;
+      const auto code{pthread_create(
+          &handle, &attributes,
+          [](void *argument) -> void * {
+            static_cast<WorkerPool *>(argument)->work();
+            return nullptr;
+          },
+          this)};
+      pthread_attr_destroy(&attributes);
+      if (code != 0) {
+        this->stop();
+        throw std::runtime_error("Could not create worker thread");
+      }
+
+      this->threads_.push_back(handle);
+    }
+  }
+
+  ~WorkerPool() { this->stop(); }
+
+  // Just to prevent mistakes
+  WorkerPool(const WorkerPool &) = delete;
+  WorkerPool &operator=(const WorkerPool &) = delete;
+  WorkerPool(WorkerPool &&) = delete;
+  WorkerPool &operator=(WorkerPool &&) = delete;
+
+  auto submit(Job &&job) -> void {
+    {
+      std::lock_guard<std::mutex> lock{this->mutex_};
+      this->queue_.push_back({.job = std::move(job),
+                              .queued = std::chrono::steady_clock::now(),
+                              .depth = this->queue_.size()});
+      this->depth_.store(this->queue_.size(), std::memory_order_relaxed);
+    }
+
+    this->condition_.notify_one();
+  }
+
+  /// The number of jobs waiting for a thread
+  [[nodiscard]] auto depth() const noexcept -> std::size_t {
+    return this->depth_.load(std::memory_order_relaxed);
+  }
+
+private:
+  struct Entry {
+    Job job;
+    std::chrono::steady_clock::time_point queued;
+    std::size_t depth;
+  };
+
+  auto work() -> void {
+    while (true) {
+      std::unique_lock<std::mutex> lock{this->mutex_};
+      this->condition_.wait(
+          lock, [this] { return this->stopping_ || !this->queue_.empty(); });
+      if (this->stopping_) {
+        return;
+      }
+
+      auto entry{std::move(this->queue_.front())};
+      this->queue_.pop_front();
+      this->depth_.store(this->queue_.size(), std::memory_order_relaxed);
+      lock.unlock();
+
+      // Jobs are expected to deal with their own errors
+      entry.job(std::chrono::steady_clock::now() - entry.queued, entry.depth);
+    }
+  }
+
+  auto stop() -> void {
+    {
+      std::lock_guard<std::mutex> lock{this->mutex_};
+      this->stopping_ = true;
+    }
+
+    this->condition_.notify_all();
+    for (const auto handle : this->threads_) {
+      pthread_join(handle, nullptr);
+    }
+
+    this->threads_.clear();
+  }
+
+  std::vector<pthread_t> threads_;
+  std::mutex mutex_;
+  std::condition_variable condition_;
+  std::deque<Entry> queue_;
+  std::atomic<std::size_t> depth_{0};
+  bool stopping_{false};
+};
+
+} // namespace sourcemeta::registry
+
+#endif
@@ -6,6 +6,7 @@
 
 #include <sourcemeta/registry/shared_encoding.h>
 #include <sourcemeta/registry/shared_metapack.h>
+#include <sourcemeta/registry/shared_search.h>
 #include <sourcemeta/registry/shared_version.h>
 
 #endif
@@ -1,9 +1,38 @@
 #ifndef SOURCEMETA_REGISTRY_SHARED_ENCODING_H_
 #define SOURCEMETA_REGISTRY_SHARED_ENCODING_H_
 
+#include <cstddef> // std::size_t
+
 namespace sourcemeta::registry {
 
-enum class Encoding { Identity, GZIP };
+// Brotli and Zstandard are only ever used for precompressed variants, while
+// DEFLATE with our own preset dictionary is only ever used for storage, as
+// clients cannot decode it
+enum class Encoding { Identity, GZIP, Brotli, Zstd, DeflateDictionary };
+
+/// How much time to spend compressing an artifact when writing it, given
+/// that we only pay for it once, but might serve the artifact many times
+enum class CompressionLevel {
+  // Store the artifact as it is
+  None,
+  // The fastest GZIP level and no precompressed variants, for artifacts that
+  // are mostly read by ourselves
+  Fast,
+  // The default GZIP level, along with precompressed variants
+  Default,
+  // The highest level of every encoder, for frequently served artifacts
+  Best,
+  // DEFLATE with a preset dictionary of common JSON Schema vocabulary and no
+  // precompressed variants, as clients always get them transcoded. Only for
+  // payloads under 1 KiB, as larger ones get the default compression instead
+  Dictionary
+};
+
+struct Compression {
+  CompressionLevel level{CompressionLevel::Default};
+  // Payloads smaller than this are stored as they are
+  std::size_t threshold{0};
+};
 
 } // namespace sourcemeta::registry
 
@@ -6,14 +6,25 @@
 #include <sourcemeta/registry/shared_encoding.h>
 
 #include <chrono>     // std::chrono
+#include <cstddef>    // std::size_t
 #include <cstdint>    // std::uint64_t
 #include <filesystem> // std::filesystem
 #include <fstream>    // std::ifstream
 #include <optional>   // std::optional
+#include <ostream>    // std::ostream
 #include <vector>     // std::vector
 
 namespace sourcemeta::registry {
 
+/// A copy of the payload precompressed in another encoding, stored in the
+/// same file, that can be sent to clients as-is
+struct FileVariant {
+  Encoding encoding;
+  // From the start of the file
+  std::uint64_t offset;
+  std::size_t stored_bytes;
+};
+
 template <typename T> struct File {
   T data;
   std::uint64_t version;
@@ -22,13 +33,25 @@ template <typename T> struct File {
   sourcemeta::core::JSON::String mime;
   std::size_t bytes;
   std::chrono::milliseconds duration;
+  // The time it took to compress the payload and its variants, if any. The
+  // compression ratio follows from the sizes of the payload
+  std::chrono::microseconds compression_duration;
   Encoding encoding;
   sourcemeta::core::JSON extension;
+  std::vector<FileVariant> variants;
 };
 
 auto read_stream_raw(const std::filesystem::path &path)
     -> std::optional<File<std::ifstream>>;
 
+/// Read the metadata of a file without reading its payload. The data consists
+/// of the size of the payload as stored on disk
+auto read_metadata(const std::filesystem::path &path)
+    -> std::optional<File<std::size_t>>;
+
+/// Write the payload of a file as it was before we compressed it for storage
+auto read_payload(File<std::ifstream> &file, std::ostream &output) -> void;
+
 auto read_json(const std::filesystem::path &path,
                const sourcemeta::core::JSON::ParseCallback &callback = nullptr)
     -> sourcemeta::core::JSON;
@@ -43,35 +66,48 @@ auto write_json(const std::filesystem::path &destination,
                 const sourcemeta::core::JSON::String &mime,
                 const Encoding encoding,
                 const sourcemeta::core::JSON &extension,
-                const std::chrono::milliseconds duration) -> void;
+                const std::chrono::milliseconds duration,
+                const Compression &compression = {}) -> void;
 
 auto write_pretty_json(const std::filesystem::path &destination,
                        const sourcemeta::core::JSON &document,
                        const sourcemeta::core::JSON::String &mime,
                        const Encoding encoding,
                        const sourcemeta::core::JSON &extension,
-                       const std::chrono::milliseconds duration) -> void;
+                       const std::chrono::milliseconds duration,
+                       const Compression &compression = {}) -> void;
 
 auto write_text(const std::filesystem::path &destination,
                 const std::string_view contents,
                 const sourcemeta::core::JSON::String &mime,
                 const Encoding encoding,
                 const sourcemeta::core::JSON &extension,
-                const std::chrono::milliseconds duration) -> void;
+                const std::chrono::milliseconds duration,
+                const Compression &compression = {}) -> void;
+
+auto write_binary(const std::filesystem::path &destination,
+                  const std::string_view contents,
+                  const sourcemeta::core::JSON::String &mime,
+                  const Encoding encoding,
+                  const sourcemeta::core::JSON &extension,
+                  const std::chrono::milliseconds duration,
+                  const Compression &compression = {}) -> void;
 
 auto write_file(const std::filesystem::path &destination,
                 const std::filesystem::path &source,
                 const sourcemeta::core::JSON::String &mime,
                 const Encoding encoding,
                 const sourcemeta::core::JSON &extension,
-                const std::chrono::milliseconds duration) -> void;
+                const std::chrono::milliseconds duration,
+                const Compression &compression = {}) -> void;
 
 auto write_jsonl(const std::filesystem::path &destination,
                  const std::vector<sourcemeta::core::JSON> &entries,
                  const sourcemeta::core::JSON::String &mime,
                  const Encoding encoding,
                  const sourcemeta::core::JSON &extension,
-                 const std::chrono::milliseconds duration) -> void;
+                 const std::chrono::milliseconds duration,
+                 const Compression &compression = {}) -> void;
 
 } // namespace sourcemeta::registry
 
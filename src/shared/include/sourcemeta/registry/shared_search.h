@@ -0,0 +1,128 @@
+#ifndef SOURCEMETA_REGISTRY_SHARED_SEARCH_H
+#define SOURCEMETA_REGISTRY_SHARED_SEARCH_H
+
+#include <cstddef>     // std::size_t
+#include <cstdint>     // std::uint32_t, std::uint8_t
+#include <optional>    // std::optional
+#include <string>      // std::string
+#include <string_view> // std::string_view
+#include <vector>      // std::vector
+
+namespace sourcemeta::registry {
+
+struct SearchEntry {
+  std::string path;
+  std::string title;
+  std::string description;
+  // Facets
+  std::string dialect{};
+  std::uint8_t health{0};
+  bool alert{false};
+  bool provenance{false};
+};
+
+/// Serialise a set of entries into a compact trigram index, along with
+/// bitmaps for every facet value, that can be queried in place, for example
+/// out of a memory mapping. The order of the entries is used to break ties
+/// between equally relevant results
+auto make_search_index(const std::vector<SearchEntry> &entries) -> std::string;
+
+/// Restricts the results to the entries that match every set facet
+struct SearchFilter {
+  /// The exact base dialect URI
+  std::optional<std::string_view> dialect{};
+  /// The minimum health score
+  std::optional<std::uint8_t> health{};
+  /// A directory that contains the entry, like `/foo/bar`
+  std::optional<std::string_view> collection{};
+  std::optional<bool> alert{};
+  std::optional<bool> provenance{};
+};
+
+/// A read-only view over a serialised search index. The underlying data must
+/// outlive this view
+class SearchIndex {
+public:
+  struct Match {
+    std::string_view path;
+    std::string_view title;
+    std::string_view description;
+  };
+
+  /// Throws `std::runtime_error` if the data is not a valid search index
+  SearchIndex(std::string_view data);
+
+  /// Case-insensitively search the path, title, and description of every
+  /// entry, returning the most relevant matches first. An empty query matches
+  /// every entry in the preferred order
+  [[nodiscard]] auto search(std::string_view query, const std::size_t limit,
+                            const SearchFilter &filter = {}) const
+      -> std::vector<Match>;
+
+  [[nodiscard]] auto size() const noexcept -> std::size_t;
+
+private:
+  [[nodiscard]] auto read(const std::size_t offset) const -> std::uint32_t;
+  [[nodiscard]] auto field(const std::uint32_t entry,
+                           const std::size_t index) const -> std::string_view;
+  [[nodiscard]] auto score(const std::uint32_t entry,
+                           const std::string_view query) const -> std::size_t;
+  [[nodiscard]] auto facets_offset() const noexcept -> std::size_t;
+  [[nodiscard]] auto strings_offset() const noexcept -> std::size_t;
+  auto facet(const std::uint32_t kind, const std::string_view value,
+             std::vector<std::uint32_t> &bitmap) const -> void;
+  [[nodiscard]] auto filter(const SearchFilter &filter) const
+      -> std::optional<std::vector<std::uint32_t>>;
+
+  std::string_view data_;
+  std::uint32_t entries_;
+  std::uint32_t trigrams_;
+  std::uint32_t postings_;
+  std::uint32_t facets_;
+  std::uint32_t facets_data_;
+};
+
+/// Serialise a set of entries into a compact radix trie over the path
+/// segments and title words of every entry, where every node holds its best
+/// completions in advance. Earlier entries rank higher
+auto make_completion_index(const std::vector<SearchEntry> &entries)
+    -> std::string;
+
+/// A read-only view over a serialised completion index. The underlying data
+/// must outlive this view
+class CompletionIndex {
+public:
+  using Match = SearchIndex::Match;
+
+  /// The maximum number of completions stored for every prefix
+  static constexpr std::size_t MAXIMUM_COMPLETIONS{10};
+
+  /// Throws `std::runtime_error` if the data is not a valid completion index
+  CompletionIndex(std::string_view data);
+
+  /// Case-insensitively complete the start of any path segment or title word
+  [[nodiscard]] auto complete(std::string_view prefix,
+                              const std::size_t limit) const
+      -> std::vector<Match>;
+
+  [[nodiscard]] auto size() const noexcept -> std::size_t;
+
+private:
+  [[nodiscard]] auto read(const std::size_t offset) const -> std::uint32_t;
+  [[nodiscard]] auto node(const std::uint32_t index,
+                          const std::size_t word) const -> std::uint32_t;
+  [[nodiscard]] auto label(const std::uint32_t index) const
+      -> std::string_view;
+  [[nodiscard]] auto field(const std::uint32_t entry,
+                           const std::size_t index) const -> std::string_view;
+
+  std::string_view data_;
+  std::uint32_t entries_;
+  std::uint32_t nodes_;
+  std::uint32_t rankings_;
+  std::uint32_t labels_;
+};
+
+} // namespace sourcemeta::registry
+
+#endif
@@ -1,3 +1,4 @@
+#include <sourcemeta/registry/compress.h>
 #include <sourcemeta/registry/gzip.h>
 #include <sourcemeta/registry/shared_metapack.h>
 
@@ -5,67 +6,413 @@
 #include <sourcemeta/core/md5.h>
 #include <sourcemeta/core/time.h>
 
-#include <cassert>    // assert
-#include <chrono>     // std::chrono::system_clock::time_point
-#include <functional> // std::functional
-#include <ostream>    // std::ostream
-#include <sstream>    // std::ostringstream
-#include <utility>    // std::move
+#include <fcntl.h>  // open, O_RDONLY
+#include <unistd.h> // pread, close
+
+#include <algorithm>   // std::copy_n, std::find, std::min
+#include <array>       // std::array
+#include <bit>         // std::endian
+#include <cassert>     // assert
+#include <chrono>      // std::chrono
+#include <cstdint>     // std::uint8_t, std::uint32_t, std::uint64_t
+#include <cstring>     // std::memcpy
+#include <functional>  // std::functional
+#include <istream>     // std::istream
+#include <limits>      // std::numeric_limits
+#include <ostream>     // std::ostream
+#include <sstream>     // std::ostringstream
+#include <string>      // std::string
+#include <string_view> // std::string_view
+#include <utility>     // std::move, std::pair
+#include <vector>      // std::vector, std::erase_if
 
 // TODO: There are lots of opportunities to optimise this file
 // and avoid temporary buffers, etc
 
 namespace {
 
+// Version 2 metapack files start with a fixed-size binary header, so that
+// their metadata can be read with a single system call and without any
+// parsing. The header is followed by the JSON extension, if any, and then by
+// the payload. Version 3 files might also carry precompressed variants of the
+// payload, described by a table right after the extension and stored right
+// before the payload, so that the payload is always at the end of the file.
+// Version 1 files started with a JSON object instead
+struct MetapackHeader {
+  std::array<char, 4> magic;
+  std::uint32_t version;
+  std::uint64_t bytes;
+  std::uint64_t stored_bytes;
+  std::uint64_t duration;
+  std::uint64_t extension_bytes;
+  // As hexadecimal MD5 digests are always 32 characters long
+  std::array<char, 32> checksum;
+  // As HTTP dates are always 29 characters long, followed by padding
+  std::array<char, 32> last_modified;
+  // Null-terminated, unless the MIME type takes the entire buffer
+  std::array<char, 64> mime;
+  std::uint8_t encoding;
+  // Always zero before version 3
+  std::uint8_t variants;
+  // The preset dictionary the payload was deflated with, if any. Zero
+  // otherwise, as files written before we had dictionaries have padding here
+  std::uint16_t dictionary;
+  // In microseconds. Zero if unknown, as files written before we recorded it
+  // have padding here
+  std::uint32_t compression_duration;
+};
+
+struct MetapackVariant {
+  std::uint8_t encoding;
+  std::array<std::uint8_t, 7> padding;
+  std::uint64_t stored_bytes;
+};
+
+static_assert(sizeof(MetapackHeader) == 176);
+static_assert(sizeof(MetapackVariant) == 16);
+// We write the header as-is, and we only ever deploy on little-endian machines
+static_assert(std::endian::native == std::endian::little);
+
+constexpr std::array<char, 4> METAPACK_MAGIC{{'\x89', 'M', 'P', 'K'}};
+constexpr std::uint32_t METAPACK_VERSION{3};
+// Files without variants are still written as version 2, which older readers
+// understand
+constexpr std::uint32_t METAPACK_VERSION_WITHOUT_VARIANTS{2};
+constexpr std::uint8_t METAPACK_ENCODING_IDENTITY{0};
+constexpr std::uint8_t METAPACK_ENCODING_GZIP{1};
+constexpr std::uint8_t METAPACK_ENCODING_BROTLI{2};
+constexpr std::uint8_t METAPACK_ENCODING_ZSTD{3};
+constexpr std::uint8_t METAPACK_ENCODING_DEFLATE_DICTIONARY{4};
+
+// Changing the contents of a dictionary would break every file written with
+// it, so a different dictionary must always get a new identifier
+constexpr std::uint16_t METAPACK_DICTIONARY_JSON_SCHEMA{1};
+
+// Zlib gets the most out of the end of the dictionary, so the most common
+// strings go last. This is hand-picked from the artifacts we generate, rather
+// than trained, and only the first 32 KiB of a dictionary are ever used
+constexpr std::string_view METAPACK_DICTIONARY_JSON_SCHEMA_CONTENTS{
+    R"JSON("http://json-schema.org/draft-04/schema#",)JSON"
+    R"JSON("http://json-schema.org/draft-06/schema#",)JSON"
+    R"JSON("http://json-schema.org/draft-07/schema#",)JSON"
+    R"JSON("https://json-schema.org/draft/2019-09/schema",)JSON"
+    R"JSON("https://json-schema.org/draft/2019-09/vocab/core",)JSON"
+    R"JSON("https://json-schema.org/draft/2020-12/vocab/core",)JSON"
+    R"JSON("https://json-schema.org/draft/2020-12/vocab/applicator",)JSON"
+    R"JSON("https://json-schema.org/draft/2020-12/vocab/unevaluated",)JSON"
+    R"JSON("https://json-schema.org/draft/2020-12/vocab/validation",)JSON"
+    R"JSON("https://json-schema.org/draft/2020-12/vocab/meta-data",)JSON"
+    R"JSON("https://json-schema.org/draft/2020-12/vocab/format-annotation",)JSON"
+    R"JSON("https://json-schema.org/draft/2020-12/vocab/content",)JSON"
+    R"JSON({ "definitions": { "$defs": { "$ref": "#/$defs/", "$comment": )JSON"
+    R"JSON("allOf": [ "anyOf": [ "oneOf": [ "not": { "if": { "then": { )JSON"
+    R"JSON("else": { "items": { "prefixItems": [ "contains": { )JSON"
+    R"JSON("additionalProperties": false, "patternProperties": { )JSON"
+    R"JSON("propertyNames": { "dependentRequired": { "enum": [ "const": )JSON"
+    R"JSON("minimum": 0, "maximum": "minLength": 1, "maxLength": )JSON"
+    R"JSON("minItems": 1, "maxItems": "uniqueItems": true, "pattern": "^)JSON"
+    R"JSON("format": "uri", "format": "date-time", "default": )JSON"
+    R"JSON("examples": [ )JSON"
+    R"JSON("title": "description": "required": [ )JSON"
+    R"JSON("type": "object", "type": "array", "type": "integer", )JSON"
+    R"JSON("type": "number", "type": "boolean", "type": "null", )JSON"
+    R"JSON("type": "string", "properties": { "$id": "$schema": )JSON"
+    R"JSON("static": { "dynamic": { "type": "resource", "type": "anchor", )JSON"
+    R"JSON("type": "subschema", "type": "pointer", "parent": null, )JSON"
+    R"JSON("relativePointer": "/properties/", "pointer": "/properties/", )JSON"
+    R"JSON("root": "base": "position": [ "parent": "/properties/", )JSON"
+    R"JSON("dialect": "https://json-schema.org/draft/2020-12/schema", )JSON"
+    R"JSON("baseDialect": "https://json-schema.org/draft/2020-12/schema")JSON"};
+
+// Precompressing tiny payloads is not worth the space
+constexpr std::size_t METAPACK_VARIANT_THRESHOLD{1024};
+
+// The encoder levels of the compression policies that are not the defaults
+constexpr int GZIP_FAST{1};
+constexpr int GZIP_BEST{9};
+constexpr int BROTLI_BEST{11};
+constexpr int ZSTD_BEST{22};
+constexpr int DEFLATE_DICTIONARY_LEVEL{9};
+
+auto is_header(const MetapackHeader &header) -> bool {
+  return header.magic == METAPACK_MAGIC &&
+         (header.version == METAPACK_VERSION ||
+          (header.version == METAPACK_VERSION_WITHOUT_VARIANTS &&
+           header.variants == 0)) &&
+         (header.encoding == METAPACK_ENCODING_IDENTITY ||
+          header.encoding == METAPACK_ENCODING_GZIP ||
+          // We cannot read payloads deflated with dictionaries we don't know
+          (header.encoding == METAPACK_ENCODING_DEFLATE_DICTIONARY &&
+           header.dictionary == METAPACK_DICTIONARY_JSON_SCHEMA));
+}
+
+auto to_encoding(const std::uint8_t encoding)
+    -> sourcemeta::registry::Encoding {
+  switch (encoding) {
+    case METAPACK_ENCODING_GZIP:
+      return sourcemeta::registry::Encoding::GZIP;
+    case METAPACK_ENCODING_BROTLI:
+      return sourcemeta::registry::Encoding::Brotli;
+    case METAPACK_ENCODING_ZSTD:
+      return sourcemeta::registry::Encoding::Zstd;
+    case METAPACK_ENCODING_DEFLATE_DICTIONARY:
+      return sourcemeta::registry::Encoding::DeflateDictionary;
+    default:
+      return sourcemeta::registry::Encoding::Identity;
+  }
+}
+
+// The variant table must be read in full, right after the extension
+auto from_variant_table(const MetapackHeader &header, const char *const table)
+    -> std::vector<sourcemeta::registry::FileVariant> {
+  std::vector<sourcemeta::registry::FileVariant> result;
+  result.reserve(header.variants);
+  std::uint64_t offset{sizeof(MetapackHeader) + header.extension_bytes +
+                       header.variants * sizeof(MetapackVariant)};
+  for (std::size_t index = 0; index < header.variants; index++) {
+    MetapackVariant variant{};
+    std::memcpy(&variant, table + index * sizeof(MetapackVariant),
+                sizeof(MetapackVariant));
+    result.push_back({.encoding = to_encoding(variant.encoding),
+                      .offset = offset,
+                      .stored_bytes =
+                          static_cast<std::size_t>(variant.stored_bytes)});
+    offset += variant.stored_bytes;
+  }
+
+  return result;
+}
+
+template <typename T>
+auto from_header(T &&data, const MetapackHeader &header,
+                 sourcemeta::core::JSON &&extension,
+                 std::vector<sourcemeta::registry::FileVariant> &&variants)
+    -> sourcemeta::registry::File<T> {
+  const auto mime_end{
+      std::find(header.mime.cbegin(), header.mime.cend(), '\0')};
+  const auto last_modified_end{std::find(header.last_modified.cbegin(),
+                                         header.last_modified.cend(), '\0')};
+  return {.data = std::forward<T>(data),
+          .version = header.version,
+          .checksum = {header.checksum.data(), header.checksum.size()},
+          .last_modified = sourcemeta::core::from_gmt(
+              std::string{header.last_modified.cbegin(), last_modified_end}),
+          .mime = {header.mime.cbegin(), mime_end},
+          .bytes = static_cast<std::size_t>(header.bytes),
+          .duration = std::chrono::milliseconds{header.duration},
+          .compression_duration =
+              std::chrono::microseconds{header.compression_duration},
+          .encoding = to_encoding(header.encoding),
+          .extension = std::move(extension),
+          .variants = std::move(variants)};
+}
+
+auto parse_legacy_metadata(std::istream &stream) -> sourcemeta::core::JSON {
+  auto metadata{sourcemeta::core::parse_json(stream)};
+  assert(metadata.is_object());
+  assert(metadata.defines("version"));
+  assert(metadata.defines("checksum"));
+  assert(metadata.defines("lastModified"));
+  assert(metadata.defines("mime"));
+  assert(metadata.defines("bytes"));
+  assert(metadata.defines("duration"));
+  assert(metadata.defines("encoding"));
+  assert(metadata.at("version").is_integer());
+  assert(metadata.at("version").is_positive());
+  assert(metadata.at("checksum").is_string());
+  assert(metadata.at("lastModified").is_string());
+  assert(metadata.at("mime").is_string());
+  assert(metadata.at("bytes").is_integer());
+  assert(metadata.at("bytes").is_positive());
+  assert(metadata.at("duration").is_integer());
+  assert(metadata.at("duration").is_positive());
+  assert(metadata.at("encoding").is_string());
+  return metadata;
+}
+
+template <typename T>
+auto from_legacy_metadata(T &&data, sourcemeta::core::JSON &&metadata)
+    -> sourcemeta::registry::File<T> {
+  sourcemeta::registry::Encoding encoding{
+      sourcemeta::registry::Encoding::Identity};
+  if (metadata.at("encoding").to_string() == "gzip") {
+    encoding = sourcemeta::registry::Encoding::GZIP;
+  } else if (metadata.at("encoding").to_string() != "identity") {
+    assert(false);
+  }
+
+  return {.data = std::forward<T>(data),
+          .version =
+              static_cast<std::uint64_t>(metadata.at("version").to_integer()),
+          .checksum = metadata.at("checksum").to_string(),
+          .last_modified = sourcemeta::core::from_gmt(
+              metadata.at("lastModified").to_string()),
+          .mime = metadata.at("mime").to_string(),
+          .bytes = static_cast<std::size_t>(metadata.at("bytes").to_integer()),
+          .duration = static_cast<std::chrono::milliseconds>(
+              metadata.at("duration").to_integer()),
+          .compression_duration = std::chrono::microseconds{0},
+          .encoding = encoding,
+          .extension = std::move(metadata).at_or(
+              "extension", sourcemeta::core::JSON{nullptr}),
+          // Version 1 files never had variants
+          .variants = {}};
+}
+
 auto write_stream(const std::filesystem::path &path,
                   const sourcemeta::core::JSON::String &mime,
                   const sourcemeta::registry::Encoding encoding,
                   const sourcemeta::core::JSON &extension,
                   const std::chrono::milliseconds duration,
+                  const sourcemeta::registry::Compression &compression,
                   const std::function<void(std::ostream &)> &callback) -> void {
   // TODO: Ideally we wouldn't write the file all at once first
   std::stringstream buffer;
   callback(buffer);
+  auto payload{std::move(buffer).str()};
+
+  MetapackHeader header{};
+  header.magic = METAPACK_MAGIC;
+  header.bytes = payload.size();
+  header.duration = static_cast<std::uint64_t>(duration.count());
 
-  auto metadata{sourcemeta::core::JSON::make_object()};
-  metadata.assign("version", sourcemeta::core::JSON{1});
   std::ostringstream md5;
   // TODO: Have a shorthand version that doesn't require an intermediary stream
-  sourcemeta::core::md5(buffer.str(), md5);
-  metadata.assign("checksum", sourcemeta::core::JSON{md5.str()});
-  metadata.assign("lastModified",
-                  sourcemeta::core::JSON{sourcemeta::core::to_gmt(
-                      std::chrono::system_clock::now())});
-  metadata.assign("mime", sourcemeta::core::JSON{mime});
-  metadata.assign("bytes", sourcemeta::core::JSON{buffer.tellp()});
-  metadata.assign("duration", sourcemeta::core::JSON{duration.count()});
+  sourcemeta::core::md5(payload, md5);
+  const auto checksum{md5.str()};
+  assert(checksum.size() == header.checksum.size());
+  std::copy_n(checksum.data(), header.checksum.size(), header.checksum.data());
 
-  switch (encoding) {
+  const auto last_modified{
+      sourcemeta::core::to_gmt(std::chrono::system_clock::now())};
+  assert(last_modified.size() < header.last_modified.size());
+  std::copy_n(last_modified.data(), last_modified.size(),
+              header.last_modified.data());
+
+  assert(mime.size() <= header.mime.size());
+  std::copy_n(mime.data(), std::min(mime.size(), header.mime.size()),
+              header.mime.data());
+
+  // The policy only ever relaxes the requested encoding. Clients cannot
+  // decode the dictionary, so we only use it for payloads small enough that
+  // transcoding them is cheap, and that we would not precompress anyway
+  const auto level{
+      payload.size() < compression.threshold
+          ? sourcemeta::registry::CompressionLevel::None
+      : compression.level ==
+                  sourcemeta::registry::CompressionLevel::Dictionary &&
+              payload.size() >= METAPACK_VARIANT_THRESHOLD
+          ? sourcemeta::registry::CompressionLevel::Default
+          : compression.level};
+  const auto effective_encoding{
+      level == sourcemeta::registry::CompressionLevel::None
+          ? sourcemeta::registry::Encoding::Identity
+          : encoding};
+
+  const auto compression_start{std::chrono::steady_clock::now()};
+
+  // Only payloads that we would compress anyway are worth precompressing
+  // with the other encoders we have, as long as they do better than GZIP
+  std::vector<std::pair<std::uint8_t, std::string>> variants;
+  if (effective_encoding == sourcemeta::registry::Encoding::GZIP &&
+      level != sourcemeta::registry::CompressionLevel::Fast &&
+      level != sourcemeta::registry::CompressionLevel::Dictionary &&
+      payload.size() >= METAPACK_VARIANT_THRESHOLD) {
+    const auto best{level == sourcemeta::registry::CompressionLevel::Best};
+    auto brotli{best ? sourcemeta::registry::brotli(payload, BROTLI_BEST)
+                     : sourcemeta::registry::brotli(payload)};
+    if (brotli.has_value()) {
+      variants.emplace_back(METAPACK_ENCODING_BROTLI,
+                            std::move(brotli).value());
+    }
+
+    auto zstd{best ? sourcemeta::registry::zstd(payload, ZSTD_BEST)
+                   : sourcemeta::registry::zstd(payload)};
+    if (zstd.has_value()) {
+      variants.emplace_back(METAPACK_ENCODING_ZSTD, std::move(zstd).value());
+    }
+  }
+
+  switch (effective_encoding) {
     case sourcemeta::registry::Encoding::Identity:
-      metadata.assign("encoding", sourcemeta::core::JSON{"identity"});
+      header.encoding = METAPACK_ENCODING_IDENTITY;
       break;
     case sourcemeta::registry::Encoding::GZIP:
-      metadata.assign("encoding", sourcemeta::core::JSON{"gzip"});
+      header.encoding = METAPACK_ENCODING_GZIP;
+      switch (level) {
+        case sourcemeta::registry::CompressionLevel::Dictionary:
+          header.encoding = METAPACK_ENCODING_DEFLATE_DICTIONARY;
+          header.dictionary = METAPACK_DICTIONARY_JSON_SCHEMA;
+          payload = sourcemeta::registry::deflate_with_dictionary(
+              payload, METAPACK_DICTIONARY_JSON_SCHEMA_CONTENTS,
+              DEFLATE_DICTIONARY_LEVEL);
+          break;
+        case sourcemeta::registry::CompressionLevel::Fast:
+          payload = sourcemeta::registry::gzip(payload, GZIP_FAST);
+          break;
+        case sourcemeta::registry::CompressionLevel::Best:
+          payload = sourcemeta::registry::gzip(payload, GZIP_BEST);
+          break;
+        default:
+          payload = sourcemeta::registry::gzip(payload);
+          break;
+      }
+
       break;
     default:
       assert(false);
       break;
   }
 
+  // The ratio is already recorded by the payload sizes
+  const auto compression_duration{
+      std::chrono::duration_cast<std::chrono::microseconds>(
+          std::chrono::steady_clock::now() - compression_start)};
+  header.compression_duration =
+      static_cast<std::uint32_t>(std::min<std::chrono::microseconds::rep>(
+          compression_duration.count(),
+          std::numeric_limits<std::uint32_t>::max()));
+
+  header.stored_bytes = payload.size();
+  std::erase_if(variants, [&payload](const auto &variant) {
+    return variant.second.size() >= payload.size();
+  });
+
+  header.version = variants.empty() ? METAPACK_VERSION_WITHOUT_VARIANTS
+                                    : METAPACK_VERSION;
+  header.variants = static_cast<std::uint8_t>(variants.size());
+
+  std::string extension_json;
   if (!extension.is_null()) {
-    metadata.assign("extension", extension);
+    std::ostringstream extension_stream;
+    sourcemeta::core::stringify(extension, extension_stream);
+    extension_json = std::move(extension_stream).str();
   }
 
-  std::ofstream output{path};
+  header.extension_bytes = extension_json.size();
+
+  // Never modify files in place, as readers like the server might have them
+  // memory mapped. Instead, atomically replace them
+  auto temporary{path};
+  temporary += ".tmp";
+  std::ofstream output{temporary, std::ios::binary};
   assert(!output.fail());
-  sourcemeta::core::stringify(metadata, output);
-  if (encoding == sourcemeta::registry::Encoding::GZIP) {
-    sourcemeta::registry::gzip(buffer, output);
-  } else {
-    output << buffer.str();
+  output.write(reinterpret_cast<const char *>(&header), sizeof(header));
+  output << extension_json;
+  for (const auto &variant : variants) {
+    MetapackVariant entry{};
+    entry.encoding = variant.first;
+    entry.stored_bytes = variant.second.size();
+    output.write(reinterpret_cast<const char *>(&entry), sizeof(entry));
+  }
+
+  for (const auto &variant : variants) {
+    output << variant.second;
   }
 
-  output.flush();
+  output << payload;
+  output.close();
+  std::filesystem::rename(temporary, path);
 }
 
 } // namespace
@@ -80,47 +427,120 @@ auto read_stream_raw(const std::filesystem::path &path)
   }
 
   auto stream{sourcemeta::core::read_file(path)};
-  auto metadata{sourcemeta::core::parse_json(stream)};
-  assert(metadata.is_object());
-  assert(metadata.defines("version"));
-  assert(metadata.defines("checksum"));
-  assert(metadata.defines("lastModified"));
-  assert(metadata.defines("mime"));
-  assert(metadata.defines("bytes"));
-  assert(metadata.defines("duration"));
-  assert(metadata.defines("encoding"));
-  assert(metadata.at("version").is_integer());
-  assert(metadata.at("version").is_positive());
-  assert(metadata.at("checksum").is_string());
-  assert(metadata.at("lastModified").is_string());
-  assert(metadata.at("mime").is_string());
-  assert(metadata.at("bytes").is_integer());
-  assert(metadata.at("bytes").is_positive());
-  assert(metadata.at("duration").is_integer());
-  assert(metadata.at("duration").is_positive());
-  assert(metadata.at("encoding").is_string());
+  MetapackHeader header{};
+  stream.read(reinterpret_cast<char *>(&header), sizeof(header));
+  if (stream.gcount() == sizeof(header) && is_header(header)) {
+    auto extension{sourcemeta::core::JSON{nullptr}};
+    if (header.extension_bytes > 0) {
+      std::string extension_json(header.extension_bytes, '\0');
+      stream.read(extension_json.data(),
+                  static_cast<std::streamsize>(extension_json.size()));
+      extension = sourcemeta::core::parse_json(extension_json);
+    }
 
-  Encoding encoding{Encoding::Identity};
-  if (metadata.at("encoding").to_string() == "gzip") {
-    encoding = Encoding::GZIP;
-  } else if (metadata.at("encoding").to_string() != "identity") {
-    assert(false);
+    std::vector<sourcemeta::registry::FileVariant> variants;
+    if (header.variants > 0) {
+      std::string table(header.variants * sizeof(MetapackVariant), '\0');
+      stream.read(table.data(), static_cast<std::streamsize>(table.size()));
+      variants = from_variant_table(header, table.data());
+      // Skip over the variants, right to the payload
+      const auto &last{variants.back()};
+      stream.seekg(
+          static_cast<std::streamoff>(last.offset + last.stored_bytes));
+    }
+
+    return from_header(std::move(stream), header, std::move(extension),
+                       std::move(variants));
   }
 
-  return File{
-      .data = std::move(stream),
-      .version =
-          static_cast<std::uint64_t>(metadata.at("version").to_integer()),
-      .checksum = metadata.at("checksum").to_string(),
-      .last_modified =
-          sourcemeta::core::from_gmt(metadata.at("lastModified").to_string()),
-      .mime = metadata.at("mime").to_string(),
-      .bytes = static_cast<std::size_t>(metadata.at("bytes").to_integer()),
-      .duration = static_cast<std::chrono::milliseconds>(
-          metadata.at("duration").to_integer()),
-      .encoding = encoding,
-      .extension = std::move(metadata).at_or("extension",
-                                             sourcemeta::core::JSON{nullptr})};
+  // Fallback to version 1 files
+  stream.clear();
+  stream.seekg(0);
+  auto metadata{parse_legacy_metadata(stream)};
+  return from_legacy_metadata(std::move(stream), std::move(metadata));
+}
+
+auto read_metadata(const std::filesystem::path &path)
+    -> std::optional<File<std::size_t>> {
+  assert(path.is_absolute());
+  const auto descriptor{open(path.c_str(), O_RDONLY)};
+  if (descriptor == -1) {
+    return std::nullopt;
+  }
+
+  // Large enough for the header and for most extensions
+  std::array<char, 4096> buffer;
+  const auto count{pread(descriptor, buffer.data(), buffer.size(), 0)};
+  MetapackHeader header{};
+  if (count >= static_cast<ssize_t>(sizeof(header))) {
+    std::memcpy(&header, buffer.data(), sizeof(header));
+  }
+
+  if (!is_header(header)) {
+    close(descriptor);
+    // Fallback to version 1 files
+    if (count <= 0) {
+      return std::nullopt;
+    }
+
+    auto stream{sourcemeta::core::read_file(path)};
+    auto metadata{parse_legacy_metadata(stream)};
+    const auto offset{static_cast<std::size_t>(stream.tellg())};
+    return from_legacy_metadata(
+        static_cast<std::size_t>(std::filesystem::file_size(path)) - offset,
+        std::move(metadata));
+  }
+
+  auto extension{sourcemeta::core::JSON{nullptr}};
+  if (header.extension_bytes > 0) {
+    std::string extension_json(header.extension_bytes, '\0');
+    const auto available{static_cast<std::size_t>(count) - sizeof(header)};
+    if (extension_json.size() <= available) {
+      std::copy_n(buffer.data() + sizeof(header), extension_json.size(),
+                  extension_json.data());
+    } else if (pread(descriptor, extension_json.data(), extension_json.size(),
+                     sizeof(header)) !=
+               static_cast<ssize_t>(extension_json.size())) {
+      close(descriptor);
+      return std::nullopt;
+    }
+
+    extension = sourcemeta::core::parse_json(extension_json);
+  }
+
+  std::vector<sourcemeta::registry::FileVariant> variants;
+  if (header.variants > 0) {
+    const auto table_offset{sizeof(header) + header.extension_bytes};
+    std::string table(header.variants * sizeof(MetapackVariant), '\0');
+    if (table_offset + table.size() <= static_cast<std::size_t>(count)) {
+      std::copy_n(buffer.data() + table_offset, table.size(), table.data());
+    } else if (pread(descriptor, table.data(), table.size(),
+                     static_cast<off_t>(table_offset)) !=
+               static_cast<ssize_t>(table.size())) {
+      close(descriptor);
+      return std::nullopt;
+    }
+
+    variants = from_variant_table(header, table.data());
+  }
+
+  close(descriptor);
+  return from_header(static_cast<std::size_t>(header.stored_bytes), header,
+                     std::move(extension), std::move(variants));
+}
+
+auto read_payload(File<std::ifstream> &file, std::ostream &output) -> void {
+  if (file.encoding == Encoding::GZIP) {
+    gunzip(file.data, output);
+  } else if (file.encoding == Encoding::DeflateDictionary) {
+    std::ostringstream buffer;
+    buffer << file.data.rdbuf();
+    output << inflate_with_dictionary(buffer.view(),
+                                      METAPACK_DICTIONARY_JSON_SCHEMA_CONTENTS);
+  } else {
+    assert(file.encoding == Encoding::Identity);
+    output << file.data.rdbuf();
+  }
 }
 
 auto read_json(const std::filesystem::path &path,
@@ -136,11 +556,7 @@ auto read_json_with_metadata(
   auto file{read_stream_raw(path)};
   assert(file.has_value());
   std::ostringstream buffer;
-  if (file.value().encoding == Encoding::GZIP) {
-    sourcemeta::registry::gunzip(file.value().data, buffer);
-  } else {
-    buffer << file.value().data.rdbuf();
-  }
+  read_payload(file.value(), buffer);
 
   return File{.data = sourcemeta::core::parse_json(buffer.str(), callback),
               .version = file.value().version,
@@ -149,8 +565,10 @@ auto read_json_with_metadata(
               .mime = std::move(file.value().mime),
               .bytes = file.value().bytes,
               .duration = file.value().duration,
+              .compression_duration = file.value().compression_duration,
               .encoding = file.value().encoding,
-              .extension = file.value().extension};
+              .extension = file.value().extension,
+              .variants = file.value().variants};
 }
 
 auto write_json(const std::filesystem::path &destination,
@@ -158,8 +576,9 @@ auto write_json(const std::filesystem::path &destination,
                 const sourcemeta::core::JSON::String &mime,
                 const Encoding encoding,
                 const sourcemeta::core::JSON &extension,
-                const std::chrono::milliseconds duration) -> void {
-  write_stream(destination, mime, encoding, extension, duration,
+                const std::chrono::milliseconds duration,
+                const Compression &compression) -> void {
+  write_stream(destination, mime, encoding, extension, duration, compression,
                [&document](auto &stream) {
                  sourcemeta::core::stringify(document, stream);
                });
@@ -170,8 +589,9 @@ auto write_pretty_json(const std::filesystem::path &destination,
                        const sourcemeta::core::JSON::String &mime,
                        const Encoding encoding,
                        const sourcemeta::core::JSON &extension,
-                       const std::chrono::milliseconds duration) -> void {
-  write_stream(destination, mime, encoding, extension, duration,
+                       const std::chrono::milliseconds duration,
+                       const Compression &compression) -> void {
+  write_stream(destination, mime, encoding, extension, duration, compression,
                [&document](auto &stream) {
                  sourcemeta::core::prettify(document, stream);
                });
@@ -182,22 +602,35 @@ auto write_text(const std::filesystem::path &destination,
                 const sourcemeta::core::JSON::String &mime,
                 const Encoding encoding,
                 const sourcemeta::core::JSON &extension,
-                const std::chrono::milliseconds duration) -> void {
-  write_stream(destination, mime, encoding, extension, duration,
+                const std::chrono::milliseconds duration,
+                const Compression &compression) -> void {
+  write_stream(destination, mime, encoding, extension, duration, compression,
                [&contents](auto &stream) {
                  stream << contents;
                  stream << "\n";
                });
 }
 
+auto write_binary(const std::filesystem::path &destination,
+                  const std::string_view contents,
+                  const sourcemeta::core::JSON::String &mime,
+                  const Encoding encoding,
+                  const sourcemeta::core::JSON &extension,
+                  const std::chrono::milliseconds duration,
+                  const Compression &compression) -> void {
+  write_stream(destination, mime, encoding, extension, duration, compression,
+               [&contents](auto &stream) { stream << contents; });
+}
+
 auto write_file(const std::filesystem::path &destination,
                 const std::filesystem::path &source,
                 const sourcemeta::core::JSON::String &mime,
                 const Encoding encoding,
                 const sourcemeta::core::JSON &extension,
-                const std::chrono::milliseconds duration) -> void {
+                const std::chrono::milliseconds duration,
+                const Compression &compression) -> void {
   auto stream{sourcemeta::core::read_file(source)};
-  write_stream(destination, mime, encoding, extension, duration,
+  write_stream(destination, mime, encoding, extension, duration, compression,
                [&stream](auto &target) { target << stream.rdbuf(); });
 }
 
@@ -206,8 +639,9 @@ auto write_jsonl(const std::filesystem::path &destination,
                  const sourcemeta::core::JSON::String &mime,
                  const Encoding encoding,
                  const sourcemeta::core::JSON &extension,
-                 const std::chrono::milliseconds duration) -> void {
-  write_stream(destination, mime, encoding, extension, duration,
+                 const std::chrono::milliseconds duration,
+                 const Compression &compression) -> void {
+  write_stream(destination, mime, encoding, extension, duration, compression,
                [&entries](auto &stream) {
                  for (const auto &entry : entries) {
                    sourcemeta::core::stringify(entry, stream);
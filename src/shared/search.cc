@@ -0,0 +1,907 @@
+#include <sourcemeta/registry/shared_search.h>
+
+#include <algorithm> // std::search, std::sort, std::partial_sort, std::min,
+                     // std::unique, std::fill
+#include <cassert>   // assert
+#include <cctype>    // std::tolower, std::isalnum
+#include <cstddef>   // std::ptrdiff_t
+#include <cstring>   // std::memcpy
+#include <map>       // std::map
+#include <optional>  // std::optional, std::nullopt
+#include <stdexcept> // std::runtime_error
+#include <string>    // std::to_string
+#include <utility>   // std::pair, std::move
+
+// The layout consists of little-endian 32-bit integers, as follows:
+//
+// - Header: magic, version, number of entries, number of trigrams, number of
+//   postings, number of facets, and size of the facets data section
+// - Entries: offset and length of the path, title, and description of each
+//   entry within the strings section
+// - Trigrams: the trigram, and the offset and length of its postings within
+//   the postings section, sorted by trigram
+// - Postings: sorted entry identifiers
+// - Facets: the kind of facet, the offset and length of its value within the
+//   strings section, the type of container, and the offset and length of the
+//   container within the facets data section, sorted by kind and value
+// - Facets data: containers, either as sorted entry identifiers or as a
+//   bitmap over every entry, whichever is smaller
+// - Strings
+
+namespace {
+
+constexpr std::uint32_t SEARCH_MAGIC{0x48435253}; // "SRCH"
+constexpr std::uint32_t SEARCH_VERSION{3};
+constexpr std::size_t HEADER_WORDS{7};
+constexpr std::size_t ENTRY_WORDS{6};
+constexpr std::size_t TRIGRAM_WORDS{3};
+constexpr std::size_t FACET_WORDS{6};
+constexpr std::size_t WORD{sizeof(std::uint32_t)};
+constexpr std::size_t WORD_BITS{WORD * 8};
+
+enum class FacetKind : std::uint32_t {
+  Dialect = 0,
+  Health = 1,
+  Collection = 2,
+  Alert = 3,
+  Provenance = 4
+};
+
+enum class FacetContainer : std::uint32_t { Array = 0, Bitmap = 1 };
+
+// Health scores go from 0 to 100
+constexpr std::uint32_t HEALTH_MAXIMUM{100};
+
+auto lowercase(const char character) -> char {
+  return static_cast<char>(
+      std::tolower(static_cast<unsigned char>(character)));
+}
+
+auto to_lowercase(const std::string_view input) -> std::string {
+  std::string result;
+  result.reserve(input.size());
+  for (const auto character : input) {
+    result.push_back(lowercase(character));
+  }
+
+  return result;
+}
+
+// The input is expected to be lowercased already
+auto trigram(const std::string_view input, const std::size_t index)
+    -> std::uint32_t {
+  return (static_cast<std::uint32_t>(static_cast<unsigned char>(input[index]))
+          << 16) |
+         (static_cast<std::uint32_t>(
+              static_cast<unsigned char>(input[index + 1]))
+          << 8) |
+         static_cast<std::uint32_t>(
+             static_cast<unsigned char>(input[index + 2]));
+}
+
+// The needle is expected to be lowercased already
+auto contains(const std::string_view haystack, const std::string_view needle)
+    -> bool {
+  return std::search(haystack.cbegin(), haystack.cend(), needle.cbegin(),
+                     needle.cend(), [](const auto left, const auto right) {
+                       return lowercase(left) == right;
+                     }) != haystack.cend();
+}
+
+auto equals(const std::string_view left, const std::string_view right)
+    -> bool {
+  return left.size() == right.size() && contains(left, right);
+}
+
+auto append(std::string &output, const std::uint32_t value) -> void {
+  char buffer[WORD];
+  std::memcpy(buffer, &value, WORD);
+  output.append(buffer, WORD);
+}
+
+auto health_value(const std::uint32_t health) -> std::string {
+  assert(health <= HEALTH_MAXIMUM);
+  return std::to_string(health);
+}
+
+auto has_bit(const std::vector<std::uint32_t> &bitmap,
+             const std::uint32_t entry) -> bool {
+  return (bitmap[entry / WORD_BITS] >> (entry % WORD_BITS)) & 1;
+}
+
+} // namespace
+
+namespace sourcemeta::registry {
+
+auto make_search_index(const std::vector<SearchEntry> &entries)
+    -> std::string {
+  std::string strings;
+  std::vector<std::uint32_t> locations;
+  locations.reserve(entries.size() * ENTRY_WORDS);
+  std::map<std::uint32_t, std::vector<std::uint32_t>> index;
+  std::map<std::pair<FacetKind, std::string>, std::vector<std::uint32_t>>
+      facets;
+  for (std::uint32_t identifier = 0; identifier < entries.size();
+       identifier++) {
+    const auto &entry{entries[identifier]};
+    for (const auto *const value :
+         {&entry.path, &entry.title, &entry.description}) {
+      locations.push_back(static_cast<std::uint32_t>(strings.size()));
+      locations.push_back(static_cast<std::uint32_t>(value->size()));
+      strings.append(*value);
+      const auto lowercased{to_lowercase(*value)};
+      for (std::size_t cursor = 0; cursor + 3 <= lowercased.size();
+           cursor++) {
+        auto &postings{index[trigram(lowercased, cursor)]};
+        // Identifiers only ever grow, so this is enough to avoid duplicates
+        if (postings.empty() || postings.back() != identifier) {
+          postings.push_back(identifier);
+        }
+      }
+    }
+
+    if (!entry.dialect.empty()) {
+      facets[{FacetKind::Dialect, entry.dialect}].push_back(identifier);
+    }
+
+    facets[{FacetKind::Health, health_value(entry.health)}].push_back(
+        identifier);
+
+    // Every directory that contains the entry, except the root
+    for (auto slash = entry.path.find('/', 1); slash != std::string::npos;
+         slash = entry.path.find('/', slash + 1)) {
+      facets[{FacetKind::Collection, entry.path.substr(0, slash)}].push_back(
+          identifier);
+    }
+
+    if (entry.alert) {
+      facets[{FacetKind::Alert, ""}].push_back(identifier);
+    }
+
+    if (entry.provenance) {
+      facets[{FacetKind::Provenance, ""}].push_back(identifier);
+    }
+  }
+
+  std::size_t postings_count{0};
+  for (const auto &pair : index) {
+    postings_count += pair.second.size();
+  }
+
+  // Like roaring bitmaps, store sparse sets as arrays and dense ones as
+  // bitmaps
+  const auto bitmap_words{(entries.size() + WORD_BITS - 1) / WORD_BITS};
+  std::vector<std::uint32_t> facets_table;
+  std::vector<std::uint32_t> facets_data;
+  for (const auto &pair : facets) {
+    facets_table.push_back(static_cast<std::uint32_t>(pair.first.first));
+    facets_table.push_back(static_cast<std::uint32_t>(strings.size()));
+    facets_table.push_back(
+        static_cast<std::uint32_t>(pair.first.second.size()));
+    strings.append(pair.first.second);
+    facets_table.push_back(
+        static_cast<std::uint32_t>(pair.second.size() < bitmap_words
+                                       ? FacetContainer::Array
+                                       : FacetContainer::Bitmap));
+    facets_table.push_back(static_cast<std::uint32_t>(facets_data.size()));
+    if (pair.second.size() < bitmap_words) {
+      facets_table.push_back(static_cast<std::uint32_t>(pair.second.size()));
+      facets_data.insert(facets_data.end(), pair.second.cbegin(),
+                         pair.second.cend());
+    } else {
+      facets_table.push_back(static_cast<std::uint32_t>(bitmap_words));
+      const auto offset{facets_data.size()};
+      facets_data.resize(offset + bitmap_words, 0);
+      for (const auto identifier : pair.second) {
+        const auto bit{1u << (identifier % WORD_BITS)};
+        facets_data[offset + identifier / WORD_BITS] |= bit;
+      }
+    }
+  }
+
+  std::string result;
+  result.reserve((HEADER_WORDS + locations.size() +
+                  index.size() * TRIGRAM_WORDS + postings_count +
+                  facets_table.size() + facets_data.size()) *
+                     WORD +
+                 strings.size());
+  append(result, SEARCH_MAGIC);
+  append(result, SEARCH_VERSION);
+  append(result, static_cast<std::uint32_t>(entries.size()));
+  append(result, static_cast<std::uint32_t>(index.size()));
+  append(result, static_cast<std::uint32_t>(postings_count));
+  append(result, static_cast<std::uint32_t>(facets.size()));
+  append(result, static_cast<std::uint32_t>(facets_data.size()));
+  for (const auto location : locations) {
+    append(result, location);
+  }
+
+  std::uint32_t postings_offset{0};
+  for (const auto &pair : index) {
+    append(result, pair.first);
+    append(result, postings_offset);
+    append(result, static_cast<std::uint32_t>(pair.second.size()));
+    postings_offset += static_cast<std::uint32_t>(pair.second.size());
+  }
+
+  for (const auto &pair : index) {
+    for (const auto identifier : pair.second) {
+      append(result, identifier);
+    }
+  }
+
+  for (const auto word : facets_table) {
+    append(result, word);
+  }
+
+  for (const auto word : facets_data) {
+    append(result, word);
+  }
+
+  result.append(strings);
+  return result;
+}
+
+SearchIndex::SearchIndex(const std::string_view data) : data_{data} {
+  if (this->data_.size() < HEADER_WORDS * WORD ||
+      this->read(0) != SEARCH_MAGIC || this->read(WORD) != SEARCH_VERSION) {
+    throw std::runtime_error("Invalid search index");
+  }
+
+  this->entries_ = this->read(2 * WORD);
+  this->trigrams_ = this->read(3 * WORD);
+  this->postings_ = this->read(4 * WORD);
+  this->facets_ = this->read(5 * WORD);
+  this->facets_data_ = this->read(6 * WORD);
+  if (this->data_.size() < this->strings_offset()) {
+    throw std::runtime_error("Invalid search index");
+  }
+}
+
+auto SearchIndex::size() const noexcept -> std::size_t {
+  return this->entries_;
+}
+
+auto SearchIndex::read(const std::size_t offset) const -> std::uint32_t {
+  assert(offset + WORD <= this->data_.size());
+  std::uint32_t result;
+  std::memcpy(&result, this->data_.data() + offset, WORD);
+  return result;
+}
+
+auto SearchIndex::facets_offset() const noexcept -> std::size_t {
+  return (HEADER_WORDS + this->entries_ * ENTRY_WORDS +
+          this->trigrams_ * TRIGRAM_WORDS + this->postings_) *
+         WORD;
+}
+
+auto SearchIndex::strings_offset() const noexcept -> std::size_t {
+  return this->facets_offset() +
+         (this->facets_ * FACET_WORDS + this->facets_data_) * WORD;
+}
+
+auto SearchIndex::field(const std::uint32_t entry,
+                        const std::size_t index) const -> std::string_view {
+  assert(entry < this->entries_);
+  assert(index < ENTRY_WORDS / 2);
+  const auto location{(HEADER_WORDS + entry * ENTRY_WORDS + index * 2) *
+                      WORD};
+  return this->data_.substr(this->strings_offset() + this->read(location),
+                            this->read(location + WORD));
+}
+
+auto SearchIndex::score(const std::uint32_t entry,
+                        const std::string_view query) const -> std::size_t {
+  const auto path{this->field(entry, 0)};
+  const auto title{this->field(entry, 1)};
+  const auto description{this->field(entry, 2)};
+  std::size_t result{0};
+  if (equals(title, query)) {
+    result += 8;
+  } else if (contains(title, query)) {
+    result += 4;
+  }
+
+  if (contains(path, query)) {
+    result += 2;
+  }
+
+  if (contains(description, query)) {
+    result += 1;
+  }
+
+  return result;
+}
+
+// Merge the given facet value, if any, into the bitmap
+auto SearchIndex::facet(const std::uint32_t kind, const std::string_view value,
+                        std::vector<std::uint32_t> &bitmap) const -> void {
+  const auto table{this->facets_offset()};
+  std::uint32_t low{0};
+  std::uint32_t high{this->facets_};
+  while (low < high) {
+    const auto middle{low + (high - low) / 2};
+    const auto location{table + middle * FACET_WORDS * WORD};
+    const auto middle_kind{this->read(location)};
+    if (middle_kind < kind ||
+        (middle_kind == kind &&
+         this->data_.substr(this->strings_offset() +
+                                this->read(location + WORD),
+                            this->read(location + 2 * WORD)) < value)) {
+      low = middle + 1;
+    } else {
+      high = middle;
+    }
+  }
+
+  const auto location{table + low * FACET_WORDS * WORD};
+  if (low == this->facets_ || this->read(location) != kind ||
+      this->data_.substr(this->strings_offset() + this->read(location + WORD),
+                         this->read(location + 2 * WORD)) != value) {
+    return;
+  }
+
+  const auto data{table + this->facets_ * FACET_WORDS * WORD +
+                  this->read(location + 4 * WORD) * WORD};
+  const auto count{this->read(location + 5 * WORD)};
+  if (this->read(location + 3 * WORD) ==
+      static_cast<std::uint32_t>(FacetContainer::Bitmap)) {
+    assert(count == bitmap.size());
+    for (std::uint32_t index = 0; index < count; index++) {
+      bitmap[index] |= this->read(data + index * WORD);
+    }
+  } else {
+    for (std::uint32_t index = 0; index < count; index++) {
+      const auto entry{this->read(data + index * WORD)};
+      bitmap[entry / WORD_BITS] |= 1u << (entry % WORD_BITS);
+    }
+  }
+}
+
+auto SearchIndex::filter(const SearchFilter &filter) const
+    -> std::optional<std::vector<std::uint32_t>> {
+  if (!filter.dialect.has_value() && !filter.health.has_value() &&
+      !filter.collection.has_value() && !filter.alert.has_value() &&
+      !filter.provenance.has_value()) {
+    return std::nullopt;
+  }
+
+  const auto words{(this->entries_ + WORD_BITS - 1) / WORD_BITS};
+  std::vector<std::uint32_t> result(words, ~0u);
+  const auto intersect{[&result, words](
+                           const std::vector<std::uint32_t> &bitmap,
+                           const bool negate) {
+    for (std::size_t index = 0; index < words; index++) {
+      result[index] &= negate ? ~bitmap[index] : bitmap[index];
+    }
+  }};
+
+  std::vector<std::uint32_t> bitmap(words);
+  if (filter.dialect.has_value()) {
+    this->facet(static_cast<std::uint32_t>(FacetKind::Dialect),
+                filter.dialect.value(), bitmap);
+    intersect(bitmap, false);
+  }
+
+  if (filter.health.has_value()) {
+    std::fill(bitmap.begin(), bitmap.end(), 0);
+    // Every health score has its own facet value, so a minimum is the union
+    // of the ones at or above it
+    for (auto health = std::min<std::uint32_t>(filter.health.value(),
+                                               HEALTH_MAXIMUM);
+         health <= HEALTH_MAXIMUM; health++) {
+      this->facet(static_cast<std::uint32_t>(FacetKind::Health),
+                  health_value(health), bitmap);
+    }
+
+    intersect(bitmap, false);
+  }
+
+  if (filter.collection.has_value()) {
+    std::fill(bitmap.begin(), bitmap.end(), 0);
+    auto collection{filter.collection.value()};
+    while (collection.ends_with('/')) {
+      collection.remove_suffix(1);
+    }
+
+    this->facet(static_cast<std::uint32_t>(FacetKind::Collection), collection,
+                bitmap);
+    intersect(bitmap, false);
+  }
+
+  if (filter.alert.has_value()) {
+    std::fill(bitmap.begin(), bitmap.end(), 0);
+    this->facet(static_cast<std::uint32_t>(FacetKind::Alert), "", bitmap);
+    intersect(bitmap, !filter.alert.value());
+  }
+
+  if (filter.provenance.has_value()) {
+    std::fill(bitmap.begin(), bitmap.end(), 0);
+    this->facet(static_cast<std::uint32_t>(FacetKind::Provenance), "",
+                bitmap);
+    intersect(bitmap, !filter.provenance.value());
+  }
+
+  return result;
+}
+
+auto SearchIndex::search(const std::string_view query, const std::size_t limit,
+                         const SearchFilter &filter) const
+    -> std::vector<Match> {
+  const auto needle{to_lowercase(query)};
+  const auto mask{this->filter(filter)};
+  const auto matches{[&mask](const std::uint32_t entry) {
+    return !mask.has_value() || has_bit(mask.value(), entry);
+  }};
+
+  std::vector<std::pair<std::size_t, std::uint32_t>> candidates;
+  if (needle.size() < 3) {
+    // Short queries can't make use of the index, but they are also likely to
+    // match nearly everything, so we settle on the preferred order
+    for (std::uint32_t entry = 0;
+         entry < this->entries_ && candidates.size() < limit; entry++) {
+      if (!matches(entry)) {
+        continue;
+      }
+
+      const auto value{this->score(entry, needle)};
+      if (value > 0) {
+        candidates.emplace_back(value, entry);
+      }
+    }
+  } else {
+    const auto trigrams_offset{(HEADER_WORDS + this->entries_ * ENTRY_WORDS) *
+                               WORD};
+    const auto postings_offset{trigrams_offset +
+                               this->trigrams_ * TRIGRAM_WORDS * WORD};
+
+    // Find the postings of every trigram in the query
+    std::vector<std::pair<std::uint32_t, std::uint32_t>> lists;
+    for (std::size_t cursor = 0; cursor + 3 <= needle.size(); cursor++) {
+      const auto key{trigram(needle, cursor)};
+      std::uint32_t low{0};
+      std::uint32_t high{this->trigrams_};
+      while (low < high) {
+        const auto middle{low + (high - low) / 2};
+        if (this->read(trigrams_offset + middle * TRIGRAM_WORDS * WORD) <
+            key) {
+          low = middle + 1;
+        } else {
+          high = middle;
+        }
+      }
+
+      const auto location{trigrams_offset + low * TRIGRAM_WORDS * WORD};
+      if (low == this->trigrams_ || this->read(location) != key) {
+        return {};
+      }
+
+      lists.emplace_back(this->read(location + WORD),
+                         this->read(location + 2 * WORD));
+    }
+
+    // Intersect starting from the smallest list
+    std::sort(lists.begin(), lists.end(),
+              [](const auto &left, const auto &right) {
+                return left.second < right.second;
+              });
+
+    std::vector<std::uint32_t> current;
+    current.reserve(lists.front().second);
+    for (std::uint32_t index = 0; index < lists.front().second; index++) {
+      const auto entry{
+          this->read(postings_offset + (lists.front().first + index) * WORD)};
+      if (matches(entry)) {
+        current.push_back(entry);
+      }
+    }
+
+    for (std::size_t list = 1; list < lists.size() && !current.empty();
+         list++) {
+      std::vector<std::uint32_t> next;
+      std::uint32_t index{0};
+      for (const auto identifier : current) {
+        while (index < lists[list].second &&
+               this->read(postings_offset +
+                          (lists[list].first + index) * WORD) < identifier) {
+          index++;
+        }
+
+        if (index == lists[list].second) {
+          break;
+        }
+
+        if (this->read(postings_offset + (lists[list].first + index) * WORD) ==
+            identifier) {
+          next.push_back(identifier);
+        }
+      }
+
+      current = std::move(next);
+    }
+
+    // Trigrams might match across different parts of the query, so we need to
+    // confirm every candidate
+    for (const auto entry : current) {
+      const auto value{this->score(entry, needle)};
+      if (value > 0) {
+        candidates.emplace_back(value, entry);
+      }
+    }
+  }
+
+  const auto count{std::min(limit, candidates.size())};
+  std::partial_sort(candidates.begin(),
+                    candidates.begin() + static_cast<std::ptrdiff_t>(count),
+                    candidates.end(), [](const auto &left, const auto &right) {
+                      return left.first > right.first ||
+                             (left.first == right.first &&
+                              left.second < right.second);
+                    });
+
+  std::vector<Match> result;
+  result.reserve(count);
+  for (std::size_t index = 0; index < count; index++) {
+    const auto entry{candidates[index].second};
+    result.push_back({.path = this->field(entry, 0),
+                      .title = this->field(entry, 1),
+                      .description = this->field(entry, 2)});
+  }
+
+  return result;
+}
+
+} // namespace sourcemeta::registry
+
+// The completion layout consists of little-endian 32-bit integers, as
+// follows:
+//
+// - Header: magic, version, number of entries, number of nodes, number of
+//   rankings, and size of the labels section
+// - Entries: same as in the search index
+// - Nodes: the offset and length of the edge label within the labels section,
+//   the index and count of the children, and the offset and count of the best
+//   completions within the rankings section. The root is the first node, and
+//   the children of every node are contiguous and sorted by label
+// - Rankings: entry identifiers, best first
+// - Labels
+// - Strings
+
+namespace {
+
+constexpr std::uint32_t COMPLETION_MAGIC{0x4C504D43}; // "CMPL"
+constexpr std::uint32_t COMPLETION_VERSION{1};
+constexpr std::size_t COMPLETION_HEADER_WORDS{6};
+constexpr std::size_t NODE_WORDS{6};
+
+struct CompletionKey {
+  std::string value;
+  // Lower is better
+  std::uint32_t weight;
+  std::uint32_t entry;
+};
+
+struct CompletionNode {
+  std::uint32_t label_offset;
+  std::uint32_t label_length;
+  std::uint32_t children_offset;
+  std::uint32_t children_count;
+  std::vector<std::pair<std::uint32_t, std::uint32_t>> best;
+};
+
+auto common_prefix(const std::string_view left, const std::string_view right,
+                   std::size_t start) -> std::size_t {
+  while (start < left.size() && start < right.size() &&
+         left[start] == right[start]) {
+    start++;
+  }
+
+  return start;
+}
+
+// The keys within the range share the first `end` characters, and the node
+// takes the characters from `start` to `end` as its label
+auto build_completion_node(const std::vector<CompletionKey> &keys,
+                           const std::size_t low, const std::size_t high,
+                           const std::size_t start, const std::size_t end,
+                           const std::size_t index,
+                           std::vector<CompletionNode> &nodes,
+                           std::string &labels) -> void {
+  assert(low < high);
+  nodes[index].label_offset = static_cast<std::uint32_t>(labels.size());
+  nodes[index].label_length = static_cast<std::uint32_t>(end - start);
+  labels.append(keys[low].value, start, end - start);
+
+  // Keys that end at this node always sort first
+  std::vector<std::pair<std::uint32_t, std::uint32_t>> candidates;
+  auto cursor{low};
+  while (cursor < high && keys[cursor].value.size() == end) {
+    candidates.emplace_back(keys[cursor].weight, keys[cursor].entry);
+    cursor++;
+  }
+
+  std::vector<std::pair<std::size_t, std::size_t>> groups;
+  while (cursor < high) {
+    auto next{cursor + 1};
+    while (next < high && keys[next].value[end] == keys[cursor].value[end]) {
+      next++;
+    }
+
+    groups.emplace_back(cursor, next);
+    cursor = next;
+  }
+
+  // Reserve the children upfront, so that they are contiguous
+  const auto children_offset{nodes.size()};
+  nodes[index].children_offset = static_cast<std::uint32_t>(children_offset);
+  nodes[index].children_count = static_cast<std::uint32_t>(groups.size());
+  nodes.resize(nodes.size() + groups.size());
+  for (std::size_t child = 0; child < groups.size(); child++) {
+    const auto [child_low, child_high]{groups[child]};
+    // As the keys are sorted, the first and last keys determine the longest
+    // prefix that the entire group shares
+    const auto child_end{common_prefix(keys[child_low].value,
+                                       keys[child_high - 1].value, end + 1)};
+    build_completion_node(keys, child_low, child_high, end, child_end,
+                          children_offset + child, nodes, labels);
+    const auto &best{nodes[children_offset + child].best};
+    candidates.insert(candidates.end(), best.cbegin(), best.cend());
+  }
+
+  // An entry reachable through many keys only counts once, with its best
+  // weight. The best completions of every child are enough to determine the
+  // best completions of the parent
+  std::sort(candidates.begin(), candidates.end(),
+            [](const auto &left, const auto &right) {
+              return left.second < right.second ||
+                     (left.second == right.second && left.first < right.first);
+            });
+  candidates.erase(std::unique(candidates.begin(), candidates.end(),
+                               [](const auto &left, const auto &right) {
+                                 return left.second == right.second;
+                               }),
+                   candidates.end());
+  const auto count{std::min(
+      candidates.size(),
+      sourcemeta::registry::CompletionIndex::MAXIMUM_COMPLETIONS)};
+  std::partial_sort(candidates.begin(),
+                    candidates.begin() + static_cast<std::ptrdiff_t>(count),
+                    candidates.end());
+  candidates.resize(count);
+  nodes[index].best = std::move(candidates);
+}
+
+auto is_word_start(const std::string_view value, const std::size_t index)
+    -> bool {
+  return index == 0 ||
+         !std::isalnum(static_cast<unsigned char>(value[index - 1]));
+}
+
+} // namespace
+
+namespace sourcemeta::registry {
+
+auto make_completion_index(const std::vector<SearchEntry> &entries)
+    -> std::string {
+  std::string strings;
+  std::vector<std::uint32_t> locations;
+  locations.reserve(entries.size() * ENTRY_WORDS);
+  std::vector<CompletionKey> keys;
+  for (std::uint32_t identifier = 0; identifier < entries.size();
+       identifier++) {
+    const auto &entry{entries[identifier]};
+    for (const auto *const value :
+         {&entry.path, &entry.title, &entry.description}) {
+      locations.push_back(static_cast<std::uint32_t>(strings.size()));
+      locations.push_back(static_cast<std::uint32_t>(value->size()));
+      strings.append(*value);
+    }
+
+    // Prefer completing titles over paths, the start of titles over their
+    // middle, and the last segment of paths over the rest
+    const auto title{to_lowercase(entry.title)};
+    for (std::size_t cursor = 0; cursor < title.size(); cursor++) {
+      if (is_word_start(title, cursor) &&
+          std::isalnum(static_cast<unsigned char>(title[cursor]))) {
+        keys.push_back({.value = title.substr(cursor),
+                        .weight = cursor == 0 ? 0u : 2u,
+                        .entry = identifier});
+      }
+    }
+
+    const auto path{to_lowercase(entry.path)};
+    for (std::size_t cursor = 0; cursor < path.size(); cursor++) {
+      if (path[cursor] != '/' && (cursor == 0 || path[cursor - 1] == '/')) {
+        keys.push_back({.value = path.substr(cursor),
+                        .weight =
+                            path.find('/', cursor) == std::string::npos ? 1u
+                                                                        : 3u,
+                        .entry = identifier});
+      }
+    }
+  }
+
+  std::sort(keys.begin(), keys.end(), [](const auto &left, const auto &right) {
+    return left.value < right.value;
+  });
+
+  std::vector<CompletionNode> nodes(1);
+  std::string labels;
+  if (keys.empty()) {
+    nodes.front() = {.label_offset = 0,
+                     .label_length = 0,
+                     .children_offset = 0,
+                     .children_count = 0,
+                     .best = {}};
+  } else {
+    build_completion_node(keys, 0, keys.size(), 0, 0, 0, nodes, labels);
+  }
+
+  std::size_t rankings_count{0};
+  for (const auto &node : nodes) {
+    rankings_count += node.best.size();
+  }
+
+  std::string result;
+  result.reserve((COMPLETION_HEADER_WORDS + locations.size() +
+                  nodes.size() * NODE_WORDS + rankings_count) *
+                     WORD +
+                 labels.size() + strings.size());
+  append(result, COMPLETION_MAGIC);
+  append(result, COMPLETION_VERSION);
+  append(result, static_cast<std::uint32_t>(entries.size()));
+  append(result, static_cast<std::uint32_t>(nodes.size()));
+  append(result, static_cast<std::uint32_t>(rankings_count));
+  append(result, static_cast<std::uint32_t>(labels.size()));
+  for (const auto location : locations) {
+    append(result, location);
+  }
+
+  std::uint32_t rankings_offset{0};
+  for (const auto &node : nodes) {
+    append(result, node.label_offset);
+    append(result, node.label_length);
+    append(result, node.children_offset);
+    append(result, node.children_count);
+    append(result, rankings_offset);
+    append(result, static_cast<std::uint32_t>(node.best.size()));
+    rankings_offset += static_cast<std::uint32_t>(node.best.size());
+  }
+
+  for (const auto &node : nodes) {
+    for (const auto &pair : node.best) {
+      append(result, pair.second);
+    }
+  }
+
+  result.append(labels);
+  result.append(strings);
+  return result;
+}
+
+CompletionIndex::CompletionIndex(const std::string_view data) : data_{data} {
+  if (this->data_.size() < COMPLETION_HEADER_WORDS * WORD ||
+      this->read(0) != COMPLETION_MAGIC ||
+      this->read(WORD) != COMPLETION_VERSION) {
+    throw std::runtime_error("Invalid completion index");
+  }
+
+  this->entries_ = this->read(2 * WORD);
+  this->nodes_ = this->read(3 * WORD);
+  this->rankings_ = this->read(4 * WORD);
+  this->labels_ = this->read(5 * WORD);
+  if (this->nodes_ == 0 ||
+      this->data_.size() < (COMPLETION_HEADER_WORDS +
+                            this->entries_ * ENTRY_WORDS +
+                            this->nodes_ * NODE_WORDS + this->rankings_) *
+                                   WORD +
+                               this->labels_) {
+    throw std::runtime_error("Invalid completion index");
+  }
+}
+
+auto CompletionIndex::size() const noexcept -> std::size_t {
+  return this->entries_;
+}
+
+auto CompletionIndex::read(const std::size_t offset) const -> std::uint32_t {
+  assert(offset + WORD <= this->data_.size());
+  std::uint32_t result;
+  std::memcpy(&result, this->data_.data() + offset, WORD);
+  return result;
+}
+
+auto CompletionIndex::node(const std::uint32_t index,
+                           const std::size_t word) const -> std::uint32_t {
+  assert(index < this->nodes_);
+  assert(word < NODE_WORDS);
+  return this->read((COMPLETION_HEADER_WORDS + this->entries_ * ENTRY_WORDS +
+                     index * NODE_WORDS + word) *
+                    WORD);
+}
+
+auto CompletionIndex::label(const std::uint32_t index) const
+    -> std::string_view {
+  const auto labels{(COMPLETION_HEADER_WORDS + this->entries_ * ENTRY_WORDS +
+                     this->nodes_ * NODE_WORDS + this->rankings_) *
+                    WORD};
+  return this->data_.substr(labels + this->node(index, 0),
+                            this->node(index, 1));
+}
+
+auto CompletionIndex::field(const std::uint32_t entry,
+                            const std::size_t index) const
+    -> std::string_view {
+  assert(entry < this->entries_);
+  assert(index < ENTRY_WORDS / 2);
+  const auto location{
+      (COMPLETION_HEADER_WORDS + entry * ENTRY_WORDS + index * 2) * WORD};
+  const auto strings{(COMPLETION_HEADER_WORDS + this->entries_ * ENTRY_WORDS +
+                      this->nodes_ * NODE_WORDS + this->rankings_) *
+                         WORD +
+                     this->labels_};
+  return this->data_.substr(strings + this->read(location),
+                            this->read(location + WORD));
+}
+
+auto CompletionIndex::complete(const std::string_view prefix,
+                               const std::size_t limit) const
+    -> std::vector<Match> {
+  auto needle{to_lowercase(prefix)};
+  // Paths are completed from any of their segments
+  const auto start{needle.find_first_not_of('/')};
+  if (start == std::string::npos) {
+    return {};
+  }
+
+  std::string_view remaining{needle};
+  remaining.remove_prefix(start);
+  std::uint32_t current{0};
+  while (!remaining.empty()) {
+    // The children are sorted, and no two of them start with the same byte
+    const auto children_offset{this->node(current, 2)};
+    std::uint32_t low{children_offset};
+    std::uint32_t high{children_offset + this->node(current, 3)};
+    while (low < high) {
+      const auto middle{low + (high - low) / 2};
+      if (static_cast<unsigned char>(this->label(middle).front()) <
+          static_cast<unsigned char>(remaining.front())) {
+        low = middle + 1;
+      } else {
+        high = middle;
+      }
+    }
+
+    if (low == children_offset + this->node(current, 3)) {
+      return {};
+    }
+
+    const auto edge{this->label(low)};
+    const auto length{std::min(edge.size(), remaining.size())};
+    if (edge.substr(0, length) != remaining.substr(0, length)) {
+      return {};
+    }
+
+    remaining.remove_prefix(length);
+    current = low;
+  }
+
+  const auto rankings{(COMPLETION_HEADER_WORDS + this->entries_ * ENTRY_WORDS +
+                       this->nodes_ * NODE_WORDS) *
+                      WORD};
+  const auto count{
+      std::min(limit, static_cast<std::size_t>(this->node(current, 5)))};
+  std::vector<Match> result;
+  result.reserve(count);
+  for (std::size_t index = 0; index < count; index++) {
+    const auto entry{
+        this->read(rankings + (this->node(current, 4) + index) * WORD)};
+    result.push_back({.path = this->field(entry, 0),
+                      .title = this->field(entry, 1),
+                      .description = this->field(entry, 2)});
+  }
+
+  return result;
+}
+
+} // namespace sourcemeta::registry
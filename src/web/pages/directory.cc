@@ -41,7 +41,8 @@ auto GENERATE_WEB_DIRECTORY::handler(
   write_text(destination, html_content.str(), "text/html", Encoding::GZIP,
              sourcemeta::core::JSON{nullptr},
              std::chrono::duration_cast<std::chrono::milliseconds>(
-                 timestamp_end - timestamp_start));
+                 timestamp_end - timestamp_start),
+             configuration.compression_of("web"));
 }
 
 } // namespace sourcemeta::registry
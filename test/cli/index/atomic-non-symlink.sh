@@ -0,0 +1,26 @@
+#!/bin/sh
+
+set -o errexit
+set -o nounset
+
+TMP="$(mktemp -d)"
+clean() { rm -rf "$TMP"; }
+trap clean EXIT
+
+cat << EOF > "$TMP/registry.json"
+{
+  "url": "https://sourcemeta.com/",
+  "contents": {}
+}
+EOF
+
+mkdir "$TMP/output"
+"$1" --atomic "$TMP/registry.json" "$TMP/output" 2> "$TMP/output.txt" && CODE="$?" || CODE="$?"
+test "$CODE" = "1" || exit 1
+
+cat << EOF > "$TMP/expected.txt"
+error: the output must be a symbolic link to publish it atomically
+  at $(realpath "$TMP")/output
+EOF
+
+diff "$TMP/output.txt" "$TMP/expected.txt"
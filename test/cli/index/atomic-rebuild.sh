@@ -0,0 +1,77 @@
+#!/bin/sh
+
+set -o errexit
+set -o nounset
+
+TMP="$(mktemp -d)"
+clean() { rm -rf "$TMP"; }
+trap clean EXIT
+
+cat << EOF > "$TMP/registry.json"
+{
+  "url": "https://sourcemeta.com/",
+  "contents": {
+    "example": {
+      "contents": {
+        "schemas": {
+          "baseUri": "https://example.com/",
+          "path": "./schemas"
+        }
+      }
+    }
+  }
+}
+EOF
+
+mkdir "$TMP/schemas"
+
+cat << 'EOF' > "$TMP/schemas/test.json"
+{
+  "$schema": "http://json-schema.org/draft-07/schema#",
+  "$id": "https://example.com/old.json"
+}
+EOF
+
+cat << 'EOF' > "$TMP/schemas/other.json"
+{
+  "$schema": "http://json-schema.org/draft-07/schema#",
+  "$id": "https://example.com/other.json"
+}
+EOF
+
+"$1" --atomic "$TMP/registry.json" "$TMP/output"
+
+test -L "$TMP/output" || (echo "The output MUST be a symbolic link" 1>&2 && exit 1)
+FIRST="$(cd "$TMP/output" && pwd -P)"
+
+cat << 'EOF' > "$TMP/schemas/test.json"
+{
+  "$schema": "http://json-schema.org/draft-07/schema#",
+  "$id": "https://example.com/new"
+}
+EOF
+
+"$1" --atomic "$TMP/registry.json" "$TMP/output"
+
+SECOND="$(cd "$TMP/output" && pwd -P)"
+test "$FIRST" != "$SECOND" || (echo "The output MUST point elsewhere" 1>&2 && exit 1)
+
+exists() {
+  [ -f "$1" ] || (echo "File MUST exist: $1" 1>&2 && exit 1)
+}
+
+not_exists() {
+  [ ! -f "$1" ] || (echo "File MUST NOT exists: $1" 1>&2 && exit 1)
+}
+
+# The previous generation is left untouched
+exists "$FIRST/schemas/example/schemas/old/%/schema.metapack"
+not_exists "$FIRST/schemas/example/schemas/new/%/schema.metapack"
+
+exists "$SECOND/schemas/example/schemas/new/%/schema.metapack"
+not_exists "$SECOND/schemas/example/schemas/old/%/schema.metapack"
+
+# Unchanged artifacts are shared with the previous generation
+test "$FIRST/schemas/example/schemas/other/%/schema.metapack" \
+  -ef "$SECOND/schemas/example/schemas/other/%/schema.metapack" \
+  || (echo "Unchanged artifacts MUST be hardlinked" 1>&2 && exit 1)
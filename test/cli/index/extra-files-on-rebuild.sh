@@ -46,6 +46,7 @@ exists "$TMP/output/explorer/example/schemas/old/%/schema.metapack"
 exists "$TMP/output/schemas/example/schemas/old/%/bundle.metapack"
 exists "$TMP/output/schemas/example/schemas/old/%/editor.metapack"
 exists "$TMP/output/schemas/example/schemas/old/%/blaze-exhaustive.metapack"
+exists "$TMP/output/schemas/example/schemas/old/%/blaze-fast.metapack"
 exists "$TMP/output/schemas/example/schemas/old/%/schema.metapack"
 
 cat << 'EOF' > "$TMP/schemas/test.json"
@@ -61,10 +62,12 @@ exists "$TMP/output/explorer/example/schemas/new/%/schema.metapack"
 exists "$TMP/output/schemas/example/schemas/new/%/bundle.metapack"
 exists "$TMP/output/schemas/example/schemas/new/%/editor.metapack"
 exists "$TMP/output/schemas/example/schemas/new/%/blaze-exhaustive.metapack"
+exists "$TMP/output/schemas/example/schemas/new/%/blaze-fast.metapack"
 exists "$TMP/output/schemas/example/schemas/new/%/schema.metapack"
 
 not_exists "$TMP/output/explorer/example/schemas/old/%/schema.metapack"
 not_exists "$TMP/output/schemas/example/schemas/old/%/bundle.metapack"
 not_exists "$TMP/output/schemas/example/schemas/old/%/editor.metapack"
 not_exists "$TMP/output/schemas/example/schemas/old/%/blaze-exhaustive.metapack"
+not_exists "$TMP/output/schemas/example/schemas/old/%/blaze-fast.metapack"
 not_exists "$TMP/output/schemas/example/schemas/old/%/schema.metapack"
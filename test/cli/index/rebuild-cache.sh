@@ -80,10 +80,13 @@ Detecting: $(realpath "$TMP")/schemas/foo.json (#1)
 (skip) Analysing: https://sourcemeta.com/example/schemas/foo [bundle]
 (skip) Analysing: https://sourcemeta.com/example/schemas/foo [editor]
 (skip) Analysing: https://sourcemeta.com/example/schemas/foo [blaze-exhaustive]
+(skip) Analysing: https://sourcemeta.com/example/schemas/foo [blaze-fast]
 (skip) Analysing: https://sourcemeta.com/example/schemas/foo [metadata]
 (100%) Reviewing: $(realpath "$TMP")/output/schemas
 (  0%) Producing: $(realpath "$TMP")/output/explorer
 (skip) Producing: $(realpath "$TMP")/output/explorer [search]
+(skip) Producing: $(realpath "$TMP")/output/explorer [search-index]
+(skip) Producing: $(realpath "$TMP")/output/explorer [search-complete]
 ( 33%) Producing: example/schemas
 (skip) Producing: example/schemas [directory]
 ( 66%) Producing: example
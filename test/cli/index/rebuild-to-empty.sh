@@ -56,6 +56,10 @@ cat << 'EOF' > "$TMP/new-expected.txt"
 ./explorer/%/directory-html.metapack.deps
 ./explorer/%/directory.metapack
 ./explorer/%/directory.metapack.deps
+./explorer/%/search-complete.metapack
+./explorer/%/search-complete.metapack.deps
+./explorer/%/search-index.metapack
+./explorer/%/search-index.metapack.deps
 ./explorer/%/search.metapack
 ./explorer/%/search.metapack.deps
 ./version.json
@@ -31,7 +31,7 @@ No instance is expected to succeed against the false schema
 The object value was expected to validate against the single defined property subschema
   at instance location "/contents"
   at evaluate path "/properties/contents/properties"
-The object value was expected to validate against the 4 defined properties subschemas
+The object value was expected to validate against the 5 defined properties subschemas
   at instance location ""
   at evaluate path "/properties"
 EOF
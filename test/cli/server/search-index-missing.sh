@@ -0,0 +1,79 @@
+#!/bin/sh
+
+set -o errexit
+set -o nounset
+
+TMP="$(mktemp -d)"
+PORT="$((20000 + $$ % 10000))"
+clean() {
+  if [ -f "$TMP/server.pid" ]
+  then
+    kill "$(cat "$TMP/server.pid")" 2> /dev/null || true
+  fi
+
+  rm -rf "$TMP"
+}
+trap clean EXIT
+
+# An output directory without the search and completion indexes
+mkdir "$TMP/output"
+
+"$1" "$TMP/output" "$PORT" > "$TMP/server.log" 2>&1 &
+echo "$!" > "$TMP/server.pid"
+
+ATTEMPTS=0
+until curl --silent --output /dev/null "http://localhost:$PORT/self/api/"
+do
+  ATTEMPTS="$((ATTEMPTS + 1))"
+  if [ "$ATTEMPTS" -gt 50 ]
+  then
+    cat "$TMP/server.log" 1>&2
+    echo "The server MUST start" 1>&2
+    exit 1
+  fi
+
+  sleep 0.1
+done
+
+request() {
+  curl --silent --include "http://localhost:$PORT$1" \
+    | tr -d '\r' | sed '/^Date:/d' > "$TMP/output.txt"
+  echo >> "$TMP/output.txt"
+}
+
+request "/self/api/schemas/search?q=foo"
+
+cat << 'EOF' > "$TMP/expected.txt"
+HTTP/1.1 503 Service Unavailable
+Content-Type: application/problem+json
+Access-Control-Allow-Origin: *
+Content-Length: 121
+
+{
+  "title": "sourcemeta:registry/search-unavailable",
+  "status": 503,
+  "detail": "The search index is not available"
+}
+EOF
+
+diff "$TMP/output.txt" "$TMP/expected.txt"
+
+request "/self/api/schemas/complete?prefix=foo"
+
+cat << 'EOF' > "$TMP/expected.txt"
+HTTP/1.1 503 Service Unavailable
+Content-Type: application/problem+json
+Access-Control-Allow-Origin: *
+Content-Length: 127
+
+{
+  "title": "sourcemeta:registry/complete-unavailable",
+  "status": 503,
+  "detail": "The completion index is not available"
+}
+EOF
+
+diff "$TMP/output.txt" "$TMP/expected.txt"
+
+# The server MUST still be up
+kill -0 "$(cat "$TMP/server.pid")"
@@ -0,0 +1,103 @@
+#include <gtest/gtest.h>
+
+#include <sourcemeta/registry/compress.h>
+
+#include <string>
+
+// Encoders are optional, so we only test the ones this build supports
+
+TEST(Compress, brotli_round_trip) {
+  const std::string value{R"JSON({"type":"string","minLength":1})JSON"};
+  const auto result{sourcemeta::registry::brotli(value)};
+  if (!result.has_value()) {
+    GTEST_SKIP() << "Brotli is not supported";
+  }
+
+  EXPECT_NE(result.value(), value);
+  EXPECT_EQ(sourcemeta::registry::unbrotli(result.value()), value);
+}
+
+TEST(Compress, brotli_round_trip_large) {
+  std::string value;
+  for (auto index = 0; index < 10000; index++) {
+    value += R"JSON({"type":"string","minLength":)JSON" +
+             std::to_string(index) + "}\n";
+  }
+
+  const auto result{sourcemeta::registry::brotli(value)};
+  if (!result.has_value()) {
+    GTEST_SKIP() << "Brotli is not supported";
+  }
+
+  EXPECT_LT(result.value().size(), value.size());
+  EXPECT_EQ(sourcemeta::registry::unbrotli(result.value()), value);
+}
+
+TEST(Compress, brotli_round_trip_quality) {
+  const std::string value{R"JSON({"type":"string","minLength":1})JSON"};
+  const auto fastest{sourcemeta::registry::brotli(value, 0)};
+  const auto smallest{sourcemeta::registry::brotli(value, 11)};
+  if (!fastest.has_value() || !smallest.has_value()) {
+    GTEST_SKIP() << "Brotli is not supported";
+  }
+
+  EXPECT_EQ(sourcemeta::registry::unbrotli(fastest.value()), value);
+  EXPECT_EQ(sourcemeta::registry::unbrotli(smallest.value()), value);
+}
+
+TEST(Compress, brotli_decompress_error) {
+  if (!sourcemeta::registry::brotli("").has_value()) {
+    GTEST_SKIP() << "Brotli is not supported";
+  }
+
+  EXPECT_THROW(sourcemeta::registry::unbrotli("not-brotli-content"),
+               sourcemeta::registry::CompressError);
+}
+
+TEST(Compress, zstd_round_trip) {
+  const std::string value{R"JSON({"type":"string","minLength":1})JSON"};
+  const auto result{sourcemeta::registry::zstd(value)};
+  if (!result.has_value()) {
+    GTEST_SKIP() << "Zstandard is not supported";
+  }
+
+  EXPECT_NE(result.value(), value);
+  EXPECT_EQ(sourcemeta::registry::unzstd(result.value()), value);
+}
+
+TEST(Compress, zstd_round_trip_large) {
+  std::string value;
+  for (auto index = 0; index < 10000; index++) {
+    value += R"JSON({"type":"string","minLength":)JSON" +
+             std::to_string(index) + "}\n";
+  }
+
+  const auto result{sourcemeta::registry::zstd(value)};
+  if (!result.has_value()) {
+    GTEST_SKIP() << "Zstandard is not supported";
+  }
+
+  EXPECT_LT(result.value().size(), value.size());
+  EXPECT_EQ(sourcemeta::registry::unzstd(result.value()), value);
+}
+
+TEST(Compress, zstd_round_trip_level) {
+  const std::string value{R"JSON({"type":"string","minLength":1})JSON"};
+  const auto fastest{sourcemeta::registry::zstd(value, 1)};
+  const auto smallest{sourcemeta::registry::zstd(value, 22)};
+  if (!fastest.has_value() || !smallest.has_value()) {
+    GTEST_SKIP() << "Zstandard is not supported";
+  }
+
+  EXPECT_EQ(sourcemeta::registry::unzstd(fastest.value()), value);
+  EXPECT_EQ(sourcemeta::registry::unzstd(smallest.value()), value);
+}
+
+TEST(Compress, zstd_decompress_error) {
+  if (!sourcemeta::registry::zstd("").has_value()) {
+    GTEST_SKIP() << "Zstandard is not supported";
+  }
+
+  EXPECT_THROW(sourcemeta::registry::unzstd("not-zstd-content"),
+               sourcemeta::registry::CompressError);
+}
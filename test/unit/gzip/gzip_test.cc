@@ -3,6 +3,7 @@
 #include <sourcemeta/registry/gzip.h>
 
 #include <sstream>
+#include <string>
 
 TEST(GZIP, compress_stream_1) {
   const auto value{"Hello World"};
@@ -24,6 +25,18 @@ TEST(GZIP, compress_string_to_string_1) {
   EXPECT_EQ(result.size(), 31);
 }
 
+TEST(GZIP, compress_string_with_level_1) {
+  std::string value;
+  for (auto index = 0; index < 1000; index++) {
+    value += "{\"type\":\"string\",\"index\":" + std::to_string(index) + "}";
+  }
+
+  const auto fast{sourcemeta::registry::gzip(value, 1)};
+  const auto best{sourcemeta::registry::gzip(value, 9)};
+  EXPECT_EQ(sourcemeta::registry::gunzip(fast), value);
+  EXPECT_EQ(sourcemeta::registry::gunzip(best), value);
+}
+
 TEST(GZIP, decompress_stream_1) {
   const auto value{"Hello World"};
   std::istringstream input{sourcemeta::registry::gzip(value)};
@@ -52,3 +65,124 @@ TEST(GZIP, decompress_string_to_string_1) {
       sourcemeta::registry::gunzip(sourcemeta::registry::gzip(value))};
   EXPECT_EQ(result, value);
 }
+
+TEST(GZIP, dictionary_round_trip_1) {
+  const std::string dictionary{R"JSON("type": "string", "properties": {)JSON"};
+  const std::string value{R"JSON({ "properties": { "type": "string" } })JSON"};
+  const auto result{
+      sourcemeta::registry::deflate_with_dictionary(value, dictionary, 9)};
+  const auto baseline{sourcemeta::registry::deflate_with_dictionary(
+      value, std::string{"x"}, 9)};
+  EXPECT_LT(result.size(), baseline.size());
+  EXPECT_EQ(sourcemeta::registry::inflate_with_dictionary(result, dictionary),
+            value);
+}
+
+TEST(GZIP, dictionary_large_round_trip_1) {
+  std::string value;
+  for (auto index = 0; index < 10000; index++) {
+    value += R"JSON({ "type": "string", "minLength": )JSON" +
+             std::to_string(index) + " }\n";
+  }
+
+  const std::string dictionary{R"JSON({ "type": "string" })JSON"};
+  const auto result{
+      sourcemeta::registry::deflate_with_dictionary(value, dictionary, 6)};
+  EXPECT_EQ(sourcemeta::registry::inflate_with_dictionary(result, dictionary),
+            value);
+}
+
+TEST(GZIP, dictionary_wrong_dictionary_1) {
+  const auto result{sourcemeta::registry::deflate_with_dictionary(
+      "Hello World", "Hello", 9)};
+  EXPECT_THROW(sourcemeta::registry::inflate_with_dictionary(result, "World"),
+               sourcemeta::registry::GZIPError);
+}
+
+TEST(GZIP, dictionary_truncated_1) {
+  const auto result{sourcemeta::registry::deflate_with_dictionary(
+      "Hello World", "Hello", 9)};
+  EXPECT_THROW(sourcemeta::registry::inflate_with_dictionary(
+                   result.substr(0, result.size() / 2), "Hello"),
+               sourcemeta::registry::GZIPError);
+}
+
+TEST(GZIP, stream_decompress_1) {
+  const std::string value{"Hello World"};
+  const auto input{sourcemeta::registry::gzip(value)};
+  sourcemeta::registry::GUNZIPStream stream{1024};
+  std::string output;
+  EXPECT_TRUE(stream.write(input, output));
+  stream.end();
+  EXPECT_EQ(output, value);
+}
+
+TEST(GZIP, stream_decompress_byte_by_byte_1) {
+  std::string value;
+  for (auto index = 0; index < 10000; index++) {
+    value += R"JSON({ "type": "string", "minLength": )JSON" +
+             std::to_string(index) + " }\n";
+  }
+
+  const auto input{sourcemeta::registry::gzip(value)};
+  sourcemeta::registry::GUNZIPStream stream{value.size()};
+  std::string output;
+  for (const auto character : input) {
+    EXPECT_TRUE(stream.write(std::string(1, character), output));
+  }
+
+  stream.end();
+  EXPECT_EQ(output, value);
+}
+
+TEST(GZIP, stream_decompress_large_chunk_1) {
+  // Compresses extremely well, so a single input chunk produces many output
+  // buffers worth of data
+  const std::string value(1024 * 1024, 'x');
+  const auto input{sourcemeta::registry::gzip(value)};
+  sourcemeta::registry::GUNZIPStream stream{value.size()};
+  std::string output;
+  EXPECT_TRUE(stream.write(input, output));
+  stream.end();
+  EXPECT_EQ(output, value);
+}
+
+TEST(GZIP, stream_decompress_over_limit_1) {
+  const std::string value(1024 * 1024, 'x');
+  const auto input{sourcemeta::registry::gzip(value)};
+  sourcemeta::registry::GUNZIPStream stream{value.size() - 1};
+  std::string output;
+  EXPECT_FALSE(stream.write(input, output));
+  EXPECT_LT(output.size(), value.size());
+}
+
+TEST(GZIP, stream_decompress_truncated_1) {
+  const auto input{sourcemeta::registry::gzip("Hello World")};
+  sourcemeta::registry::GUNZIPStream stream{1024};
+  std::string output;
+  EXPECT_TRUE(stream.write(input.substr(0, input.size() / 2), output));
+  EXPECT_THROW(stream.end(), sourcemeta::registry::GZIPError);
+}
+
+TEST(GZIP, stream_decompress_invalid_1) {
+  sourcemeta::registry::GUNZIPStream stream{1024};
+  std::string output;
+  EXPECT_THROW((void)stream.write("not-gzip-content", output),
+               sourcemeta::registry::GZIPError);
+}
+
+TEST(GZIP, stream_decompress_trailing_data_1) {
+  const auto input{sourcemeta::registry::gzip("Hello World")};
+  sourcemeta::registry::GUNZIPStream stream{1024};
+  std::string output;
+  EXPECT_THROW((void)stream.write(input + "foo", output),
+               sourcemeta::registry::GZIPError);
+}
+
+TEST(GZIP, stream_decompress_empty_1) {
+  sourcemeta::registry::GUNZIPStream stream{1024};
+  std::string output;
+  EXPECT_TRUE(stream.write("", output));
+  EXPECT_TRUE(output.empty());
+  EXPECT_THROW(stream.end(), sourcemeta::registry::GZIPError);
+}
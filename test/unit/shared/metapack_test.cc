@@ -0,0 +1,329 @@
+#include <gtest/gtest.h>
+
+#include <sourcemeta/core/json.h>
+
+#include <sourcemeta/registry/compress.h>
+#include <sourcemeta/registry/gzip.h>
+#include <sourcemeta/registry/shared.h>
+
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+class MetapackTest : public testing::Test {
+protected:
+  auto SetUp() -> void override {
+    this->directory = std::filesystem::temp_directory_path() /
+                      ("sourcemeta-registry-metapack-" +
+                       std::string{testing::UnitTest::GetInstance()
+                                       ->current_test_info()
+                                       ->name()});
+    std::filesystem::remove_all(this->directory);
+    std::filesystem::create_directories(this->directory);
+  }
+
+  auto TearDown() -> void override {
+    std::filesystem::remove_all(this->directory);
+  }
+
+  static auto rest(std::ifstream &stream) -> std::string {
+    std::ostringstream buffer;
+    buffer << stream.rdbuf();
+    return buffer.str();
+  }
+
+  std::filesystem::path directory;
+};
+
+TEST_F(MetapackTest, text_identity_round_trip) {
+  const auto path{this->directory / "file.metapack"};
+  sourcemeta::registry::write_text(path, "Hello World", "text/plain",
+                                   sourcemeta::registry::Encoding::Identity,
+                                   sourcemeta::core::JSON{nullptr},
+                                   std::chrono::milliseconds{5});
+
+  auto file{sourcemeta::registry::read_stream_raw(path)};
+  EXPECT_TRUE(file.has_value());
+  EXPECT_EQ(file.value().version, 2);
+  EXPECT_EQ(file.value().checksum, "e59ff97941044f85df5297e1c302d260");
+  EXPECT_EQ(file.value().mime, "text/plain");
+  EXPECT_EQ(file.value().bytes, 12);
+  EXPECT_EQ(file.value().duration, std::chrono::milliseconds{5});
+  EXPECT_EQ(file.value().encoding, sourcemeta::registry::Encoding::Identity);
+  EXPECT_TRUE(file.value().extension.is_null());
+  EXPECT_EQ(rest(file.value().data), "Hello World\n");
+}
+
+TEST_F(MetapackTest, json_gzip_round_trip_with_extension) {
+  const auto path{this->directory / "file.metapack"};
+  const auto document{sourcemeta::core::parse_json(R"JSON({
+    "foo": [ 1, 2, 3 ]
+  })JSON")};
+  const sourcemeta::core::JSON extension{"https://example.com/schema"};
+  sourcemeta::registry::write_json(path, document, "application/json",
+                                   sourcemeta::registry::Encoding::GZIP,
+                                   extension, std::chrono::milliseconds{0});
+
+  const auto file{sourcemeta::registry::read_json_with_metadata(path)};
+  EXPECT_EQ(file.data, document);
+  EXPECT_EQ(file.version, 2);
+  EXPECT_EQ(file.mime, "application/json");
+  EXPECT_EQ(file.bytes, 15);
+  EXPECT_EQ(file.encoding, sourcemeta::registry::Encoding::GZIP);
+  EXPECT_EQ(file.extension, extension);
+}
+
+TEST_F(MetapackTest, last_modified_round_trip) {
+  const auto path{this->directory / "file.metapack"};
+  const auto before{std::chrono::system_clock::now() - std::chrono::seconds{1}};
+  sourcemeta::registry::write_text(path, "foo", "text/plain",
+                                   sourcemeta::registry::Encoding::Identity,
+                                   sourcemeta::core::JSON{nullptr},
+                                   std::chrono::milliseconds{0});
+  const auto after{std::chrono::system_clock::now()};
+  const auto file{sourcemeta::registry::read_metadata(path)};
+  EXPECT_TRUE(file.has_value());
+  EXPECT_GE(file.value().last_modified, before);
+  EXPECT_LE(file.value().last_modified, after);
+}
+
+TEST_F(MetapackTest, read_metadata_identity) {
+  const auto path{this->directory / "file.metapack"};
+  sourcemeta::registry::write_text(path, "Hello World", "text/plain",
+                                   sourcemeta::registry::Encoding::Identity,
+                                   sourcemeta::core::JSON{"extension"},
+                                   std::chrono::milliseconds{0});
+
+  const auto file{sourcemeta::registry::read_metadata(path)};
+  EXPECT_TRUE(file.has_value());
+  EXPECT_EQ(file.value().data, 12);
+  EXPECT_EQ(file.value().bytes, 12);
+  EXPECT_EQ(file.value().checksum, "e59ff97941044f85df5297e1c302d260");
+  EXPECT_EQ(file.value().mime, "text/plain");
+  EXPECT_EQ(file.value().encoding, sourcemeta::registry::Encoding::Identity);
+  EXPECT_EQ(file.value().extension, sourcemeta::core::JSON{"extension"});
+}
+
+TEST_F(MetapackTest, read_metadata_gzip) {
+  const auto path{this->directory / "file.metapack"};
+  const std::string contents(4096, 'x');
+  sourcemeta::registry::write_text(path, contents, "text/plain",
+                                   sourcemeta::registry::Encoding::GZIP,
+                                   sourcemeta::core::JSON{nullptr},
+                                   std::chrono::milliseconds{0});
+
+  const auto metadata{sourcemeta::registry::read_metadata(path)};
+  EXPECT_TRUE(metadata.has_value());
+  EXPECT_EQ(metadata.value().bytes, 4097);
+  EXPECT_EQ(metadata.value().encoding, sourcemeta::registry::Encoding::GZIP);
+
+  auto file{sourcemeta::registry::read_stream_raw(path)};
+  EXPECT_TRUE(file.has_value());
+  const auto payload{rest(file.value().data)};
+  EXPECT_EQ(metadata.value().data, payload.size());
+  EXPECT_EQ(sourcemeta::registry::gunzip(payload), contents + "\n");
+}
+
+TEST_F(MetapackTest, variants_round_trip) {
+  const auto path{this->directory / "file.metapack"};
+  std::string contents;
+  for (auto index = 0; index < 1000; index++) {
+    contents += R"JSON({"type":"string","minLength":)JSON" +
+                std::to_string(index) + "}";
+  }
+
+  sourcemeta::registry::write_text(path, contents, "text/plain",
+                                   sourcemeta::registry::Encoding::GZIP,
+                                   sourcemeta::core::JSON{"extension"},
+                                   std::chrono::milliseconds{0});
+
+  const auto metadata{sourcemeta::registry::read_metadata(path)};
+  EXPECT_TRUE(metadata.has_value());
+  EXPECT_EQ(metadata.value().encoding, sourcemeta::registry::Encoding::GZIP);
+  EXPECT_EQ(metadata.value().extension, sourcemeta::core::JSON{"extension"});
+
+  std::ifstream stream{path, std::ios::binary};
+  const auto raw{rest(stream)};
+  // The payload is always at the end of the file
+  EXPECT_EQ(sourcemeta::registry::gunzip(
+                raw.substr(raw.size() - metadata.value().data)),
+            contents + "\n");
+
+  const auto brotli{sourcemeta::registry::brotli("").has_value()};
+  const auto zstd{sourcemeta::registry::zstd("").has_value()};
+  EXPECT_EQ(metadata.value().variants.size(),
+            static_cast<std::size_t>(brotli) + static_cast<std::size_t>(zstd));
+  EXPECT_EQ(metadata.value().version, brotli || zstd ? 3 : 2);
+  for (const auto &variant : metadata.value().variants) {
+    const auto payload{raw.substr(variant.offset, variant.stored_bytes)};
+    EXPECT_LT(variant.stored_bytes, metadata.value().data);
+    if (variant.encoding == sourcemeta::registry::Encoding::Brotli) {
+      EXPECT_EQ(sourcemeta::registry::unbrotli(payload), contents + "\n");
+    } else {
+      EXPECT_EQ(variant.encoding, sourcemeta::registry::Encoding::Zstd);
+      EXPECT_EQ(sourcemeta::registry::unzstd(payload), contents + "\n");
+    }
+  }
+
+  // Reading the stream skips over the variants
+  auto file{sourcemeta::registry::read_stream_raw(path)};
+  EXPECT_TRUE(file.has_value());
+  EXPECT_EQ(file.value().variants.size(), metadata.value().variants.size());
+  EXPECT_EQ(sourcemeta::registry::gunzip(rest(file.value().data)),
+            contents + "\n");
+}
+
+TEST_F(MetapackTest, compression_fast) {
+  const auto path{this->directory / "file.metapack"};
+  const std::string contents(4096, 'x');
+  sourcemeta::registry::write_text(
+      path, contents, "text/plain", sourcemeta::registry::Encoding::GZIP,
+      sourcemeta::core::JSON{nullptr}, std::chrono::milliseconds{0},
+      {.level = sourcemeta::registry::CompressionLevel::Fast});
+
+  const auto metadata{sourcemeta::registry::read_metadata(path)};
+  EXPECT_TRUE(metadata.has_value());
+  EXPECT_EQ(metadata.value().encoding, sourcemeta::registry::Encoding::GZIP);
+  // Fast compression never precompresses variants
+  EXPECT_TRUE(metadata.value().variants.empty());
+  EXPECT_EQ(metadata.value().version, 2);
+  EXPECT_EQ(metadata.value().bytes, contents.size() + 1);
+}
+
+TEST_F(MetapackTest, compression_none) {
+  const auto path{this->directory / "file.metapack"};
+  sourcemeta::registry::write_text(
+      path, "Hello World", "text/plain", sourcemeta::registry::Encoding::GZIP,
+      sourcemeta::core::JSON{nullptr}, std::chrono::milliseconds{0},
+      {.level = sourcemeta::registry::CompressionLevel::None});
+
+  const auto metadata{sourcemeta::registry::read_metadata(path)};
+  EXPECT_TRUE(metadata.has_value());
+  EXPECT_EQ(metadata.value().encoding,
+            sourcemeta::registry::Encoding::Identity);
+  EXPECT_EQ(metadata.value().data, 12);
+  EXPECT_EQ(metadata.value().compression_duration.count(), 0);
+}
+
+TEST_F(MetapackTest, compression_below_threshold) {
+  const auto path{this->directory / "file.metapack"};
+  sourcemeta::registry::write_text(
+      path, "Hello World", "text/plain", sourcemeta::registry::Encoding::GZIP,
+      sourcemeta::core::JSON{nullptr}, std::chrono::milliseconds{0},
+      {.level = sourcemeta::registry::CompressionLevel::Best,
+       .threshold = 13});
+
+  const auto metadata{sourcemeta::registry::read_metadata(path)};
+  EXPECT_TRUE(metadata.has_value());
+  EXPECT_EQ(metadata.value().encoding,
+            sourcemeta::registry::Encoding::Identity);
+  EXPECT_EQ(metadata.value().data, 12);
+}
+
+TEST_F(MetapackTest, compression_best) {
+  const auto path{this->directory / "file.metapack"};
+  std::string contents;
+  for (auto index = 0; index < 1000; index++) {
+    contents += R"JSON({"type":"string","minLength":)JSON" +
+                std::to_string(index) + "}";
+  }
+
+  sourcemeta::registry::write_text(
+      path, contents, "text/plain", sourcemeta::registry::Encoding::GZIP,
+      sourcemeta::core::JSON{nullptr}, std::chrono::milliseconds{0},
+      {.level = sourcemeta::registry::CompressionLevel::Best});
+
+  const auto metadata{sourcemeta::registry::read_metadata(path)};
+  EXPECT_TRUE(metadata.has_value());
+  EXPECT_EQ(metadata.value().encoding, sourcemeta::registry::Encoding::GZIP);
+  EXPECT_LT(metadata.value().data, metadata.value().bytes);
+  EXPECT_GT(metadata.value().compression_duration.count(), 0);
+  for (const auto &variant : metadata.value().variants) {
+    EXPECT_LT(variant.stored_bytes, metadata.value().data);
+  }
+}
+
+TEST_F(MetapackTest, compression_dictionary) {
+  const auto path{this->directory / "file.metapack"};
+  auto document{sourcemeta::core::parse_json(R"JSON({
+    "$schema": "https://json-schema.org/draft/2020-12/schema",
+    "type": "object",
+    "properties": { "foo": { "type": "string" } }
+  })JSON")};
+
+  sourcemeta::registry::write_json(
+      path, document, "application/json", sourcemeta::registry::Encoding::GZIP,
+      sourcemeta::core::JSON{nullptr}, std::chrono::milliseconds{0},
+      {.level = sourcemeta::registry::CompressionLevel::Dictionary});
+  const auto metadata{sourcemeta::registry::read_metadata(path)};
+  EXPECT_TRUE(metadata.has_value());
+  EXPECT_EQ(metadata.value().encoding,
+            sourcemeta::registry::Encoding::DeflateDictionary);
+  EXPECT_TRUE(metadata.value().variants.empty());
+  EXPECT_LT(metadata.value().data, metadata.value().bytes);
+
+  const auto file{sourcemeta::registry::read_json_with_metadata(path)};
+  EXPECT_EQ(file.data, document);
+  EXPECT_EQ(file.encoding, sourcemeta::registry::Encoding::DeflateDictionary);
+
+  // The dictionary pays off for small JSON Schema payloads
+  const auto gzip_path{this->directory / "gzip.metapack"};
+  sourcemeta::registry::write_json(
+      gzip_path, document, "application/json",
+      sourcemeta::registry::Encoding::GZIP, sourcemeta::core::JSON{nullptr},
+      std::chrono::milliseconds{0});
+  EXPECT_LT(metadata.value().data,
+            sourcemeta::registry::read_metadata(gzip_path).value().data);
+}
+
+TEST_F(MetapackTest, compression_dictionary_large) {
+  const auto path{this->directory / "file.metapack"};
+  const std::string contents(4096, 'x');
+  sourcemeta::registry::write_text(
+      path, contents, "text/plain", sourcemeta::registry::Encoding::GZIP,
+      sourcemeta::core::JSON{nullptr}, std::chrono::milliseconds{0},
+      {.level = sourcemeta::registry::CompressionLevel::Dictionary});
+
+  // Large payloads get the default compression, which clients can decode
+  const auto metadata{sourcemeta::registry::read_metadata(path)};
+  EXPECT_TRUE(metadata.has_value());
+  EXPECT_EQ(metadata.value().encoding, sourcemeta::registry::Encoding::GZIP);
+  EXPECT_EQ(metadata.value().bytes, contents.size() + 1);
+}
+
+TEST_F(MetapackTest, read_metadata_non_existent) {
+  const auto path{this->directory / "missing.metapack"};
+  EXPECT_FALSE(sourcemeta::registry::read_metadata(path).has_value());
+  EXPECT_FALSE(sourcemeta::registry::read_stream_raw(path).has_value());
+}
+
+TEST_F(MetapackTest, read_version_1) {
+  const auto path{this->directory / "file.metapack"};
+  {
+    std::ofstream stream{path};
+    stream << R"JSON({"version":1,"checksum":"e59ff97941044f85df5297e1c302d260",)JSON"
+           << R"JSON("lastModified":"Wed, 21 Oct 2015 07:28:00 GMT",)JSON"
+           << R"JSON("mime":"text/plain","bytes":12,"duration":3,)JSON"
+           << R"JSON("encoding":"identity","extension":"foo"})JSON"
+           << "Hello World\n";
+  }
+
+  auto file{sourcemeta::registry::read_stream_raw(path)};
+  EXPECT_TRUE(file.has_value());
+  EXPECT_EQ(file.value().version, 1);
+  EXPECT_EQ(file.value().checksum, "e59ff97941044f85df5297e1c302d260");
+  EXPECT_EQ(file.value().mime, "text/plain");
+  EXPECT_EQ(file.value().bytes, 12);
+  EXPECT_EQ(file.value().duration, std::chrono::milliseconds{3});
+  EXPECT_EQ(file.value().encoding, sourcemeta::registry::Encoding::Identity);
+  EXPECT_EQ(file.value().extension, sourcemeta::core::JSON{"foo"});
+  EXPECT_EQ(rest(file.value().data), "Hello World\n");
+
+  const auto metadata{sourcemeta::registry::read_metadata(path)};
+  EXPECT_TRUE(metadata.has_value());
+  EXPECT_EQ(metadata.value().version, 1);
+  EXPECT_EQ(metadata.value().data, 12);
+  EXPECT_EQ(metadata.value().extension, sourcemeta::core::JSON{"foo"});
+}
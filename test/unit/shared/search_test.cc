@@ -0,0 +1,348 @@
+#include <gtest/gtest.h>
+
+#include <sourcemeta/registry/shared.h>
+
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+static auto make_index() -> std::string {
+  return sourcemeta::registry::make_search_index(
+      {{.path = "/test/bundling/single",
+        .title = "Bundling",
+        .description = "A bundling example"},
+       {.path = "/test/schemas/camelcase", .title = "", .description = ""},
+       {.path = "/test/bundling/double", .title = "", .description = ""},
+       {.path = "/test/other",
+        .title = "Other",
+        .description = "Mentions bundling in passing"}});
+}
+
+TEST(Search, size) {
+  const auto data{make_index()};
+  const sourcemeta::registry::SearchIndex index{data};
+  EXPECT_EQ(index.size(), 4);
+}
+
+TEST(Search, empty_index) {
+  const auto data{sourcemeta::registry::make_search_index({})};
+  const sourcemeta::registry::SearchIndex index{data};
+  EXPECT_EQ(index.size(), 0);
+  EXPECT_TRUE(index.search("foo", 10).empty());
+  EXPECT_TRUE(index.search("f", 10).empty());
+}
+
+TEST(Search, invalid_index) {
+  EXPECT_THROW(sourcemeta::registry::SearchIndex{"foo"}, std::runtime_error);
+  EXPECT_THROW(sourcemeta::registry::SearchIndex{"xxxxxxxxxxxxxxxxxxxxxxxx"},
+               std::runtime_error);
+}
+
+TEST(Search, relevance) {
+  const auto data{make_index()};
+  const sourcemeta::registry::SearchIndex index{data};
+  const auto result{index.search("bundling", 10)};
+  EXPECT_EQ(result.size(), 3);
+  // Title, path, and description
+  EXPECT_EQ(result.at(0).path, "/test/bundling/single");
+  EXPECT_EQ(result.at(0).title, "Bundling");
+  EXPECT_EQ(result.at(0).description, "A bundling example");
+  // Path only
+  EXPECT_EQ(result.at(1).path, "/test/bundling/double");
+  EXPECT_EQ(result.at(1).title, "");
+  EXPECT_EQ(result.at(1).description, "");
+  // Description only
+  EXPECT_EQ(result.at(2).path, "/test/other");
+}
+
+TEST(Search, case_insensitive) {
+  const auto data{make_index()};
+  const sourcemeta::registry::SearchIndex index{data};
+  const auto result{index.search("bUNdLing", 10)};
+  EXPECT_EQ(result.size(), 3);
+  EXPECT_EQ(result.at(0).path, "/test/bundling/single");
+}
+
+TEST(Search, across_separators) {
+  const auto data{make_index()};
+  const sourcemeta::registry::SearchIndex index{data};
+  const auto result{index.search("schemas/camelcase", 10)};
+  EXPECT_EQ(result.size(), 1);
+  EXPECT_EQ(result.at(0).path, "/test/schemas/camelcase");
+}
+
+TEST(Search, trigrams_without_substring) {
+  const auto data{make_index()};
+  const sourcemeta::registry::SearchIndex index{data};
+  // Every trigram exists, but not the query as a whole
+  EXPECT_TRUE(index.search("bundlingle", 10).empty());
+}
+
+TEST(Search, no_match) {
+  const auto data{make_index()};
+  const sourcemeta::registry::SearchIndex index{data};
+  EXPECT_TRUE(index.search("xxxxxxxxxxxx", 10).empty());
+}
+
+TEST(Search, short_query) {
+  const auto data{make_index()};
+  const sourcemeta::registry::SearchIndex index{data};
+  const auto result{index.search("Ot", 10)};
+  EXPECT_EQ(result.size(), 1);
+  EXPECT_EQ(result.at(0).path, "/test/other");
+}
+
+TEST(Search, limit) {
+  const auto data{make_index()};
+  const sourcemeta::registry::SearchIndex index{data};
+  EXPECT_EQ(index.search("test", 2).size(), 2);
+  EXPECT_EQ(index.search("e", 2).size(), 2);
+}
+
+TEST(Completion, size) {
+  const auto data{sourcemeta::registry::make_completion_index(
+      {{.path = "/test/foo", .title = "", .description = ""},
+       {.path = "/test/bar", .title = "", .description = ""}})};
+  const sourcemeta::registry::CompletionIndex index{data};
+  EXPECT_EQ(index.size(), 2);
+}
+
+TEST(Completion, empty_index) {
+  const auto data{sourcemeta::registry::make_completion_index({})};
+  const sourcemeta::registry::CompletionIndex index{data};
+  EXPECT_EQ(index.size(), 0);
+  EXPECT_TRUE(index.complete("foo", 10).empty());
+}
+
+TEST(Completion, invalid_index) {
+  const auto data{make_index()};
+  EXPECT_THROW(sourcemeta::registry::CompletionIndex{"foo"},
+               std::runtime_error);
+  EXPECT_THROW(sourcemeta::registry::CompletionIndex{data}, std::runtime_error);
+}
+
+TEST(Completion, path_segments) {
+  const auto data{sourcemeta::registry::make_completion_index(
+      {{.path = "/test/bundling/single", .title = "", .description = ""},
+       {.path = "/test/schemas/camelcase", .title = "", .description = ""}})};
+  const sourcemeta::registry::CompletionIndex index{data};
+
+  const auto result_1{index.complete("cam", 10)};
+  EXPECT_EQ(result_1.size(), 1);
+  EXPECT_EQ(result_1.at(0).path, "/test/schemas/camelcase");
+
+  const auto result_2{index.complete("/test/bundling/", 10)};
+  EXPECT_EQ(result_2.size(), 1);
+  EXPECT_EQ(result_2.at(0).path, "/test/bundling/single");
+
+  EXPECT_EQ(index.complete("test", 10).size(), 2);
+  EXPECT_EQ(index.complete("Te", 10).size(), 2);
+}
+
+TEST(Completion, only_prefixes) {
+  const auto data{sourcemeta::registry::make_completion_index(
+      {{.path = "/test/bundling", .title = "", .description = ""}})};
+  const sourcemeta::registry::CompletionIndex index{data};
+  EXPECT_TRUE(index.complete("undling", 10).empty());
+  EXPECT_TRUE(index.complete("bundlingx", 10).empty());
+  EXPECT_TRUE(index.complete("x", 10).empty());
+  EXPECT_TRUE(index.complete("/", 10).empty());
+  EXPECT_TRUE(index.complete("", 10).empty());
+}
+
+TEST(Completion, title_words) {
+  const auto data{sourcemeta::registry::make_completion_index(
+      {{.path = "/test/foo",
+        .title = "JSON Schema Bundling",
+        .description = "Not part of completions"}})};
+  const sourcemeta::registry::CompletionIndex index{data};
+  const auto result{index.complete("bund", 10)};
+  EXPECT_EQ(result.size(), 1);
+  EXPECT_EQ(result.at(0).path, "/test/foo");
+  EXPECT_EQ(result.at(0).title, "JSON Schema Bundling");
+  EXPECT_EQ(result.at(0).description, "Not part of completions");
+  EXPECT_EQ(index.complete("json schema b", 10).size(), 1);
+  EXPECT_TRUE(index.complete("completions", 10).empty());
+}
+
+TEST(Completion, ranking) {
+  const auto data{sourcemeta::registry::make_completion_index(
+      {{.path = "/bundling/one", .title = "", .description = ""},
+       {.path = "/test/bundling", .title = "", .description = ""},
+       {.path = "/test/two", .title = "A bundling example", .description = ""},
+       {.path = "/test/three", .title = "Bundling", .description = ""}})};
+  const sourcemeta::registry::CompletionIndex index{data};
+  const auto result{index.complete("bundling", 10)};
+  EXPECT_EQ(result.size(), 4);
+  // Start of the title
+  EXPECT_EQ(result.at(0).path, "/test/three");
+  // Last path segment
+  EXPECT_EQ(result.at(1).path, "/test/bundling");
+  // Middle of the title
+  EXPECT_EQ(result.at(2).path, "/test/two");
+  // Other path segment
+  EXPECT_EQ(result.at(3).path, "/bundling/one");
+}
+
+TEST(Completion, no_duplicates) {
+  const auto data{sourcemeta::registry::make_completion_index(
+      {{.path = "/bundling/bundling",
+        .title = "Bundling",
+        .description = ""}})};
+  const sourcemeta::registry::CompletionIndex index{data};
+  EXPECT_EQ(index.complete("b", 10).size(), 1);
+}
+
+TEST(Completion, limit) {
+  std::vector<sourcemeta::registry::SearchEntry> entries;
+  for (std::size_t index = 0; index < 20; index++) {
+    entries.push_back({.path = "/test/schema-" + std::to_string(index),
+                       .title = "",
+                       .description = ""});
+  }
+
+  const auto data{sourcemeta::registry::make_completion_index(entries)};
+  const sourcemeta::registry::CompletionIndex index{data};
+  EXPECT_EQ(index.complete("schema", 3).size(), 3);
+  const auto result{index.complete("schema", 100)};
+  EXPECT_EQ(result.size(),
+            sourcemeta::registry::CompletionIndex::MAXIMUM_COMPLETIONS);
+  // Earlier entries rank higher
+  EXPECT_EQ(result.at(0).path, "/test/schema-0");
+  EXPECT_EQ(result.at(9).path, "/test/schema-9");
+  const auto result_single{index.complete("schema-1", 100)};
+  EXPECT_EQ(result_single.size(), 10);
+  EXPECT_EQ(result_single.at(0).path, "/test/schema-1");
+  EXPECT_EQ(result_single.at(1).path, "/test/schema-10");
+}
+
+static auto make_faceted_index() -> std::string {
+  return sourcemeta::registry::make_search_index(
+      {{.path = "/openapi/v3.0/schema",
+        .title = "OpenAPI",
+        .description = "",
+        .dialect = "http://json-schema.org/draft-07/schema#",
+        .health = 90,
+        .alert = false,
+        .provenance = true},
+       {.path = "/openapi/v3.1/schema",
+        .title = "OpenAPI",
+        .description = "",
+        .dialect = "https://json-schema.org/draft/2020-12/schema",
+        .health = 85,
+        .alert = true,
+        .provenance = true},
+       {.path = "/openapi/v2.0/schema",
+        .title = "Swagger",
+        .description = "",
+        .dialect = "http://json-schema.org/draft-04/schema#",
+        .health = 40,
+        .alert = true,
+        .provenance = false},
+       {.path = "/other/schema",
+        .title = "Other",
+        .description = "",
+        .dialect = "http://json-schema.org/draft-07/schema#",
+        .health = 100,
+        .alert = false,
+        .provenance = false}});
+}
+
+TEST(Search, facet_without_query) {
+  const auto data{make_faceted_index()};
+  const sourcemeta::registry::SearchIndex index{data};
+  const auto result{index.search(
+      "", 10, {.dialect = "http://json-schema.org/draft-07/schema#"})};
+  EXPECT_EQ(result.size(), 2);
+  EXPECT_EQ(result.at(0).path, "/openapi/v3.0/schema");
+  EXPECT_EQ(result.at(1).path, "/other/schema");
+}
+
+TEST(Search, facet_with_query) {
+  const auto data{make_faceted_index()};
+  const sourcemeta::registry::SearchIndex index{data};
+  const auto result{index.search(
+      "openapi", 10,
+      {.dialect = "https://json-schema.org/draft/2020-12/schema"})};
+  EXPECT_EQ(result.size(), 1);
+  EXPECT_EQ(result.at(0).path, "/openapi/v3.1/schema");
+}
+
+TEST(Search, facet_unknown_value) {
+  const auto data{make_faceted_index()};
+  const sourcemeta::registry::SearchIndex index{data};
+  EXPECT_TRUE(index.search("", 10, {.dialect = "foo"}).empty());
+  EXPECT_TRUE(index.search("", 10, {.collection = "/foo"}).empty());
+}
+
+TEST(Search, facet_health) {
+  const auto data{make_faceted_index()};
+  const sourcemeta::registry::SearchIndex index{data};
+  EXPECT_EQ(index.search("", 10, {.health = 0}).size(), 4);
+  EXPECT_EQ(index.search("", 10, {.health = 85}).size(), 3);
+  EXPECT_EQ(index.search("", 10, {.health = 86}).size(), 2);
+  EXPECT_EQ(index.search("", 10, {.health = 90}).size(), 2);
+  const auto result{index.search("", 10, {.health = 100})};
+  EXPECT_EQ(result.size(), 1);
+  EXPECT_EQ(result.at(0).path, "/other/schema");
+}
+
+TEST(Search, facet_collection) {
+  const auto data{make_faceted_index()};
+  const sourcemeta::registry::SearchIndex index{data};
+  EXPECT_EQ(index.search("", 10, {.collection = "/openapi"}).size(), 3);
+  EXPECT_EQ(index.search("", 10, {.collection = "/openapi/"}).size(), 3);
+  const auto result{index.search("", 10, {.collection = "/openapi/v2.0"})};
+  EXPECT_EQ(result.size(), 1);
+  EXPECT_EQ(result.at(0).path, "/openapi/v2.0/schema");
+  // Only directories count
+  EXPECT_TRUE(
+      index.search("", 10, {.collection = "/openapi/v2.0/schema"}).empty());
+}
+
+TEST(Search, facet_flags) {
+  const auto data{make_faceted_index()};
+  const sourcemeta::registry::SearchIndex index{data};
+  EXPECT_EQ(index.search("", 10, {.alert = true}).size(), 2);
+  EXPECT_EQ(index.search("", 10, {.alert = false}).size(), 2);
+  const auto result{index.search("", 10, {.alert = false, .provenance = true})};
+  EXPECT_EQ(result.size(), 1);
+  EXPECT_EQ(result.at(0).path, "/openapi/v3.0/schema");
+}
+
+TEST(Search, facet_combined) {
+  const auto data{make_faceted_index()};
+  const sourcemeta::registry::SearchIndex index{data};
+  const auto result{
+      index.search("", 10,
+                   {.dialect = "http://json-schema.org/draft-07/schema#",
+                    .health = 80,
+                    .collection = "/openapi"})};
+  EXPECT_EQ(result.size(), 1);
+  EXPECT_EQ(result.at(0).path, "/openapi/v3.0/schema");
+}
+
+TEST(Search, facet_sparse) {
+  // Enough entries for sparse facets to be stored as arrays
+  std::vector<sourcemeta::registry::SearchEntry> entries;
+  for (std::size_t index = 0; index < 200; index++) {
+    entries.push_back({.path = "/test/schema-" + std::to_string(index),
+                       .title = "",
+                       .description = "",
+                       .dialect = index % 100 == 0 ? "sparse" : "dense",
+                       .health = 50,
+                       .alert = false,
+                       .provenance = false});
+  }
+
+  const auto data{sourcemeta::registry::make_search_index(entries)};
+  const sourcemeta::registry::SearchIndex index{data};
+  const auto sparse{index.search("", 10, {.dialect = "sparse"})};
+  EXPECT_EQ(sparse.size(), 2);
+  EXPECT_EQ(sparse.at(0).path, "/test/schema-0");
+  EXPECT_EQ(sparse.at(1).path, "/test/schema-100");
+  const auto dense{index.search("schema-1", 10, {.dialect = "dense"})};
+  EXPECT_EQ(dense.size(), 10);
+  EXPECT_EQ(dense.at(0).path, "/test/schema-1");
+  EXPECT_EQ(dense.at(1).path, "/test/schema-10");
+}